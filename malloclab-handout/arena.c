@@ -0,0 +1,60 @@
+/*
+ * arena.c - Region allocator (see arena.h)
+ *
+ * The mm_arena_t sits at the bottom of the arena's region, and the
+ * chunks follow it, each mem_region_sbrk extending the last one.
+ */
+#include <limits.h>
+
+#include "arena.h"
+#include "memlib.h"
+
+#define ARENA_HDR ((sizeof(mm_arena_t) + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1))
+
+mm_arena_t *mm_arena_create(size_t size)
+{
+    mem_region_t *r;
+    mm_arena_t *a;
+
+    if ((r = mem_region_create(ARENA_HDR + size)) == NULL)
+	return NULL;
+    if ((a = mem_region_sbrk(r, ARENA_HDR)) == (void *)-1) {
+	mem_region_destroy(r);
+	return NULL;
+    }
+    a->region = r;
+    a->base = a->ptr = a->end = (char *)a + ARENA_HDR;
+    return a;
+}
+
+void mm_arena_destroy(mm_arena_t *a)
+{
+    mem_region_destroy(a->region);
+}
+
+size_t mm_arena_size(mm_arena_t *a)
+{
+    return a->end - a->base;
+}
+
+/*
+ * mm_arena_grow - Extend the arena by enough whole chunks for size more
+ *     bytes, which follow the ones it has, and allocate them
+ */
+void *mm_arena_grow(mm_arena_t *a, size_t size)
+{
+    size_t need = size - (a->end - a->ptr);
+    size_t incr;
+    char *p;
+
+    if (need > INT_MAX)
+	return NULL;
+    incr = (need + ARENA_CHUNK - 1) / ARENA_CHUNK * ARENA_CHUNK;
+    if (incr > INT_MAX ||
+	mem_region_sbrk(a->region, (int)incr) == (void *)-1)
+	return NULL;
+    a->end += incr;
+    p = a->ptr;
+    a->ptr = p + size;
+    return p;
+}
@@ -0,0 +1,78 @@
+/*
+ * arena.h - Region allocator: bump allocation with bulk reset
+ *
+ * An arena hands out memory by bumping a pointer through chunks it
+ * takes from a memlib region of its own with mem_region_sbrk, so its
+ * memory is one contiguous range. Blocks are never freed one by one:
+ * mm_arena_release rolls the arena back to a mark, freeing everything
+ * allocated since, and mm_arena_reset empties it in O(1) while keeping
+ * its chunks for the next use. This suits objects that all die at the
+ * same time, like those of one request.
+ *
+ * An arena must only be used by one thread at a time.
+ */
+#ifndef __ARENA_H_
+#define __ARENA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "memlib.h"
+
+#define ARENA_ALIGN 8            /* alignment of every block */
+#define ARENA_CHUNK (64 << 10)   /* bytes taken from the region at a time */
+
+typedef struct {
+    char *ptr;                   /* next free byte */
+    char *end;                   /* end of the chunks taken so far */
+    char *base;                  /* start of the first chunk */
+    mem_region_t *region;
+} mm_arena_t;
+
+/* A point to roll an arena back to */
+typedef char *mm_arena_mark_t;
+
+/* Create an arena that can grow to size bytes, or return NULL */
+mm_arena_t *mm_arena_create(size_t size);
+
+/* Unmap an arena and everything allocated in it */
+void mm_arena_destroy(mm_arena_t *a);
+
+/* Bytes of the chunks an arena holds, used or not */
+size_t mm_arena_size(mm_arena_t *a);
+
+/* Slow path of mm_arena_alloc: take another chunk */
+void *mm_arena_grow(mm_arena_t *a, size_t size);
+
+/* Allocate size bytes, or return NULL if the region is full */
+static inline void *mm_arena_alloc(mm_arena_t *a, size_t size)
+{
+    char *p = a->ptr;
+
+    if (size > SIZE_MAX - ARENA_ALIGN + 1)
+	return NULL;             /* would round up to 0 */
+    size = (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+    if (size > (size_t)(a->end - p))
+	return mm_arena_grow(a, size);
+    a->ptr = p + size;
+    return p;
+}
+
+static inline mm_arena_mark_t mm_arena_mark(mm_arena_t *a)
+{
+    return a->ptr;
+}
+
+/* Free everything allocated since mark m */
+static inline void mm_arena_release(mm_arena_t *a, mm_arena_mark_t m)
+{
+    a->ptr = m;
+}
+
+/* Free everything, keeping the chunks */
+static inline void mm_arena_reset(mm_arena_t *a)
+{
+    a->ptr = a->base;
+}
+
+#endif /* __ARENA_H_ */
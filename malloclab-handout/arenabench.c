@@ -0,0 +1,235 @@
+/*
+ * arenabench.c - Compare an arena with mm_malloc and mm_free on traces
+ *
+ * Replays each tracefile twice: once through mm_malloc, mm_realloc and
+ * mm_free, and once through an arena (arena.h), where frees are only
+ * counted and the arena is reset whenever the number of live blocks
+ * drops to zero, that is at the end of every request of a trace made
+ * with "gentrace -R". A realloc in the arena allocates a new block and
+ * copies the old one. Both replays write the first byte of every block
+ * they get, as a caller would. Prints the throughput of both and the
+ * memory each ended up with.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include "arena.h"
+#include "mm.h"
+#include "memlib.h"
+#include "trace.h"
+#include "fsecs.h"
+#include "clock.h"
+#include "config.h"
+
+/*******************
+ * Global variables
+ *******************/
+int verbose = 0;        /* global flag for verbose output */
+
+/* The params of a timed replay */
+typedef struct {
+    trace_t *trace;
+    mm_arena_t *arena;
+} arena_params_t;
+
+/*********************
+ * Function prototypes
+ *********************/
+static void run_mm(void *ptr);
+static void run_arena(void *ptr);
+static void usage(void);
+static void app_error(char *msg);
+static void unix_error(char *msg);
+
+/**************
+ * Main routine
+ **************/
+int main(int argc, char **argv)
+{
+    int c, i, j, cpu = -1, live, requests;
+    fsecs_timer_t timer = DEFAULT_TIMER;
+    arena_params_t params;
+    double mm_secs, arena_secs;
+    size_t total, heapsize;
+    trace_t *t;
+
+    while ((c = getopt(argc, argv, "T:C:hv")) != EOF) {
+        switch (c) {
+	case 'T': /* Timing method */
+	    if ((timer = fsecs_parse_timer(optarg)) < 0) {
+		usage();
+		exit(1);
+	    }
+	    break;
+	case 'C': /* Pin to one CPU */
+	    cpu = atoi(optarg);
+	    break;
+	case 'v': /* Print timer calibration details */
+	    verbose = 1;
+	    break;
+        case 'h': /* Print this message */
+	    usage();
+            exit(0);
+        default:
+	    usage();
+            exit(1);
+        }
+    }
+    if (optind == argc) {
+	usage();
+	exit(1);
+    }
+
+    if (cpu >= 0 && pin_cpu(cpu) < 0)
+	unix_error("ERROR: could not pin to the requested CPU");
+    init_fsecs(timer);
+    mem_init();
+
+    printf("Arena vs mm_malloc/mm_free (timer %s):\n", fsecs_timer_name());
+    printf("%5s%10s%10s%11s%12s%9s%11s%11s  %s\n", "trace", "ops", "requests",
+	   "mm Kops", "arena Kops", "speedup", "mm KB", "arena KB", "name");
+    for (i = optind; i < argc; i++) {
+	t = read_trace("", argv[i]);
+
+	/* The arena never needs more than every request of the trace */
+	total = 0;
+	requests = live = 0;
+	for (j = 0; j < t->num_ops; j++) {
+	    if (t->ops[j].type != FREE)
+		total += (t->ops[j].size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+	    if (t->ops[j].type == ALLOC)
+		live++;
+	    else if (t->ops[j].type == FREE && --live == 0)
+		requests++;
+	}
+	params.trace = t;
+	if ((params.arena = mm_arena_create(total + ARENA_CHUNK)) == NULL)
+	    app_error("mm_arena_create failed");
+
+	mm_secs = fsecs(run_mm, &params);
+	heapsize = mem_heapsize();
+	arena_secs = fsecs(run_arena, &params);
+
+	printf("%2d%13d%10d%11.0f%12.0f%8.1fx%11lu%11lu  %s\n", i - optind,
+	       t->num_ops, requests, (t->num_ops/1e3)/mm_secs,
+	       (t->num_ops/1e3)/arena_secs, mm_secs / arena_secs,
+	       (unsigned long)(heapsize >> 10),
+	       (unsigned long)(mm_arena_size(params.arena) >> 10), argv[i]);
+	mm_arena_destroy(params.arena);
+	free_trace(t);
+    }
+
+    mem_deinit();
+    exit(0);
+}
+
+/*
+ * run_mm - Replay a trace through the mm package
+ */
+static void run_mm(void *ptr)
+{
+    trace_t *trace = ((arena_params_t *)ptr)->trace;
+    int i, index;
+    char *p;
+
+    mem_reset_brk();
+    if (mm_init() < 0)
+	app_error("mm_init failed in run_mm");
+
+    for (i = 0; i < trace->num_ops; i++) {
+	index = trace->ops[i].index;
+        switch (trace->ops[i].type) {
+        case ALLOC:
+            if ((p = mm_malloc(trace->ops[i].size)) == NULL)
+		app_error("mm_malloc error in run_mm");
+	    p[0] = 0;
+            trace->blocks[index] = p;
+            break;
+	case REALLOC:
+            if ((p = mm_realloc(trace->blocks[index], trace->ops[i].size)) == NULL)
+		app_error("mm_realloc error in run_mm");
+	    p[0] = 0;
+            trace->blocks[index] = p;
+            break;
+        case FREE:
+            mm_free(trace->blocks[index]);
+            break;
+        }
+    }
+}
+
+/*
+ * run_arena - Replay a trace in the arena, resetting it whenever no
+ *     block is live
+ */
+static void run_arena(void *ptr)
+{
+    arena_params_t *params = ptr;
+    trace_t *trace = params->trace;
+    mm_arena_t *a = params->arena;
+    int i, index, size, live = 0;
+    char *p;
+
+    mm_arena_reset(a);
+    for (i = 0; i < trace->num_ops; i++) {
+	index = trace->ops[i].index;
+	size = trace->ops[i].size;
+        switch (trace->ops[i].type) {
+        case ALLOC:
+            if ((p = mm_arena_alloc(a, size)) == NULL)
+		app_error("mm_arena_alloc error in run_arena");
+	    p[0] = 0;
+            trace->blocks[index] = p;
+	    trace->block_sizes[index] = size;
+	    live++;
+            break;
+	case REALLOC:
+            if ((p = mm_arena_alloc(a, size)) == NULL)
+		app_error("mm_arena_alloc error in run_arena");
+	    memcpy(p, trace->blocks[index], (size_t)size < trace->block_sizes[index] ?
+		   (size_t)size : trace->block_sizes[index]);
+	    p[0] = 0;
+            trace->blocks[index] = p;
+	    trace->block_sizes[index] = size;
+            break;
+        case FREE:
+	    if (--live == 0)
+		mm_arena_reset(a);
+            break;
+        }
+    }
+}
+
+/*
+ * app_error - Report an arbitrary application error
+ */
+static void app_error(char *msg)
+{
+    printf("%s\n", msg);
+    exit(1);
+}
+
+/*
+ * unix_error - Report a Unix-style error
+ */
+static void unix_error(char *msg)
+{
+    printf("%s: %s\n", msg, strerror(errno));
+    exit(1);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: arenabench [-hv] [-T <timer>] [-C <cpu>] <tracefile>...\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-C <cpu>    Pin the benchmark to CPU <cpu>.\n");
+    fprintf(stderr, "\t-h          Print this message.\n");
+    fprintf(stderr, "\t-T <timer>  Timing method: fcyc, itimer or gettod.\n");
+    fprintf(stderr, "\t-v          Print timer calibration details.\n");
+}
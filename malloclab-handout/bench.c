@@ -0,0 +1,210 @@
+/*
+ * bench.c - Repeated timing of a test function with robust statistics
+ *
+ * bench_run times a function a configurable number of times (after a
+ * few warmup runs) with fsecs_n, i.e. with whichever timer fsecs was
+ * initialized with. A function that runs in less than MIN_SAMPLE is
+ * run back to back enough times for each sample to last that long,
+ * well above the resolution of the timer, and the sample is the
+ * average of those runs. Outliers are rejected with the modified
+ * z-score test of Iglewicz and Hoaglin, which is based on the median
+ * absolute deviation and so isn't itself skewed by the outliers. The
+ * uncertainty of the median is estimated with a percentile bootstrap.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "bench.h"
+#include "fsecs.h"
+
+/* Default values */
+#define WARMUP     2       /* untimed runs */
+#define REPS       11      /* timed runs */
+#define CONFIDENCE 0.95    /* level of the bootstrap interval */
+#define CUTOFF     3.5     /* modified z-score above which we reject */
+#define RESAMPLES  2000    /* bootstrap resamples */
+#define MAD_SCALE  0.6745  /* MAD of a normal distribution, in stddevs */
+#define MIN_SAMPLE 0.01    /* seconds a sample lasts at least */
+#define MAX_RUNS   (1<<20) /* runs per sample at most */
+
+static int warmup = WARMUP;
+static int reps = REPS;
+static double confidence = CONFIDENCE;
+static double cutoff = CUTOFF;
+
+static int cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* median - median of n samples, sorting them in place */
+static double median(double *v, int n)
+{
+    qsort(v, n, sizeof(double), cmp_double);
+    return (n % 2) ? v[n/2] : 0.5 * (v[n/2-1] + v[n/2]);
+}
+
+/* 
+ * rng_next - private generator for the bootstrap, so that the reported
+ *     intervals are reproducible and don't disturb rand()
+ */
+static unsigned long long rng_state = 0x2545F4914F6CDD1DULL;
+
+static unsigned rng_next(unsigned n)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return (unsigned)(rng_state % n);
+}
+
+/*
+ * bench_summarize - Reject outliers from n samples and compute the
+ *     median, mean, standard deviation and a bootstrap confidence
+ *     interval of the median of the rest. Reorders the samples.
+ */
+void bench_summarize(double *samples, int n, bench_t *b)
+{
+    double *dev, *meds, *resample;
+    double med, mad, sum, sq;
+    int i, j, kept;
+
+    b->n = b->outliers = 0;
+    b->median = b->mean = b->stddev = b->ci_lo = b->ci_hi = 0.0;
+    if (n <= 0)
+	return;
+
+    if ((dev = malloc(n * sizeof(double))) == NULL ||
+	(resample = malloc(n * sizeof(double))) == NULL ||
+	(meds = malloc(RESAMPLES * sizeof(double))) == NULL) {
+	fprintf(stderr, "bench_summarize: malloc failed\n");
+	exit(1);
+    }
+
+    /* Reject samples far from the median in units of the scaled MAD */
+    med = median(samples, n);
+    for (i = 0; i < n; i++)
+	dev[i] = fabs(samples[i] - med);
+    mad = median(dev, n);
+    kept = 0;
+    for (i = 0; i < n; i++) {
+	if (cutoff > 0 && mad > 0 &&
+	    MAD_SCALE * fabs(samples[i] - med) / mad > cutoff)
+	    continue;
+	samples[kept++] = samples[i];
+    }
+    b->n = kept;
+    b->outliers = n - kept;
+
+    /* Location and spread of what's left */
+    sum = 0.0;
+    for (i = 0; i < kept; i++)
+	sum += samples[i];
+    b->mean = sum / kept;
+    sq = 0.0;
+    for (i = 0; i < kept; i++)
+	sq += (samples[i] - b->mean) * (samples[i] - b->mean);
+    b->stddev = (kept > 1) ? sqrt(sq / (kept - 1)) : 0.0;
+    b->median = median(samples, kept);
+
+    /* Percentile bootstrap of the median */
+    for (j = 0; j < RESAMPLES; j++) {
+	for (i = 0; i < kept; i++)
+	    resample[i] = samples[rng_next(kept)];
+	meds[j] = median(resample, kept);
+    }
+    qsort(meds, RESAMPLES, sizeof(double), cmp_double);
+    b->ci_lo = meds[(int)((1.0 - confidence) / 2 * (RESAMPLES - 1))];
+    b->ci_hi = meds[(int)((1.0 + confidence) / 2 * (RESAMPLES - 1))];
+
+    free(dev);
+    free(resample);
+    free(meds);
+}
+
+/*
+ * sample_runs - Number of back-to-back runs of f(argp) that last at
+ *     least MIN_SAMPLE seconds
+ */
+static int sample_runs(bench_funct f, void *argp)
+{
+    double secs;
+    int n = 1;
+
+    while (n < MAX_RUNS && (secs = fsecs_n(f, argp, n) * n) < MIN_SAMPLE) {
+	if (secs > 0 && 1.25 * MIN_SAMPLE / secs < MAX_RUNS / n)
+	    n = (int)ceil(1.25 * n * MIN_SAMPLE / secs);
+	else if (n < MAX_RUNS / 8)
+	    n *= 8;
+	else
+	    n = MAX_RUNS;
+    }
+    return n;
+}
+
+/*
+ * bench_run - Run f(argp) warmup times untimed, then take reps samples
+ *     of its running time and summarize them in *b. Each sample is the
+ *     average of enough runs to last MIN_SAMPLE seconds.
+ */
+void bench_run(bench_funct f, void *argp, bench_t *b)
+{
+    double *samples;
+    int i, n;
+
+    if ((samples = malloc(reps * sizeof(double))) == NULL) {
+	fprintf(stderr, "bench_run: malloc failed\n");
+	exit(1);
+    }
+    for (i = 0; i < warmup; i++)
+	f(argp);
+    n = sample_runs(f, argp);
+    for (i = 0; i < reps; i++)
+	samples[i] = fsecs_n(f, argp, n);
+    bench_summarize(samples, reps, b);
+    free(samples);
+}
+
+
+/*************************************************************
+ * Set the various parameters used by bench_run
+ ************************************************************/
+
+/* 
+ * set_bench_warmup - Number of untimed runs before sampling starts
+ *     Default = 2
+ */
+void set_bench_warmup(int warmup_arg)
+{
+    warmup = warmup_arg;
+}
+
+/* 
+ * set_bench_reps - Number of timed runs
+ *     Default = 11
+ */
+void set_bench_reps(int reps_arg)
+{
+    reps = (reps_arg > 0) ? reps_arg : 1;
+}
+
+/* 
+ * set_bench_confidence - Confidence level of the bootstrap interval
+ *     Default = 0.95
+ */
+void set_bench_confidence(double level)
+{
+    confidence = level;
+}
+
+/* 
+ * set_bench_outlier_cutoff - Modified z-score above which a sample is
+ *     rejected, 0 to keep every sample
+ *     Default = 3.5
+ */
+void set_bench_outlier_cutoff(double cutoff_arg)
+{
+    cutoff = cutoff_arg;
+}
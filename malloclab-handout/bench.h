@@ -0,0 +1,57 @@
+/*
+ * bench.h - Repeated timing of a test function with robust statistics
+ */
+#ifndef __BENCH_H_
+#define __BENCH_H_
+
+/* The test function takes a generic pointer as input */
+typedef void (*bench_funct)(void *);
+
+/* Summary of the timings of one test function, in seconds */
+typedef struct {
+    int n;           /* number of samples kept */
+    int outliers;    /* number of samples rejected as outliers */
+    double median;   /* median of the kept samples */
+    double mean;     /* mean of the kept samples */
+    double stddev;   /* sample standard deviation of the kept samples */
+    double ci_lo;    /* bootstrap confidence interval of the median */
+    double ci_hi;
+} bench_t;
+
+/* Time f(argp) repeatedly and summarize the samples in *b */
+void bench_run(bench_funct f, void *argp, bench_t *b);
+
+/* Summarize n samples in *b (reorders the samples) */
+void bench_summarize(double *samples, int n, bench_t *b);
+
+/*********************************************************
+ * Set the various parameters used by bench_run
+ *********************************************************/
+
+/* 
+ * set_bench_warmup - Number of untimed runs before sampling starts
+ *     Default = 2
+ */
+void set_bench_warmup(int warmup);
+
+/* 
+ * set_bench_reps - Number of timed runs
+ *     Default = 11
+ */
+void set_bench_reps(int reps);
+
+/* 
+ * set_bench_confidence - Confidence level of the bootstrap interval
+ *     Default = 0.95
+ */
+void set_bench_confidence(double level);
+
+/* 
+ * set_bench_outlier_cutoff - Reject samples whose modified z-score
+ *     (distance from the median in units of the scaled median absolute
+ *     deviation) exceeds this value. 0 disables outlier rejection.
+ *     Default = 3.5
+ */
+void set_bench_outlier_cutoff(double cutoff);
+
+#endif /* __BENCH_H_ */
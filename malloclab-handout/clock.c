@@ -1,14 +1,17 @@
 /* 
- * clock.c - Routines for using the cycle counters on x86, 
+ * clock.c - Routines for using the cycle counters on x86, x86-64,
  *           Alpha, and Sparc boxes.
  * 
  * Copyright (c) 2002, R. Bryant and D. O'Hallaron, All rights reserved.
  * May not be used, modified, or copied without permission.
  */
 
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <time.h>
+#include <sched.h>
 #include <sys/times.h>
 #include "clock.h"
 
@@ -16,7 +19,7 @@
 /******************************************************* 
  * Machine dependent functions 
  *
- * Note: the constants __i386__ and  __alpha
+ * Note: the constants __i386__, __x86_64__ and __alpha
  * are set by GCC when it calls the C preprocessor
  * You can verify this for yourself using gcc -v.
  *******************************************************/
@@ -71,6 +74,51 @@ double get_counter()
 }
 /* $end x86cyclecounter */
 
+#elif defined(__x86_64__)
+/*********************************************************
+ * x86-64 versions of start_counter() and get_counter()
+ *********************************************************/
+
+static unsigned cyc_hi = 0;
+static unsigned cyc_lo = 0;
+
+/* 
+ * Set *hi and *lo to the high and low order bits of the cycle counter.
+ * rdtscp does not execute until all earlier instructions have retired,
+ * and the lfence keeps later instructions from starting before the 
+ * read, so the timed region can't leak across either end.
+ */
+void access_counter(unsigned *hi, unsigned *lo)
+{
+    asm volatile("rdtscp; lfence"
+		 : "=a" (*lo), "=d" (*hi)
+		 : /* No input */
+		 : "%ecx", "memory");
+}
+
+/* Record the current value of the cycle counter. */
+void start_counter()
+{
+    access_counter(&cyc_hi, &cyc_lo);
+}
+
+/* Return the number of cycles since the last call to start_counter. */
+double get_counter()
+{
+    unsigned ncyc_hi, ncyc_lo;
+    unsigned long long start, now;
+
+    access_counter(&ncyc_hi, &ncyc_lo);
+    start = ((unsigned long long)cyc_hi << 32) | cyc_lo;
+    now = ((unsigned long long)ncyc_hi << 32) | ncyc_lo;
+    if (now < start) {
+	fprintf(stderr, "Error: counter went backwards by %llu cycles\n",
+		start - now);
+	return 0.0;
+    }
+    return (double)(now - start);
+}
+
 #elif defined(__alpha)
 
 /****************************************************
@@ -147,7 +195,7 @@ void start_counter()
 {
     printf("ERROR: You are trying to use a start_counter routine in clock.c\n");
     printf("that has not been implemented yet on this platform.\n");
-    printf("Please choose another timing package in config.h.\n");
+    printf("Please choose another timing package with mdriver -T.\n");
     exit(1);
 }
 
@@ -155,7 +203,7 @@ double get_counter()
 {
     printf("ERROR: You are trying to use a get_counter routine in clock.c\n");
     printf("that has not been implemented yet on this platform.\n");
-    printf("Please choose another timing package in config.h.\n");
+    printf("Please choose another timing package with mdriver -T.\n");
     exit(1);
 }
 #endif
@@ -201,6 +249,71 @@ double mhz(int verbose)
     return mhz_full(verbose, 2);
 }
 
+/* 
+ * mhz_calibrate - Estimate the counter rate against the monotonic
+ *     system clock over a busy interval of msecs milliseconds. Unlike
+ *     mhz_full this doesn't sleep, so the core can't drop into a
+ *     low-power state, and the interval is measured in nanoseconds
+ *     rather than assumed. Only meaningful if counter_invariant().
+ */
+double mhz_calibrate(int verbose, int msecs)
+{
+    struct timespec t0, t1;
+    double cycles, nsecs;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    start_counter();
+    do {
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	nsecs = 1e9*(t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec);
+    } while (nsecs < 1e6*msecs);
+    cycles = get_counter();
+    if (verbose)
+	printf("Counter rate ~= %.1f MHz\n", cycles*1e3/nsecs);
+    return cycles*1e3/nsecs;
+}
+
+/* 
+ * counter_invariant - Does the cycle counter tick at a constant rate,
+ *     independent of frequency scaling and sleep states? Without this
+ *     counter deltas can't be converted to seconds with one rate.
+ */
+int counter_invariant()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    unsigned eax, ebx, ecx, edx;
+
+    /* Invariant TSC is CPUID leaf 0x80000007, EDX bit 8 */
+    asm volatile("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+		 : "a" (0x80000000));
+    if (eax < 0x80000007)
+	return 0;
+    asm volatile("cpuid" : "=a" (eax), "=b" (ebx), "=c" (ecx), "=d" (edx)
+		 : "a" (0x80000007));
+    return (edx >> 8) & 1;
+#else
+    return 0;
+#endif
+}
+
+/* 
+ * pin_cpu - Bind the calling process to a single CPU so that every
+ *     counter read comes from the same core and the measured code
+ *     isn't migrated mid-run. Returns 0 on success, -1 on failure.
+ */
+int pin_cpu(int cpu)
+{
+#if defined(__linux__)
+    cpu_set_t set;
+
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return sched_setaffinity(0, sizeof(set), &set);
+#else
+    return -1;
+#endif
+}
+
 /** Special counters that compensate for timer interrupt overhead */
 
 static double cyc_per_tick = 0.0;
@@ -15,6 +15,15 @@ double mhz(int verbose);
 /* Determine clock rate of processor, having more control over accuracy */
 double mhz_full(int verbose, int sleeptime);
 
+/* Determine clock rate of counter against the monotonic system clock */
+double mhz_calibrate(int verbose, int msecs);
+
+/* Does the counter run at a constant rate (e.g. x86 invariant TSC)? */
+int counter_invariant();
+
+/* Bind the process to one CPU (Linux only). Returns 0 on success */
+int pin_cpu(int cpu);
+
 /** Special counters that compensate for timer interrupt overhead */
 
 void start_comp_counter();
@@ -63,10 +63,19 @@
 #define MAX_HEAP (20*(1<<20))  /* 20 MB */
 
 /*****************************************************************************
- * Set exactly one of these USE_xxx constants to "1" to select a timing method
+ * Set exactly one of these USE_xxx constants to "1" to select the default
+ * timing method. It can be overridden at runtime with mdriver -T <timer>.
  *****************************************************************************/
-#define USE_FCYC   0   /* cycle counter w/K-best scheme (x86 & Alpha only) */
+#define USE_FCYC   0   /* cycle counter w/K-best scheme (x86, x86-64 & Alpha) */
 #define USE_ITIMER 0   /* interval timer (any Unix box) */
 #define USE_GETTOD 1   /* gettimeofday (any Unix box) */
 
+#if USE_FCYC
+#define DEFAULT_TIMER FSECS_FCYC
+#elif USE_ITIMER
+#define DEFAULT_TIMER FSECS_ITIMER
+#else
+#define DEFAULT_TIMER FSECS_GETTOD
+#endif
+
 #endif /* __CONFIG_H */
@@ -0,0 +1,25 @@
+/*
+ * engine.c - The engine table for the mm.c and memlib.c it is linked
+ *     with. Built into mdriver as the default engine, and into every
+ *     engine shared object, where mdriver finds it with dlsym.
+ */
+#include "engine.h"
+#include "mm.h"
+#include "memlib.h"
+
+/* Engines built from allocators without a heap walker get a NULL entry */
+#pragma weak mm_heap_walk
+
+mm_engine_t mm_engine = {
+    "mm",
+    mm_init,
+    mm_malloc,
+    mm_free,
+    mm_realloc,
+    mm_heap_walk,
+    mem_init,
+    mem_reset_brk,
+    mem_heap_lo,
+    mem_heap_hi,
+    mem_heapsize
+};
@@ -0,0 +1,44 @@
+/*
+ * engine.h - An allocator engine: a malloc package together with the
+ *     simulated memory system it runs on, behind a table of functions.
+ *
+ * The driver always has the engine it was linked with (mm.c and
+ * memlib.c). Any number of others can be built as shared objects with
+ * "make <name>.so" from <name>.c and loaded at runtime with mdriver -e.
+ * Each shared object carries its own copy of memlib, so every engine
+ * has a heap of its own.
+ */
+#ifndef __ENGINE_H_
+#define __ENGINE_H_
+
+#include <stddef.h>
+
+/* The symbol every engine shared object exports its table under */
+#define ENGINE_SYMBOL "mm_engine"
+
+typedef struct {
+    char *name;                               /* shown in driver output */
+
+    /* The malloc package */
+    int (*init)(void);                        /* mm_init */
+    void *(*malloc)(size_t size);             /* mm_malloc */
+    void (*free)(void *ptr);                  /* mm_free */
+    void *(*realloc)(void *ptr, size_t size); /* mm_realloc */
+    void (*heap_walk)(void (*f)(void *bp, size_t size, int alloc, void *arg),
+		      void *arg);             /* mm_heap_walk, may be NULL */
+
+    /* The memory system it allocates from */
+    void (*heap_init)(void);                  /* mem_init */
+    void (*heap_reset)(void);                 /* mem_reset_brk */
+    void *(*heap_lo)(void);                   /* mem_heap_lo */
+    void *(*heap_hi)(void);                   /* mem_heap_hi */
+    size_t (*heapsize)(void);                 /* mem_heapsize */
+} mm_engine_t;
+
+/* The engine made of the mm.c and memlib.c it is linked with */
+extern mm_engine_t mm_engine;
+
+/* Load the engine in shared object path, or return NULL */
+mm_engine_t *engine_load(char *path);
+
+#endif /* __ENGINE_H_ */
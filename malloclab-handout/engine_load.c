@@ -0,0 +1,42 @@
+/*
+ * engine_load.c - Load allocator engines built as shared objects
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dlfcn.h>
+
+#include "engine.h"
+
+/*
+ * engine_load - dlopen the engine in path and return its table, named
+ *     after the file. Each engine is opened RTLD_LOCAL so that the
+ *     mm_* and mem_* symbols of different engines never collide.
+ */
+mm_engine_t *engine_load(char *path)
+{
+    void *handle;
+    mm_engine_t *engine, *copy;
+    char *base;
+
+    if ((handle = dlopen(path, RTLD_NOW | RTLD_LOCAL)) == NULL) {
+	fprintf(stderr, "engine_load: %s\n", dlerror());
+	return NULL;
+    }
+    if ((engine = (mm_engine_t *)dlsym(handle, ENGINE_SYMBOL)) == NULL) {
+	fprintf(stderr, "engine_load: %s has no %s table\n",
+		path, ENGINE_SYMBOL);
+	dlclose(handle);
+	return NULL;
+    }
+
+    /* Copy the table so it can be renamed after the shared object */
+    if ((copy = malloc(sizeof(mm_engine_t))) == NULL) {
+	dlclose(handle);
+	return NULL;
+    }
+    *copy = *engine;
+    base = strrchr(path, '/');
+    copy->name = strdup(base ? base + 1 : path);
+    return copy;
+}
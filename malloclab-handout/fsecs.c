@@ -2,6 +2,7 @@
  * High-level timing wrappers
  ****************************/
 #include <stdio.h>
+#include <string.h>
 #include "fsecs.h"
 #include "fcyc.h"
 #include "clock.h"
@@ -9,34 +10,46 @@
 #include "config.h"
 
 static double Mhz;  /* estimated CPU clock frequency */
+static fsecs_timer_t timer; /* timing method selected by init_fsecs */
+
+static char *timer_names[] = {"fcyc", "itimer", "gettod"};
 
 extern int verbose; /* -v option in mdriver.c */
 
 /*
  * init_fsecs - initialize the timing package
  */
-void init_fsecs(void)
+void init_fsecs(fsecs_timer_t timer_arg)
 {
     Mhz = 0; /* keep gcc -Wall happy */
+    timer = timer_arg;
+
+    switch (timer) {
+    case FSECS_FCYC:
+	if (verbose)
+	    printf("Measuring performance with a cycle counter.\n");
+	if (!counter_invariant())
+	    printf("WARNING: cycle counter rate is not invariant, "
+		   "timings may be inaccurate.\n");
 
-#if USE_FCYC
-    if (verbose)
-	printf("Measuring performance with a cycle counter.\n");
-
-    /* set key parameters for the fcyc package */
-    set_fcyc_maxsamples(20); 
-    set_fcyc_clear_cache(1);
-    set_fcyc_compensate(1);
-    set_fcyc_epsilon(0.01);
-    set_fcyc_k(3);
-    Mhz = mhz(verbose > 0);
-#elif USE_ITIMER
-    if (verbose)
-	printf("Measuring performance with the interval timer.\n");
-#elif USE_GETTOD
-    if (verbose)
-	printf("Measuring performance with gettimeofday().\n");
-#endif
+	/* set key parameters for the fcyc package */
+	set_fcyc_maxsamples(20); 
+	set_fcyc_clear_cache(1);
+	set_fcyc_compensate(1);
+	set_fcyc_epsilon(0.01);
+	set_fcyc_k(3);
+	Mhz = counter_invariant() ? mhz_calibrate(verbose > 0, 200)
+				  : mhz(verbose > 0);
+	break;
+    case FSECS_ITIMER:
+	if (verbose)
+	    printf("Measuring performance with the interval timer.\n");
+	break;
+    case FSECS_GETTOD:
+	if (verbose)
+	    printf("Measuring performance with gettimeofday().\n");
+	break;
+    }
 }
 
 /*
@@ -44,14 +57,65 @@ void init_fsecs(void)
  */
 double fsecs(fsecs_test_funct f, void *argp) 
 {
-#if USE_FCYC
-    double cycles = fcyc(f, argp);
-    return cycles/(Mhz*1e6);
-#elif USE_ITIMER
-    return ftimer_itimer(f, argp, 10);
-#elif USE_GETTOD
-    return ftimer_gettod(f, argp, 10);
-#endif 
+    switch (timer) {
+    case FSECS_FCYC:
+	return fcyc(f, argp)/(Mhz*1e6);
+    case FSECS_ITIMER:
+	return ftimer_itimer(f, argp, 10);
+    case FSECS_GETTOD:
+    default:
+	return ftimer_gettod(f, argp, 10);
+    }
+}
+
+/*
+ * fsecs_n - Return the average running time of n back-to-back runs of
+ *     f (in seconds), for callers that do their own repetition
+ */
+double fsecs_n(fsecs_test_funct f, void *argp, int n)
+{
+    int i;
+
+    switch (timer) {
+    case FSECS_FCYC:
+	start_counter();
+	for (i = 0; i < n; i++)
+	    f(argp);
+	return get_counter()/(Mhz*1e6)/n;
+    case FSECS_ITIMER:
+	return ftimer_itimer(f, argp, n);
+    case FSECS_GETTOD:
+    default:
+	return ftimer_gettod(f, argp, n);
+    }
+}
+
+/*
+ * fsecs_once - Return the running time of a single run of f (in
+ *     seconds), for callers that do their own repetition
+ */
+double fsecs_once(fsecs_test_funct f, void *argp)
+{
+    return fsecs_n(f, argp, 1);
 }
 
+/*
+ * fsecs_parse_timer - Map a timer name to a timer, or -1 if unknown
+ */
+int fsecs_parse_timer(char *name)
+{
+    int i;
 
+    for (i = 0; i < sizeof(timer_names)/sizeof(char *); i++)
+	if (!strcmp(name, timer_names[i]))
+	    return i;
+    return -1;
+}
+
+/*
+ * fsecs_timer_name - The name of the timer selected by init_fsecs
+ */
+char *fsecs_timer_name(void)
+{
+    return timer_names[timer];
+}
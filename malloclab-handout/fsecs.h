@@ -1,4 +1,19 @@
 typedef void (*fsecs_test_funct)(void *);
 
-void init_fsecs(void);
+/* The timing methods fsecs can use (see config.h for the default) */
+typedef enum {FSECS_FCYC, FSECS_ITIMER, FSECS_GETTOD} fsecs_timer_t;
+
+void init_fsecs(fsecs_timer_t timer);
 double fsecs(fsecs_test_funct f, void *argp);
+
+/* Time a single run of f, without any averaging or K-best scheme */
+double fsecs_once(fsecs_test_funct f, void *argp);
+
+/* Average time of n back-to-back runs of f, like fsecs_once otherwise */
+double fsecs_n(fsecs_test_funct f, void *argp, int n);
+
+/* Map a timer name ("fcyc", "itimer" or "gettod") to a timer, or -1 */
+int fsecs_parse_timer(char *name);
+
+/* The name of the timer selected by init_fsecs */
+char *fsecs_timer_name(void);
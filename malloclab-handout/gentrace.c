@@ -0,0 +1,578 @@
+/*
+ * gentrace.c - Synthetic workload generator for the malloc driver
+ *
+ * Emits a tracefile in the format read by read_trace() in mdriver.c:
+ * a four line header (suggested heap size, number of ids, number of
+ * ops, weight) followed by one "a <id> <size>", "r <id> <size>" or
+ * "f <id>" request per line.
+ *
+ * The workload is produced by a small discrete event simulation. New
+ * blocks are allocated one per op; every block draws a size from the
+ * size distribution of the current phase and a lifetime (in ops) from
+ * the lifetime distribution, which schedules its free. Blocks may
+ * also start a realloc growth chain, which schedules a series of
+ * reallocs before the free. In producer/consumer mode lifetimes are
+ * ignored and blocks are freed in allocation (FIFO) order by a
+ * consumer that lags the producer by a fixed queue depth. In request
+ * mode, blocks are allocated by requests, one after the other, and each
+ * request frees all of its blocks when it ends.
+ *
+ * All randomness comes from a private generator seeded with -s, so a
+ * given command line always produces the same trace on any machine.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <math.h>
+
+/**********************
+ * Constants and macros
+ **********************/
+
+#define MAXDISTS     16      /* max number of -d size distributions */
+#define MAXCLASSES   64      /* max number of sizes in a classes: list */
+#define MAXSIZE      (1<<24) /* largest request we will ever emit */
+
+/*******************
+ * Model parameters
+ *******************/
+
+/* A distribution of request sizes */
+typedef struct {
+    enum {POWER, BIMODAL, CLASSES, FIXED} kind;
+    double alpha;           /* power: tail exponent */
+    int lo, hi;             /* power: bounds; bimodal: small and large */
+    double p;               /* bimodal: probability of a large request */
+    int nclasses;           /* classes: number of sizes */
+    int classes[MAXCLASSES];/* classes: the sizes, drawn uniformly */
+} sizedist_t;
+
+/* A distribution of block lifetimes, in ops */
+typedef struct {
+    enum {LEXP, LUNIFORM, LFIXED} kind;
+    double mean;            /* exp: mean lifetime */
+    int lo, hi;             /* uniform: bounds; fixed: lo */
+} lifedist_t;
+
+/* A pending free or realloc request */
+typedef struct {
+    long due;               /* op number at which the event fires */
+    long seq;               /* tie breaker, keeps the order stable */
+    int id;                 /* block the event applies to */
+    int growth;             /* > 0: realloc number in chain, 0: free */
+} event_t;
+
+/* One emitted request */
+typedef struct {
+    char type;              /* 'a', 'r' or 'f' */
+    int id;
+    int size;
+} op_t;
+
+/********************
+ * Global variables
+ *******************/
+static sizedist_t dists[MAXDISTS];
+static int ndists = 0;
+static lifedist_t life = {LEXP, 100.0, 0, 0};
+
+static int num_ids = 1000;      /* number of blocks to allocate (-n) */
+static int nphases = 1;         /* number of phases (-p) */
+static double chain_prob = 0.0; /* probability a block starts a chain */
+static double chain_growth = 1.5;/* size factor per realloc in a chain */
+static int chain_len = 4;       /* reallocs per chain */
+static int pc_depth = 0;        /* producer/consumer queue depth (-q) */
+static int req_blocks = 0;      /* request mode: mean blocks per request (-R) */
+
+static unsigned long long rng_state;
+
+static event_t *events = NULL;  /* binary min-heap of pending events */
+static int nevents = 0;
+static long event_seq = 0;
+
+static op_t *ops = NULL;        /* the generated trace */
+static long num_ops = 0;
+static long max_ops = 0;
+
+/*********************
+ * Function prototypes
+ *********************/
+static void parse_sizedist(char *spec);
+static void parse_lifedist(char *spec);
+static void parse_chain(char *spec);
+static void generate(void);
+static void generate_requests(void);
+static void write_trace(FILE *fp);
+static void usage(void);
+static void app_error(char *msg);
+static void unix_error(char *msg);
+
+/**************
+ * Main routine
+ **************/
+int main(int argc, char **argv)
+{
+    int c;
+    char *outfile = NULL;
+    unsigned long long seed = 1;
+    FILE *fp;
+
+    while ((c = getopt(argc, argv, "d:l:n:p:r:q:R:s:o:h")) != EOF) {
+        switch (c) {
+	case 'd': /* Add a size distribution (one per phase, cycled) */
+	    parse_sizedist(optarg);
+	    break;
+	case 'l': /* Lifetime distribution */
+	    parse_lifedist(optarg);
+	    break;
+	case 'n': /* Number of blocks (ids) to allocate */
+	    num_ids = atoi(optarg);
+	    break;
+	case 'p': /* Number of phases */
+	    nphases = atoi(optarg);
+	    break;
+	case 'r': /* Realloc growth chains */
+	    parse_chain(optarg);
+	    break;
+	case 'q': /* Producer/consumer mode with the given queue depth */
+	    pc_depth = atoi(optarg);
+	    break;
+	case 'R': /* Request mode with the given mean blocks per request */
+	    req_blocks = atoi(optarg);
+	    break;
+	case 's': /* Random seed */
+	    seed = strtoull(optarg, NULL, 0);
+	    break;
+	case 'o': /* Output file (default stdout) */
+	    outfile = optarg;
+	    break;
+        case 'h': /* Print this message */
+	    usage();
+            exit(0);
+        default:
+	    usage();
+            exit(1);
+        }
+    }
+
+    if (num_ids <= 0 || nphases <= 0 || pc_depth < 0 || req_blocks < 0)
+	app_error("gentrace: -n and -p must be positive, -q and -R non-negative");
+    if (req_blocks > 0 && (pc_depth > 0 || chain_prob > 0))
+	app_error("gentrace: -R can't be combined with -q or -r");
+    if (ndists == 0)
+	parse_sizedist("power:1.5:8:4096");
+
+    rng_state = seed;
+    if (req_blocks > 0)
+	generate_requests();
+    else
+	generate();
+
+    if (outfile) {
+	if ((fp = fopen(outfile, "w")) == NULL)
+	    unix_error("gentrace: could not open output file");
+    }
+    else
+	fp = stdout;
+    write_trace(fp);
+    if (fp != stdout)
+	fclose(fp);
+
+    free(ops);
+    free(events);
+    exit(0);
+}
+
+
+/***********************************************************
+ * Random numbers. splitmix64 is used instead of rand() so
+ * that traces are identical across C libraries.
+ ***********************************************************/
+
+static unsigned long long rng_next(void)
+{
+    unsigned long long z = (rng_state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/* rng_uniform - uniform double in [0, 1) */
+static double rng_uniform(void)
+{
+    return (rng_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* rng_range - uniform integer in [lo, hi] */
+static int rng_range(int lo, int hi)
+{
+    return lo + (int)(rng_uniform() * (hi - lo + 1));
+}
+
+
+/*******************************************************
+ * The following routines parse and sample the models
+ ******************************************************/
+
+/*
+ * parse_sizedist - parse a size distribution spec of the form
+ *     power:<alpha>:<min>:<max>, bimodal:<small>:<large>:<p_large>,
+ *     classes:<s1>,<s2>,... or fixed:<size>
+ */
+static void parse_sizedist(char *spec)
+{
+    sizedist_t *d;
+    char *s;
+
+    if (ndists == MAXDISTS)
+	app_error("gentrace: too many size distributions");
+    d = &dists[ndists];
+    memset(d, 0, sizeof(*d));
+
+    if (sscanf(spec, "power:%lf:%d:%d", &d->alpha, &d->lo, &d->hi) == 3) {
+	d->kind = POWER;
+	if (d->alpha <= 0 || d->lo <= 0 || d->hi < d->lo)
+	    app_error("gentrace: bad power distribution");
+    }
+    else if (sscanf(spec, "bimodal:%d:%d:%lf", &d->lo, &d->hi, &d->p) == 3) {
+	d->kind = BIMODAL;
+	if (d->lo <= 0 || d->hi <= 0 || d->p < 0 || d->p > 1)
+	    app_error("gentrace: bad bimodal distribution");
+    }
+    else if (!strncmp(spec, "classes:", 8)) {
+	d->kind = CLASSES;
+	for (s = spec + 8; *s && d->nclasses < MAXCLASSES; s++) {
+	    d->classes[d->nclasses++] = atoi(s);
+	    if (d->classes[d->nclasses-1] <= 0)
+		app_error("gentrace: bad size in classes list");
+	    if ((s = strchr(s, ',')) == NULL)
+		break;
+	}
+    }
+    else if (sscanf(spec, "fixed:%d", &d->lo) == 1 && d->lo > 0) {
+	d->kind = FIXED;
+    }
+    else {
+	fprintf(stderr, "gentrace: unknown size distribution \"%s\"\n", spec);
+	exit(1);
+    }
+    ndists++;
+}
+
+/*
+ * parse_lifedist - parse a lifetime spec of the form exp:<mean>,
+ *     uniform:<min>:<max> or fixed:<ops>
+ */
+static void parse_lifedist(char *spec)
+{
+    if (sscanf(spec, "exp:%lf", &life.mean) == 1 && life.mean > 0)
+	life.kind = LEXP;
+    else if (sscanf(spec, "uniform:%d:%d", &life.lo, &life.hi) == 2 &&
+	     life.lo > 0 && life.hi >= life.lo)
+	life.kind = LUNIFORM;
+    else if (sscanf(spec, "fixed:%d", &life.lo) == 1 && life.lo > 0)
+	life.kind = LFIXED;
+    else {
+	fprintf(stderr, "gentrace: unknown lifetime distribution \"%s\"\n",
+		spec);
+	exit(1);
+    }
+}
+
+/*
+ * parse_chain - parse a realloc chain spec <prob>[:<growth>[:<length>]]
+ */
+static void parse_chain(char *spec)
+{
+    if (sscanf(spec, "%lf:%lf:%d", &chain_prob, &chain_growth,
+	       &chain_len) < 1 ||
+	chain_prob < 0 || chain_prob > 1 || chain_growth <= 0 ||
+	chain_len <= 0)
+	app_error("gentrace: bad realloc chain spec");
+}
+
+/* sample_size - draw a request size from distribution d */
+static int sample_size(sizedist_t *d)
+{
+    double u, la, ha;
+
+    switch (d->kind) {
+    case POWER: /* inverse CDF of the Pareto distribution bounded to [lo,hi] */
+	u = rng_uniform();
+	la = pow(d->lo, d->alpha);
+	ha = pow(d->hi, d->alpha);
+	return (int)pow((ha - u * (ha - la)) / (ha * la), -1.0 / d->alpha);
+    case BIMODAL:
+	return (rng_uniform() < d->p) ? d->hi : d->lo;
+    case CLASSES:
+	return d->classes[rng_range(0, d->nclasses - 1)];
+    case FIXED:
+    default:
+	return d->lo;
+    }
+}
+
+/* sample_lifetime - draw a block lifetime (in ops, at least 1) */
+static long sample_lifetime(void)
+{
+    switch (life.kind) {
+    case LEXP:
+	return 1 + (long)(-life.mean * log(1.0 - rng_uniform()));
+    case LUNIFORM:
+	return rng_range(life.lo, life.hi);
+    case LFIXED:
+    default:
+	return life.lo;
+    }
+}
+
+
+/*******************************************************
+ * The following routines manipulate the event queue
+ ******************************************************/
+
+static int event_less(event_t *a, event_t *b)
+{
+    return (a->due < b->due) || (a->due == b->due && a->seq < b->seq);
+}
+
+/* push_event - schedule an event on the min-heap */
+static void push_event(long due, int id, int growth)
+{
+    int i = nevents++;
+    event_t e;
+
+    e.due = due;
+    e.seq = event_seq++;
+    e.id = id;
+    e.growth = growth;
+    while (i > 0 && event_less(&e, &events[(i-1)/2])) {
+	events[i] = events[(i-1)/2];
+	i = (i-1)/2;
+    }
+    events[i] = e;
+}
+
+/* pop_event - remove the earliest event from the min-heap */
+static event_t pop_event(void)
+{
+    event_t top = events[0];
+    event_t last = events[--nevents];
+    int i = 0, child;
+
+    while ((child = 2*i + 1) < nevents) {
+	if (child + 1 < nevents && event_less(&events[child+1], &events[child]))
+	    child++;
+	if (!event_less(&events[child], &last))
+	    break;
+	events[i] = events[child];
+	i = child;
+    }
+    events[i] = last;
+    return top;
+}
+
+
+/*******************************************************
+ * The following routines build and write the trace
+ ******************************************************/
+
+static void emit(char type, int id, int size)
+{
+    if (num_ops == max_ops)
+	app_error("gentrace: op buffer overflow");
+    ops[num_ops].type = type;
+    ops[num_ops].id = id;
+    ops[num_ops].size = size;
+    num_ops++;
+}
+
+/*
+ * generate - run the simulation, filling in ops[]
+ */
+static void generate(void)
+{
+    int *sizes;          /* current payload size of each block, -1 if freed */
+    int next_id = 0;     /* next block to allocate */
+    int next_free = 0;   /* producer/consumer: oldest unfreed block */
+    int phase_len = (num_ids + nphases - 1) / nphases;
+    int size, newsize, chain, k;
+    long lifetime;
+    event_t e;
+
+    /* Every block contributes an alloc, a free and up to chain_len reallocs */
+    max_ops = (long)num_ids * (2 + chain_len);
+    if ((ops = malloc(max_ops * sizeof(op_t))) == NULL ||
+	(events = malloc(max_ops * sizeof(event_t))) == NULL ||
+	(sizes = malloc(num_ids * sizeof(int))) == NULL)
+	unix_error("gentrace: malloc failed in generate");
+
+    while (next_id < num_ids || nevents > 0) {
+	/* Fire every event that is due, earliest first */
+	if (nevents > 0 && (events[0].due <= num_ops || next_id == num_ids)) {
+	    e = pop_event();
+	    if (e.growth == 0) {
+		emit('f', e.id, 0);
+		sizes[e.id] = -1;
+	    }
+	    else if (sizes[e.id] >= 0) {
+		newsize = (int)(sizes[e.id] * chain_growth) + 1;
+		sizes[e.id] = (newsize > MAXSIZE) ? MAXSIZE : newsize;
+		emit('r', e.id, sizes[e.id]);
+	    }
+	    continue;
+	}
+
+	/* Otherwise the producer allocates a new block */
+	size = sample_size(&dists[(next_id / phase_len) % ndists]);
+	sizes[next_id] = (size > MAXSIZE) ? MAXSIZE : size;
+	emit('a', next_id, sizes[next_id]);
+
+	/*
+	 * Schedule its death. A chain's reallocs are spread evenly over
+	 * the block's lifetime so they always precede the free.
+	 */
+	chain = (chain_prob > 0 && rng_uniform() < chain_prob) ? chain_len : 0;
+	if (pc_depth > 0) {
+	    lifetime = 0;
+	    for (k = 1; k <= chain; k++)
+		push_event(num_ops + k, next_id, k);
+	}
+	else {
+	    lifetime = sample_lifetime() + chain;
+	    for (k = 1; k <= chain; k++)
+		push_event(num_ops + lifetime * k / (chain + 1), next_id, k);
+	    push_event(num_ops + lifetime, next_id, 0);
+	}
+	next_id++;
+
+	/* In producer/consumer mode the consumer frees in FIFO order */
+	if (pc_depth > 0) {
+	    while (next_id - next_free > pc_depth ||
+		   (next_id == num_ids && next_free < num_ids)) {
+		emit('f', next_free, 0);
+		sizes[next_free++] = -1;
+	    }
+	}
+    }
+
+    free(sizes);
+}
+
+/*
+ * generate_requests - fill in ops[] with requests of 1 to 2 * req_blocks
+ *     - 1 blocks each, which free their blocks, in allocation order,
+ *     when they end
+ */
+static void generate_requests(void)
+{
+    int phase_len = (num_ids + nphases - 1) / nphases;
+    int next_id = 0, first, n, size;
+
+    max_ops = 2 * (long)num_ids;
+    if ((ops = malloc(max_ops * sizeof(op_t))) == NULL)
+	unix_error("gentrace: malloc failed in generate_requests");
+
+    while (next_id < num_ids) {
+	n = rng_range(1, 2 * req_blocks - 1);
+	if (n > num_ids - next_id)
+	    n = num_ids - next_id;
+	for (first = next_id; next_id < first + n; next_id++) {
+	    size = sample_size(&dists[(next_id / phase_len) % ndists]);
+	    emit('a', next_id, (size > MAXSIZE) ? MAXSIZE : size);
+	}
+	for (; first < next_id; first++)
+	    emit('f', first, 0);
+    }
+}
+
+/*
+ * write_trace - write the header and the ops in tracefile format
+ */
+static void write_trace(FILE *fp)
+{
+    long i;
+    long live = 0, peak = 0;
+    int *sizes;
+
+    /* The suggested heap size is the peak number of live payload bytes */
+    if ((sizes = calloc(num_ids, sizeof(int))) == NULL)
+	unix_error("gentrace: calloc failed in write_trace");
+    for (i = 0; i < num_ops; i++) {
+	switch (ops[i].type) {
+	case 'a':
+	case 'r':
+	    live += ops[i].size - sizes[ops[i].id];
+	    sizes[ops[i].id] = ops[i].size;
+	    break;
+	case 'f':
+	    live -= sizes[ops[i].id];
+	    sizes[ops[i].id] = 0;
+	    break;
+	}
+	peak = (live > peak) ? live : peak;
+    }
+    free(sizes);
+
+    fprintf(fp, "%ld\n%d\n%ld\n%d\n", peak, num_ids, num_ops, 1);
+    for (i = 0; i < num_ops; i++) {
+	if (ops[i].type == 'f')
+	    fprintf(fp, "f %d\n", ops[i].id);
+	else
+	    fprintf(fp, "%c %d %d\n", ops[i].type, ops[i].id, ops[i].size);
+    }
+}
+
+
+/*************************************
+ * Some miscellaneous helper routines
+ ************************************/
+
+/*
+ * app_error - Report an arbitrary application error
+ */
+static void app_error(char *msg)
+{
+    fprintf(stderr, "%s\n", msg);
+    exit(1);
+}
+
+/*
+ * unix_error - Report a Unix-style error
+ */
+static void unix_error(char *msg)
+{
+    fprintf(stderr, "%s: %s\n", msg, strerror(errno));
+    exit(1);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: gentrace [-h] [-d <dist>]... [-l <life>] [-n <ids>] [-p <phases>]\n");
+    fprintf(stderr, "                [-r <chain>] [-q <depth>] [-R <blocks>] [-s <seed>] [-o <file>]\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-d <dist>   Size distribution, repeat for one per phase:\n");
+    fprintf(stderr, "\t              power:<alpha>:<min>:<max>  (default power:1.5:8:4096)\n");
+    fprintf(stderr, "\t              bimodal:<small>:<large>:<p_large>\n");
+    fprintf(stderr, "\t              classes:<s1>,<s2>,...\n");
+    fprintf(stderr, "\t              fixed:<size>\n");
+    fprintf(stderr, "\t-h          Print this message.\n");
+    fprintf(stderr, "\t-l <life>   Lifetime in ops: exp:<mean> (default exp:100),\n");
+    fprintf(stderr, "\t              uniform:<min>:<max> or fixed:<n>.\n");
+    fprintf(stderr, "\t-n <ids>    Number of blocks to allocate (default 1000).\n");
+    fprintf(stderr, "\t-o <file>   Write the trace to <file> instead of stdout.\n");
+    fprintf(stderr, "\t-p <phases> Split the run into phases cycling through the -d\n");
+    fprintf(stderr, "\t              distributions (default 1).\n");
+    fprintf(stderr, "\t-q <depth>  Producer/consumer mode: free in FIFO order,\n");
+    fprintf(stderr, "\t              <depth> blocks behind the producer.\n");
+    fprintf(stderr, "\t-R <blocks> Request mode: requests of <blocks> blocks on average,\n");
+    fprintf(stderr, "\t              each freeing all of them when it ends.\n");
+    fprintf(stderr, "\t-r <chain>  Realloc growth chains <prob>[:<growth>[:<len>]]\n");
+    fprintf(stderr, "\t              (defaults growth 1.5, len 4).\n");
+    fprintf(stderr, "\t-s <seed>   Random seed (default 1).\n");
+}
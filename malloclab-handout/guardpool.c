@@ -0,0 +1,285 @@
+/*
+ * guardpool.c - Sampled guard-page allocations (see guardpool.h)
+ *
+ * The pool is 2 * nslots + 1 pages taken from the top of the reserved
+ * heap: page 2i + 1 is slot i and the even pages are guards, so every
+ * slot has a guard on both sides. Slots are PROT_NONE except while they
+ * hold a live block. Free slots wait in a FIFO queue, so that a freed
+ * slot stays protected for as long as possible before it is reused.
+ *
+ * The slot table and the queue are mapped with mmap, since the pool
+ * runs inside malloc, and the fault handler only uses write().
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <limits.h>
+#include <signal.h>
+#include <time.h>
+#include <execinfo.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "guardpool.h"
+#include "memlib.h"
+
+#define GP_MAXDEPTH 32          /* frames kept per stack */
+#define GP_MAXLINE  256
+
+/* What a slot holds */
+#define SLOT_UNUSED 0           /* never allocated */
+#define SLOT_LIVE   1           /* an allocated block */
+#define SLOT_FREED  2           /* a block that was freed since */
+
+typedef struct {
+    int state;
+    char *bp;                   /* the block, if any */
+    size_t size;                /* its requested size */
+    int alloc_depth, free_depth;
+    void *alloc_pc[GP_MAXDEPTH];
+    void *free_pc[GP_MAXDEPTH];
+} slot_t;
+
+long guard_countdown = LONG_MAX;
+uintptr_t guard_lo = 0;
+size_t guard_len = 0;
+
+static long sample_rate;
+static unsigned long long rng;
+static size_t page;
+static int nslots;
+static slot_t *slots = NULL;
+static int *queue = NULL;       /* free slots, oldest first */
+static int qhead = 0, qcount = 0;
+static int right_align = 0;     /* place the next block against the end */
+static struct sigaction old_segv;
+
+/*
+ * next_gap - Draw the number of allocations to let through before the
+ *     next sample, uniformly in [0, 2 * rate - 1), so that one in rate
+ *     is sampled on average
+ */
+static long next_gap(void)
+{
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return (long)(rng % (unsigned long long)(2 * sample_rate - 1));
+}
+
+static void *map_table(size_t bytes)
+{
+    void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return (p == MAP_FAILED) ? NULL : p;
+}
+
+/* First byte of slot i, which is page 2i + 1 of the pool */
+static char *slot_page(int i)
+{
+    return (char *)guard_lo + (2 * (size_t)i + 1) * page;
+}
+
+/*
+ * say - Write a line to stderr without allocating
+ */
+static void say(const char *fmt, ...)
+{
+    char line[GP_MAXLINE];
+    va_list ap;
+    int n;
+
+    va_start(ap, fmt);
+    n = vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    if (n > (int)sizeof(line) - 1)
+	n = sizeof(line) - 1;
+    if (write(STDERR_FILENO, line, n) < 0)
+	return;
+}
+
+/*
+ * describe - Print the block of a slot and the stacks that allocated
+ *     and freed it
+ */
+static void describe(slot_t *s)
+{
+    say("  %lu-byte block at %p, %s\n", (unsigned long)s->size, s->bp,
+	s->state == SLOT_FREED ? "freed" : "allocated");
+    say("  allocated by:\n");
+    backtrace_symbols_fd(s->alloc_pc, s->alloc_depth, STDERR_FILENO);
+    if (s->state == SLOT_FREED) {
+	say("  freed by:\n");
+	backtrace_symbols_fd(s->free_pc, s->free_depth, STDERR_FILENO);
+    }
+}
+
+/*
+ * guard_fault - SIGSEGV handler: diagnose faults in the pool and let the
+ *     program die of them; pass anything else on to the previous handler
+ */
+static void guard_fault(int sig, siginfo_t *si, void *ctx)
+{
+    uintptr_t addr = (uintptr_t)si->si_addr;
+    size_t pg;
+    slot_t *s, *left, *right;
+    long over, under;
+
+    if (addr - guard_lo >= guard_len) {
+	sigaction(SIGSEGV, &old_segv, NULL);
+	return;
+    }
+    signal(SIGSEGV, SIG_DFL);
+
+    pg = (addr - guard_lo) / page;
+    if (pg % 2 == 1) {
+	s = &slots[pg / 2];
+	if (s->state == SLOT_FREED) {
+	    say("guardpool: use after free at %p, %ld bytes into the block\n",
+		(void *)addr, (long)(addr - (uintptr_t)s->bp));
+	    describe(s);
+	}
+	else
+	    say("guardpool: wild access at %p, in an unused slot\n", (void *)addr);
+	return;
+    }
+
+    /* A guard page: blame the nearer of the blocks on either side */
+    left = (pg > 0 && slots[pg / 2 - 1].state != SLOT_UNUSED) ? &slots[pg / 2 - 1] : NULL;
+    right = (pg / 2 < (size_t)nslots && slots[pg / 2].state != SLOT_UNUSED) ? &slots[pg / 2] : NULL;
+    over = left ? (long)(addr - ((uintptr_t)left->bp + left->size)) : LONG_MAX;
+    under = right ? (long)((uintptr_t)right->bp - addr) : LONG_MAX;
+    if (left && over <= under) {
+	say("guardpool: buffer overflow at %p, %ld bytes past the end of the block\n",
+	    (void *)addr, over);
+	describe(left);
+    }
+    else if (right) {
+	say("guardpool: buffer underflow at %p, %ld bytes before the block\n",
+	    (void *)addr, under);
+	describe(right);
+    }
+    else
+	say("guardpool: wild access at %p, in a guard page\n", (void *)addr);
+}
+
+int guard_start(long rate, int n)
+{
+    struct sigaction sa;
+    void *pc[1];
+    char *pool;
+    size_t len;
+    int i;
+
+    if (guard_len != 0 || n <= 0)
+	return -1;
+
+    /* backtrace loads its unwinder, which allocates, on its first call */
+    backtrace(pc, 1);
+
+    page = mem_pagesize();
+    len = (2 * (size_t)n + 1) * page;
+    if ((pool = mem_reserve_top(len)) == NULL || mprotect(pool, len, PROT_NONE) < 0)
+	return -1;
+    if ((slots = map_table(n * sizeof(slot_t))) == NULL ||
+	(queue = map_table(n * sizeof(int))) == NULL)
+	return -1;
+    for (i = 0; i < n; i++)
+	queue[i] = i;
+    nslots = qcount = n;
+
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_sigaction = guard_fault;
+    sa.sa_flags = SA_SIGINFO;
+    sigemptyset(&sa.sa_mask);
+    if (sigaction(SIGSEGV, &sa, &old_segv) < 0)
+	return -1;
+
+    guard_lo = (uintptr_t)pool;
+    guard_len = len;
+    rng = (unsigned long long)time(NULL) * 0x9E3779B97F4A7C15ULL | 1;
+    sample_rate = (rate > 0) ? rate : 1;
+    guard_countdown = next_gap();
+    return 0;
+}
+
+/*
+ * guard_malloc - Put a block of size bytes aligned to align in the
+ *     oldest free slot, or return NULL if it doesn't fit in a page or
+ *     no slot is free, and draw the next gap
+ */
+void *guard_malloc(size_t size, size_t align)
+{
+    slot_t *s;
+    char *slot;
+    int i;
+
+    guard_countdown = (guard_len != 0) ? next_gap() : LONG_MAX;
+    if (guard_len == 0 || size == 0 || size > page || align > page || qcount == 0)
+	return NULL;
+
+    i = queue[qhead];
+    slot = slot_page(i);
+    if (mprotect(slot, page, PROT_READ | PROT_WRITE) < 0)
+	return NULL;
+    qhead = (qhead + 1) % nslots;
+    qcount--;
+
+    s = &slots[i];
+    s->state = SLOT_LIVE;
+    s->size = size;
+    right_align = !right_align;
+    if (right_align)
+	s->bp = (char *)(((uintptr_t)slot + page - size) & ~(uintptr_t)(align - 1));
+    else
+	s->bp = slot;
+    s->alloc_depth = backtrace(s->alloc_pc, GP_MAXDEPTH);
+    s->free_depth = 0;
+    return s->bp;
+}
+
+/*
+ * guard_slot - The slot whose live block starts at bp, or NULL after
+ *     reporting a double or invalid free
+ */
+static slot_t *guard_slot(void *bp, const char *where)
+{
+    size_t pg = ((uintptr_t)bp - guard_lo) / page;
+    slot_t *s = (pg % 2 == 1) ? &slots[pg / 2] : NULL;
+
+    if (s && s->state == SLOT_LIVE && s->bp == bp)
+	return s;
+    if (s && s->state == SLOT_FREED && s->bp == bp) {
+	say("guardpool: double free of %p in %s\n", bp, where);
+	describe(s);
+    }
+    else
+	say("guardpool: invalid pointer %p in %s\n", bp, where);
+    return NULL;
+}
+
+/*
+ * guard_free - Protect the slot of bp and queue it for reuse. Double
+ *     and invalid frees are reported and ignored.
+ */
+void guard_free(void *bp)
+{
+    slot_t *s;
+
+    if ((s = guard_slot(bp, "mm_free")) == NULL)
+	return;
+    s->state = SLOT_FREED;
+    s->free_depth = backtrace(s->free_pc, GP_MAXDEPTH);
+    mprotect(slot_page(s - slots), page, PROT_NONE);
+    queue[(qhead + qcount) % nslots] = s - slots;
+    qcount++;
+}
+
+size_t guard_usable_size(void *bp)
+{
+    slot_t *s;
+
+    return ((s = guard_slot(bp, "mm_usable_size")) != NULL) ? s->size : 0;
+}
@@ -0,0 +1,52 @@
+/*
+ * guardpool.h - Sampled guard-page allocations for the mm package
+ *
+ * When mm.c is compiled with MM_GUARD and the pool is started, about
+ * one allocation in rate is served from a pool of slots, one page each,
+ * with a guard page on either side. A block is placed against the end
+ * of its slot or, every other time, against its start, so that running
+ * off either end faults on a guard page at once; on free its slot is
+ * protected, so that later reads and writes fault too, and slots are
+ * reused least recently freed first. The fault handler prints what was
+ * hit (overflow, underflow or use after free), the block and the stacks
+ * that allocated and freed it, then lets the program die of the fault.
+ *
+ * When the pool is not started, or between samples, mm_malloc pays a
+ * decrement and a branch, and mm_free a subtraction and a comparison.
+ * Like the rest of the mm package the pool is not thread safe: the
+ * caller serializes the allocator calls.
+ */
+#ifndef __GUARDPOOL_H_
+#define __GUARDPOOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Take nslots slots from the top of the reserved heap (mem_init_reserve)
+   and start sampling one allocation in about rate, -1 if there is no
+   room. It calls backtrace(), which allocates the first time: call it
+   outside the allocator. */
+int guard_start(long rate, int nslots);
+
+/* The hooks, called by mm.c */
+extern long guard_countdown;     /* allocations until the next sample */
+extern uintptr_t guard_lo;       /* first byte of the pool */
+extern size_t guard_len;         /* its size, 0 when not started */
+
+void *guard_malloc(size_t size, size_t align);
+void guard_free(void *bp);
+size_t guard_usable_size(void *bp);
+
+/* Serve the allocation from the pool when it is sampled and fits */
+#define GUARD_MALLOC(size, align)                                 \
+    do {                                                          \
+	void *gbp_;                                               \
+	if (--guard_countdown < 0 &&                              \
+	    (gbp_ = guard_malloc(size, align)) != NULL)           \
+	    return gbp_;                                          \
+    } while (0)
+
+/* Is bp in the pool? */
+#define GUARD_OWNS(bp) ((uintptr_t)(bp) - guard_lo < guard_len)
+
+#endif /* __GUARDPOOL_H_ */
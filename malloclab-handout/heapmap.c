@@ -0,0 +1,295 @@
+/*
+ * heapmap.c - Render the heap snapshots taken by mdriver -Z
+ *
+ * For each snapshot, prints a summary of the heap (blocks, live bytes,
+ * free bytes and external fragmentation), the free blocks by size, and
+ * a density map of the heap in which each character stands for an
+ * equal slice of the address range:
+ *
+ *     '#'   no free bytes in the slice
+ *     1-9   tenths of the slice that are free, rounded down
+ *     '.'   the whole slice is free
+ *
+ * so that holes, and where they are in the heap, show at a glance. With
+ * -p it also writes the map as a PGM image, one pixel per -s bytes,
+ * free in white and allocated in black, and with -j it converts the
+ * snapshot to JSON.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include "snapshot.h"
+
+/**********************
+ * Constants and macros
+ **********************/
+
+#define NBUCKETS   32           /* power of two buckets of free sizes */
+#define PGMWIDTH  512           /* width of the PGM images in pixels */
+#define MAXLINE  1024
+
+/*******************
+ * Global variables
+ *******************/
+static int map_cols = 64;       /* width of the ASCII map (-w) */
+static int map_rows = 32;       /* height of the ASCII map (-r) */
+static int write_pgm = 0;       /* write <snapshot>.pgm (-p) */
+static long pixel_bytes = 0;    /* bytes per pixel, 0 to fit 512x512 (-s) */
+static int write_json = 0;      /* write <snapshot>.json (-j) */
+
+/*********************
+ * Function prototypes
+ *********************/
+static void summary(char *name, snap_t *s);
+static double *free_density(snap_t *s, long cells, long cell_bytes);
+static void ascii_map(snap_t *s);
+static void pgm_map(char *path, snap_t *s);
+static void usage(void);
+static void unix_error(char *msg);
+
+/**************
+ * Main routine
+ **************/
+int main(int argc, char **argv)
+{
+    int c, i;
+    char path[MAXLINE];
+    snap_t s;
+    FILE *fp;
+
+    while ((c = getopt(argc, argv, "w:r:s:pjh")) != EOF) {
+        switch (c) {
+	case 'w': /* Width of the ASCII map */
+	    map_cols = atoi(optarg);
+	    break;
+	case 'r': /* Height of the ASCII map */
+	    map_rows = atoi(optarg);
+	    break;
+	case 's': /* Bytes per pixel of the PGM image */
+	    pixel_bytes = atol(optarg);
+	    break;
+	case 'p': /* Write a PGM image */
+	    write_pgm = 1;
+	    break;
+	case 'j': /* Write the snapshot as JSON */
+	    write_json = 1;
+	    break;
+        case 'h': /* Print this message */
+	    usage();
+            exit(0);
+        default:
+	    usage();
+            exit(1);
+        }
+    }
+
+    if (optind == argc || map_cols <= 0 || map_rows <= 0 || pixel_bytes < 0) {
+	usage();
+	exit(1);
+    }
+
+    for (i = optind; i < argc; i++) {
+	if (snap_read(&s, argv[i]) < 0) {
+	    sprintf(path, "Could not read snapshot %s", argv[i]);
+	    unix_error(path);
+	}
+	summary(argv[i], &s);
+	ascii_map(&s);
+	if (write_pgm) {
+	    sprintf(path, "%.*s.pgm", MAXLINE - 8, argv[i]);
+	    pgm_map(path, &s);
+	}
+	if (write_json) {
+	    sprintf(path, "%.*s.json", MAXLINE - 8, argv[i]);
+	    if ((fp = fopen(path, "w")) == NULL)
+		unix_error(path);
+	    snap_write_json(&s, fp);
+	    fclose(fp);
+	    printf("Wrote %s\n", path);
+	}
+	snap_free(&s);
+	if (i < argc - 1)
+	    printf("\n");
+    }
+    exit(0);
+}
+
+/*
+ * summary - Print the totals of a snapshot and its free blocks by size
+ */
+static void summary(char *name, snap_t *s)
+{
+    long nalloc = 0, nfree = 0, count[NBUCKETS];
+    unsigned long long free_bytes = 0, largest = 0, bytes[NBUCKETS], size;
+    snap_block_t *b;
+    uint32_t i;
+    int k;
+
+    memset(count, 0, sizeof(count));
+    memset(bytes, 0, sizeof(bytes));
+    for (i = 0; i < s->h.nblocks; i++) {
+	b = &s->blocks[i];
+	size = SNAP_SIZE(b);
+	if (SNAP_ALLOC(b)) {
+	    nalloc++;
+	    continue;
+	}
+	nfree++;
+	free_bytes += size;
+	if (size > largest)
+	    largest = size;
+	for (k = 0; k < NBUCKETS - 1 && (2ULL << k) <= size; k++)
+	    ;
+	count[k]++;
+	bytes[k] += size;
+    }
+
+    printf("%s: trace %d on %s after %d ops\n", name, s->h.trace,
+	   s->h.engine, s->h.op);
+    printf("  heap %llu bytes, %u blocks (%ld allocated, %ld free)\n",
+	   (unsigned long long)s->h.heapsize, s->h.nblocks, nalloc, nfree);
+    printf("  live payload %llu bytes (%.0f%% of the heap)\n",
+	   (unsigned long long)s->h.live,
+	   s->h.heapsize ? 100.0 * s->h.live / s->h.heapsize : 0.0);
+    printf("  free %llu bytes, largest free block %llu, external frag %.0f%%\n",
+	   free_bytes, largest,
+	   free_bytes ? 100.0 * (1.0 - (double)largest / free_bytes) : 0.0);
+    if (nfree == 0)
+	return;
+
+    printf("  %21s%9s%12s\n", "free block size", "blocks", "bytes");
+    for (k = 0; k < NBUCKETS; k++)
+	if (count[k] > 0)
+	    printf("  %10llu-%-10llu%9ld%12llu\n", 1ULL << k, (2ULL << k) - 1,
+		   count[k], bytes[k]);
+}
+
+/*
+ * free_density - Split the heap into cells of cell_bytes and return the
+ *     fraction of each that is covered by free blocks
+ */
+static double *free_density(snap_t *s, long cells, long cell_bytes)
+{
+    double *d;
+    snap_block_t *b;
+    unsigned long long lo, hi, cell_lo, cell_hi, end;
+    uint32_t i;
+    long c;
+
+    if ((d = calloc(cells, sizeof(double))) == NULL)
+	unix_error("calloc failed in free_density");
+    for (i = 0; i < s->h.nblocks; i++) {
+	b = &s->blocks[i];
+	if (SNAP_ALLOC(b))
+	    continue;
+	lo = b->offset;
+	hi = lo + SNAP_SIZE(b);
+	for (c = lo / cell_bytes; c < cells && (unsigned long long)c * cell_bytes < hi; c++) {
+	    cell_lo = (unsigned long long)c * cell_bytes;
+	    cell_hi = cell_lo + cell_bytes;
+	    d[c] += (double)((hi < cell_hi ? hi : cell_hi) - (lo > cell_lo ? lo : cell_lo));
+	}
+    }
+    /* The last cell may extend past the end of the heap */
+    for (c = 0; c < cells; c++) {
+	end = (unsigned long long)(c + 1) * cell_bytes;
+	if (end > s->h.heapsize)
+	    end = s->h.heapsize;
+	if (end > (unsigned long long)c * cell_bytes)
+	    d[c] /= end - (unsigned long long)c * cell_bytes;
+	else
+	    d[c] = 0.0;
+	if (d[c] > 1.0)
+	    d[c] = 1.0;
+    }
+    return d;
+}
+
+/*
+ * ascii_map - Print the density map in at most map_rows lines of
+ *     map_cols cells, each with the offset of its first byte
+ */
+static void ascii_map(snap_t *s)
+{
+    long cells = (long)map_cols * map_rows, cell_bytes, c;
+    double *d;
+    int tenths;
+
+    if (s->h.heapsize == 0)
+	return;
+    cell_bytes = (s->h.heapsize + cells - 1) / cells;
+    cell_bytes = (cell_bytes + 7) & ~7L;
+    cells = (s->h.heapsize + cell_bytes - 1) / cell_bytes;
+    d = free_density(s, cells, cell_bytes);
+
+    printf("  map: %ld bytes per character, '#' allocated, '.' free, 1-9 tenths free\n",
+	   cell_bytes);
+    for (c = 0; c < cells; c++) {
+	if (c % map_cols == 0)
+	    printf("  %10ld  ", c * cell_bytes);
+	tenths = (int)(d[c] * 10.0);
+	putchar(d[c] == 0.0 ? '#' : d[c] == 1.0 ? '.' : '0' + (tenths ? tenths : 1));
+	if (c % map_cols == map_cols - 1 || c == cells - 1)
+	    putchar('\n');
+    }
+    free(d);
+}
+
+/*
+ * pgm_map - Write the density map as a binary PGM image, PGMWIDTH
+ *     pixels wide, with one pixel per pixel_bytes bytes
+ */
+static void pgm_map(char *path, snap_t *s)
+{
+    long bpp = pixel_bytes, cells, rows, c;
+    double *d;
+    FILE *fp;
+
+    if (bpp == 0) {
+	/* The smallest power of two that fits the heap in a square */
+	for (bpp = 8; (unsigned long long)bpp * PGMWIDTH * PGMWIDTH < s->h.heapsize; bpp *= 2)
+	    ;
+    }
+    rows = (s->h.heapsize + (long)PGMWIDTH * bpp - 1) / ((long)PGMWIDTH * bpp);
+    if (rows == 0)
+	rows = 1;
+    cells = rows * PGMWIDTH;
+    d = free_density(s, cells, bpp);
+
+    if ((fp = fopen(path, "wb")) == NULL)
+	unix_error(path);
+    fprintf(fp, "P5\n%d %ld\n255\n", PGMWIDTH, rows);
+    for (c = 0; c < cells; c++)
+	fputc((int)(d[c] * 255.0 + 0.5), fp);
+    fclose(fp);
+    free(d);
+    printf("Wrote %s (%dx%ld, %ld bytes per pixel)\n", path, PGMWIDTH, rows, bpp);
+}
+
+/*
+ * unix_error - Report a Unix-style error
+ */
+static void unix_error(char *msg)
+{
+    printf("%s: %s\n", msg, strerror(errno));
+    exit(1);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: heapmap [-hjp] [-w <cols>] [-r <rows>] [-s <bytes>] <snapshot>...\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-h          Print this message.\n");
+    fprintf(stderr, "\t-j          Write each snapshot as JSON to <snapshot>.json.\n");
+    fprintf(stderr, "\t-p          Write each map as a PGM image to <snapshot>.pgm.\n");
+    fprintf(stderr, "\t-r <rows>   Rows of the ASCII map (default 32).\n");
+    fprintf(stderr, "\t-s <bytes>  Bytes per pixel of the PGM image (default: fit\n");
+    fprintf(stderr, "\t            the heap in a 512x512 image).\n");
+    fprintf(stderr, "\t-w <cols>   Width of the ASCII map (default 64).\n");
+}
@@ -0,0 +1,394 @@
+/*
+ * heapprof.c - Sampling heap profiler for the mm package
+ *
+ * The gap in bytes between two samples is drawn from an exponential
+ * distribution with mean rate, so every byte has the same chance of
+ * being sampled and an allocation of size bytes is sampled with
+ * probability 1 - exp(-size/rate), which pprof undoes when it reads a
+ * heap_v2 profile. A sampled block records its call stack in a bucket,
+ * one per distinct stack, holding the number and bytes of the sampled
+ * blocks allocated and freed at that stack, and its address in a table
+ * of live samples that maps it back to the bucket.
+ *
+ * A stack starts at the first frame outside the allocator: when the
+ * profiler is in a shared object (mmshim.so), the frames of that object
+ * at the top of the stack are left out, so that samples are charged to
+ * the code that called malloc.
+ *
+ * Both tables are mapped with mmap when the profiler starts and never
+ * grow, since the profiler runs inside malloc: when they fill up,
+ * further samples are dropped. Dumps only use write(), for the same
+ * reason.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <limits.h>
+#include <stdint.h>
+#include <math.h>
+#include <time.h>
+#include <execinfo.h>
+#include <link.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "heapprof.h"
+
+#define HP_MAXDEPTH 32          /* frames kept per stack */
+#define HP_MAXSKIP  8           /* allocator frames above them */
+#define HP_BUCKETS  (1 << 16)   /* distinct stacks, a power of two */
+#define HP_LIVE     (1 << 20)   /* live samples, a power of two */
+#define HP_BUFSIZE  4096        /* dump output buffer */
+
+/* The sampled blocks allocated at one call stack */
+typedef struct {
+    uint32_t hash;              /* 0 if the bucket is empty */
+    int depth;
+    void *pc[HP_MAXDEPTH];
+    long alloc_objs, alloc_bytes;
+    long free_objs, free_bytes;
+} bucket_t;
+
+/* A sampled block that is still allocated */
+typedef struct {
+    void *bp;                   /* NULL if the slot is empty */
+    bucket_t *bucket;
+    size_t size;
+} live_t;
+
+long heapprof_countdown = LONG_MAX;
+long heapprof_nlive = 0;
+
+static int active = 0;
+static long sample_rate;
+static uint64_t rng;
+static bucket_t *buckets = NULL;
+static long nbuckets = 0;
+static live_t *live = NULL;
+static uintptr_t self_lo = 0;   /* code of the shared object we are in, */
+static uintptr_t self_hi = 0;   /*   empty if we are in the program */
+
+/*
+ * next_gap - Draw the number of bytes until the next sample
+ */
+static long next_gap(void)
+{
+    double u;
+
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    u = ((rng >> 11) + 1) * (1.0 / 9007199254740992.0); /* (0, 1] */
+    return (long)(-log(u) * sample_rate) + 1;
+}
+
+/*
+ * find_self - dl_iterate_phdr callback: if the object of info holds the
+ *     code at arg and is not the program itself, note the bounds of its
+ *     executable segments
+ */
+static int find_self(struct dl_phdr_info *info, size_t size, void *arg)
+{
+    uintptr_t pc = (uintptr_t)arg, lo = UINTPTR_MAX, hi = 0, s, e;
+    int i, found = 0;
+
+    for (i = 0; i < info->dlpi_phnum; i++) {
+	if (info->dlpi_phdr[i].p_type != PT_LOAD || !(info->dlpi_phdr[i].p_flags & PF_X))
+	    continue;
+	s = info->dlpi_addr + info->dlpi_phdr[i].p_vaddr;
+	e = s + info->dlpi_phdr[i].p_memsz;
+	lo = (s < lo) ? s : lo;
+	hi = (e > hi) ? e : hi;
+	found |= (s <= pc && pc < e);
+    }
+    if (!found)
+	return 0;
+    if (info->dlpi_name != NULL && info->dlpi_name[0] != '\0') {
+	self_lo = lo;
+	self_hi = hi;
+    }
+    return 1;
+}
+
+static void *map_table(size_t bytes)
+{
+    void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    return (p == MAP_FAILED) ? NULL : p;
+}
+
+/*
+ * heapprof_start - Map the tables on the first call and start sampling
+ */
+int heapprof_start(long rate)
+{
+    void *pc[1];
+
+    if (buckets == NULL) {
+	/* backtrace loads its unwinder, which allocates, on its first
+	   call: get that over with outside the allocator */
+	backtrace(pc, 1);
+	dl_iterate_phdr(find_self, (void *)(uintptr_t)heapprof_sample);
+	if ((buckets = map_table(HP_BUCKETS * sizeof(bucket_t))) == NULL)
+	    return -1;
+	if ((live = map_table(HP_LIVE * sizeof(live_t))) == NULL) {
+	    munmap(buckets, HP_BUCKETS * sizeof(bucket_t));
+	    buckets = NULL;
+	    return -1;
+	}
+    }
+    rng = (uint64_t)time(NULL) * 0x9E3779B97F4A7C15ULL | 1;
+    sample_rate = (rate > 0) ? rate : 1;
+    heapprof_countdown = next_gap();
+    active = 1;
+    return 0;
+}
+
+void heapprof_stop(void)
+{
+    active = 0;
+    heapprof_countdown = LONG_MAX;
+}
+
+/*
+ * Live samples: open addressing on the block address, with backward
+ * shift deletion so that no tombstones are needed
+ */
+static size_t live_slot(void *bp)
+{
+    return (size_t)((((uintptr_t)bp >> 3) * 0x9E3779B97F4A7C15ULL) >> 24) &
+	(HP_LIVE - 1);
+}
+
+static live_t *live_find(void *bp)
+{
+    size_t i;
+
+    for (i = live_slot(bp); live[i].bp; i = (i + 1) & (HP_LIVE - 1))
+	if (live[i].bp == bp)
+	    return &live[i];
+    return NULL;
+}
+
+static void live_del(live_t *l)
+{
+    size_t i = l - live, j = i, k;
+
+    for (;;) {
+	j = (j + 1) & (HP_LIVE - 1);
+	if (!live[j].bp)
+	    break;
+	/* Move j back into the hole at i unless its home lies in (i, j] */
+	k = live_slot(live[j].bp);
+	if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j))
+	    continue;
+	live[i] = live[j];
+	i = j;
+    }
+    live[i].bp = NULL;
+    heapprof_nlive--;
+}
+
+static void live_put(void *bp, bucket_t *b, size_t size)
+{
+    size_t i;
+
+    for (i = live_slot(bp); live[i].bp; i = (i + 1) & (HP_LIVE - 1))
+	;
+    live[i].bp = bp;
+    live[i].bucket = b;
+    live[i].size = size;
+    heapprof_nlive++;
+}
+
+/*
+ * find_bucket - The bucket of a call stack, created if needed, or NULL
+ *     if the table is full
+ */
+static bucket_t *find_bucket(void **pc, int depth)
+{
+    uint32_t h = 2166136261u;
+    size_t i;
+    int d;
+
+    for (d = 0; d < depth; d++)
+	h = (h ^ (uint32_t)((uintptr_t)pc[d] >> 2)) * 16777619u;
+    h |= 1;
+
+    for (i = h & (HP_BUCKETS - 1); buckets[i].hash; i = (i + 1) & (HP_BUCKETS - 1))
+	if (buckets[i].hash == h && buckets[i].depth == depth &&
+	    !memcmp(buckets[i].pc, pc, depth * sizeof(void *)))
+	    return &buckets[i];
+
+    if (2 * (nbuckets + 1) > HP_BUCKETS)
+	return NULL;
+    nbuckets++;
+    buckets[i].hash = h;
+    buckets[i].depth = depth;
+    memcpy(buckets[i].pc, pc, depth * sizeof(void *));
+    return &buckets[i];
+}
+
+/*
+ * heapprof_sample - Called when the countdown runs out: record the
+ *     stack of bp and draw the next gap
+ */
+void heapprof_sample(void *bp, size_t size)
+{
+    void *pc[HP_MAXSKIP + HP_MAXDEPTH];
+    bucket_t *b;
+    live_t *l;
+    int n, skip, depth;
+
+    if (!active) {
+	heapprof_countdown = LONG_MAX;
+	return;
+    }
+    heapprof_countdown = next_gap();
+    if (bp == NULL || 2 * (heapprof_nlive + 1) > HP_LIVE)
+	return;
+
+    /* Leave out this function's own frame, and the allocator's above it */
+    n = backtrace(pc, HP_MAXSKIP + HP_MAXDEPTH);
+    for (skip = 1; skip < n && (uintptr_t)pc[skip] >= self_lo &&
+	     (uintptr_t)pc[skip] < self_hi; skip++)
+	;
+    depth = (n - skip < HP_MAXDEPTH) ? n - skip : HP_MAXDEPTH;
+    if (depth < 1 || (b = find_bucket(pc + skip, depth)) == NULL)
+	return;
+    b->alloc_objs++;
+    b->alloc_bytes += size;
+
+    /* A block freed without the profiler seeing it is replaced */
+    if ((l = live_find(bp)) != NULL)
+	live_del(l);
+    live_put(bp, b, size);
+}
+
+/*
+ * heapprof_free - Drop the sample of bp, if it has one
+ */
+void heapprof_free(void *bp)
+{
+    live_t *l;
+
+    if ((l = live_find(bp)) == NULL)
+	return;
+    l->bucket->free_objs++;
+    l->bucket->free_bytes += l->size;
+    live_del(l);
+}
+
+/*
+ * heapprof_move - The block sampled at oldbp now starts at newbp and
+ *     holds size bytes (mm_memalign trims the block mm_malloc gave it)
+ */
+void heapprof_move(void *oldbp, void *newbp, size_t size)
+{
+    live_t *l;
+    bucket_t *b;
+
+    if ((l = live_find(oldbp)) == NULL)
+	return;
+    b = l->bucket;
+    b->alloc_bytes += (long)size - (long)l->size;
+    if (oldbp == newbp) {
+	l->size = size;
+	return;
+    }
+    live_del(l);
+    live_put(newbp, b, size);
+}
+
+/*
+ * Buffered output with write(), which never allocates
+ */
+typedef struct {
+    int fd;
+    int n;
+    int error;
+    char buf[HP_BUFSIZE];
+} out_t;
+
+static void out_flush(out_t *o)
+{
+    char *p = o->buf;
+    ssize_t w;
+
+    while (o->n > 0 && !o->error) {
+	if ((w = write(o->fd, p, o->n)) < 0)
+	    o->error = 1;
+	else {
+	    p += w;
+	    o->n -= w;
+	}
+    }
+    o->n = 0;
+}
+
+static void out_printf(out_t *o, const char *fmt, ...)
+{
+    va_list ap;
+
+    if (o->n > HP_BUFSIZE - 256)
+	out_flush(o);
+    va_start(ap, fmt);
+    o->n += vsnprintf(o->buf + o->n, HP_BUFSIZE - o->n, fmt, ap);
+    va_end(ap);
+}
+
+/*
+ * heapprof_dump - Write the profile: a header with the totals, one line
+ *     per stack with its live and total sampled objects and bytes, and
+ *     the memory map, which pprof needs to symbolize the addresses
+ */
+int heapprof_dump(int fd)
+{
+    static out_t o;
+    bucket_t *b;
+    long inuse_objs = 0, inuse_bytes = 0, alloc_objs = 0, alloc_bytes = 0;
+    long i;
+    int d, mfd;
+    ssize_t r;
+
+    o.fd = fd;
+    o.n = 0;
+    o.error = 0;
+    for (i = 0; buckets && i < HP_BUCKETS; i++) {
+	b = &buckets[i];
+	if (!b->hash)
+	    continue;
+	inuse_objs += b->alloc_objs - b->free_objs;
+	inuse_bytes += b->alloc_bytes - b->free_bytes;
+	alloc_objs += b->alloc_objs;
+	alloc_bytes += b->alloc_bytes;
+    }
+    out_printf(&o, "heap profile: %ld: %ld [%ld: %ld] @ heap_v2/%ld\n",
+	       inuse_objs, inuse_bytes, alloc_objs, alloc_bytes, sample_rate);
+
+    for (i = 0; buckets && i < HP_BUCKETS; i++) {
+	b = &buckets[i];
+	if (!b->hash)
+	    continue;
+	out_printf(&o, "%ld: %ld [%ld: %ld] @",
+		   b->alloc_objs - b->free_objs, b->alloc_bytes - b->free_bytes,
+		   b->alloc_objs, b->alloc_bytes);
+	for (d = 0; d < b->depth; d++)
+	    out_printf(&o, " %p", b->pc[d]);
+	out_printf(&o, "\n");
+    }
+
+    out_printf(&o, "\nMAPPED_LIBRARIES:\n");
+    out_flush(&o);
+    if ((mfd = open("/proc/self/maps", O_RDONLY)) >= 0) {
+	while ((r = read(mfd, o.buf, HP_BUFSIZE)) > 0) {
+	    o.n = r;
+	    out_flush(&o);
+	}
+	close(mfd);
+    }
+    return o.error ? -1 : 0;
+}
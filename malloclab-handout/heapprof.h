@@ -0,0 +1,53 @@
+/*
+ * heapprof.h - Sampling heap profiler for the mm package
+ *
+ * When mm.c is compiled with MM_HEAPPROF, mm_malloc and mm_free call
+ * the hooks below. While the profiler runs, allocations are sampled
+ * about once every rate bytes (a Poisson process over the bytes
+ * allocated), and a sampled block's call stack is kept in a side table
+ * until it is freed. heapprof_dump writes the live heap in the heap_v2
+ * format of gperftools, which pprof reads. When the profiler is not
+ * running the hooks cost a subtraction and a branch per call.
+ *
+ * Like the rest of the mm package, the profiler is not thread safe:
+ * the caller serializes the allocator calls and the dumps.
+ */
+#ifndef __HEAPPROF_H_
+#define __HEAPPROF_H_
+
+#include <stddef.h>
+
+/* Start sampling about once every rate bytes, -1 if out of memory */
+int heapprof_start(long rate);
+
+/* Stop sampling; the blocks sampled so far are still tracked */
+void heapprof_stop(void);
+
+/* Write the live heap profile to fd, -1 on a write error */
+int heapprof_dump(int fd);
+
+/* The hooks, called by mm.c with the requested size */
+extern long heapprof_countdown; /* bytes until the next sample */
+extern long heapprof_nlive;     /* sampled blocks still allocated */
+
+void heapprof_sample(void *bp, size_t size);
+void heapprof_free(void *bp);
+void heapprof_move(void *oldbp, void *newbp, size_t size);
+
+#define HEAPPROF_ALLOC(bp, size)                          \
+    do {                                                  \
+	if ((heapprof_countdown -= (long)(size)) < 0)     \
+	    heapprof_sample(bp, size);                    \
+    } while (0)
+#define HEAPPROF_FREE(bp)                                 \
+    do {                                                  \
+	if (heapprof_nlive > 0)                           \
+	    heapprof_free(bp);                            \
+    } while (0)
+#define HEAPPROF_MOVE(oldbp, newbp, size)                 \
+    do {                                                  \
+	if (heapprof_nlive > 0)                           \
+	    heapprof_move(oldbp, newbp, size);            \
+    } while (0)
+
+#endif /* __HEAPPROF_H_ */
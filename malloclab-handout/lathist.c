@@ -0,0 +1,106 @@
+/*
+ * lathist.c - Log-bucketed latency histograms
+ *
+ * A histogram has one bucket per value below 2^LAT_SUB_BITS, and
+ * LAT_HALF equal-width buckets per power of two above that, in the
+ * style of HdrHistogram. Recording is a few shifts and an increment,
+ * so it can sit directly in a replay loop, and percentiles are read
+ * back with bounded relative error regardless of the value range.
+ */
+#include <string.h>
+
+#include "lathist.h"
+
+#define CALIBRATE_RUNS 10000 /* timed empty windows used by lat_calibrate */
+
+/* msb - index of the most significant set bit of v (v > 0) */
+static int msb(lat_ticks_t v)
+{
+    return 63 - __builtin_clzll(v);
+}
+
+/* bucket_of - map a value to its bucket index */
+static int bucket_of(lat_ticks_t v)
+{
+    int shift;
+
+    if (v < 2 * LAT_HALF)
+	return (int)v;
+    shift = msb(v) - LAT_SUB_BITS + 1;
+    return shift * LAT_HALF + (int)(v >> shift);
+}
+
+/* bucket_hi - the largest value that maps to bucket i */
+static lat_ticks_t bucket_hi(int i)
+{
+    int shift;
+
+    if (i < 2 * LAT_HALF)
+	return (lat_ticks_t)i;
+    shift = i / LAT_HALF - 1;
+    return ((lat_ticks_t)(i - shift * LAT_HALF + 1) << shift) - 1;
+}
+
+/*
+ * lathist_init - Clear a histogram
+ */
+void lathist_init(lathist_t *h)
+{
+    memset(h, 0, sizeof(lathist_t));
+}
+
+/*
+ * lathist_add - Record one value
+ */
+void lathist_add(lathist_t *h, lat_ticks_t v)
+{
+    h->buckets[bucket_of(v)]++;
+    h->count++;
+    if (v > h->max)
+	h->max = v;
+}
+
+/*
+ * lathist_percentile - Return the value below which pct percent of the
+ *     recorded values fall, rounded up to the top of its bucket (but
+ *     never above the largest recorded value).
+ */
+lat_ticks_t lathist_percentile(lathist_t *h, double pct)
+{
+    lat_ticks_t rank, seen = 0;
+    lat_ticks_t hi;
+    int i;
+
+    if (h->count == 0)
+	return 0;
+    rank = (lat_ticks_t)(pct / 100.0 * h->count + 0.5);
+    if (rank < 1)
+	rank = 1;
+    for (i = 0; i < LAT_NBUCKETS; i++) {
+	seen += h->buckets[i];
+	if (seen >= rank) {
+	    hi = bucket_hi(i);
+	    return (hi < h->max) ? hi : h->max;
+	}
+    }
+    return h->max;
+}
+
+/*
+ * lat_calibrate - Estimate the overhead of the timer itself, i.e. the
+ *     median duration of an empty lat_start()/lat_stop() window. Callers
+ *     subtract this from every sample.
+ */
+lat_ticks_t lat_calibrate(void)
+{
+    static lathist_t h;
+    lat_ticks_t t0;
+    int i;
+
+    lathist_init(&h);
+    for (i = 0; i < CALIBRATE_RUNS; i++) {
+	t0 = lat_start();
+	lathist_add(&h, lat_stop() - t0);
+    }
+    return lathist_percentile(&h, 50.0);
+}
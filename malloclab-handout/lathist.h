@@ -0,0 +1,71 @@
+/*
+ * lathist.h - Log-bucketed latency histograms and a low-overhead
+ *     timestamp source for timing individual allocator requests.
+ */
+#ifndef __LATHIST_H_
+#define __LATHIST_H_
+
+#include <time.h>
+
+/*
+ * Values below 2^LAT_SUB_BITS get a bucket of their own. Above that,
+ * each power of two is split into 2^(LAT_SUB_BITS-1) equal buckets, so
+ * the relative error of any recorded value is below 1/2^(LAT_SUB_BITS-1).
+ */
+#define LAT_SUB_BITS  5
+#define LAT_HALF      (1 << (LAT_SUB_BITS-1))
+#define LAT_NBUCKETS  ((64 - LAT_SUB_BITS + 2) * LAT_HALF)
+
+typedef unsigned long long lat_ticks_t;
+
+typedef struct {
+    lat_ticks_t count;                /* number of recorded values */
+    lat_ticks_t max;                  /* largest recorded value */
+    lat_ticks_t buckets[LAT_NBUCKETS];/* number of values in each bucket */
+} lathist_t;
+
+/*
+ * lat_start, lat_stop - read the timestamp counter before and after
+ *     the code being measured. On x86 these use the TSC, fenced so
+ *     that the measured instructions cannot drift out of the window.
+ *     Elsewhere they fall back to clock_gettime() in nanoseconds.
+ */
+#if defined(__x86_64__) || defined(__i386__)
+#define LAT_UNITS "cycles"
+static inline lat_ticks_t lat_start(void)
+{
+    unsigned lo, hi;
+    asm volatile("lfence; rdtsc" : "=a" (lo), "=d" (hi) : : "memory");
+    return ((lat_ticks_t)hi << 32) | lo;
+}
+
+static inline lat_ticks_t lat_stop(void)
+{
+    unsigned lo, hi;
+    asm volatile("rdtscp; lfence" : "=a" (lo), "=d" (hi) : : "ecx", "memory");
+    return ((lat_ticks_t)hi << 32) | lo;
+}
+#else
+#define LAT_UNITS "ns"
+static inline lat_ticks_t lat_start(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (lat_ticks_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#define lat_stop lat_start
+#endif
+
+/* Clear a histogram */
+void lathist_init(lathist_t *h);
+
+/* Record one value */
+void lathist_add(lathist_t *h, lat_ticks_t v);
+
+/* Return the value below which pct percent of the recorded values fall */
+lat_ticks_t lathist_percentile(lathist_t *h, double pct);
+
+/* Estimate the cost of an empty lat_start()/lat_stop() pair */
+lat_ticks_t lat_calibrate(void);
+
+#endif /* __LATHIST_H_ */
@@ -10,15 +10,24 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
+#include <getopt.h>
 #include <errno.h>
 #include <string.h>
 #include <assert.h>
 #include <float.h>
+#include <math.h>
 #include <time.h>
 
 #include "mm.h"
 #include "memlib.h"
 #include "fsecs.h"
+#include "clock.h"
+#include "lathist.h"
+#include "bench.h"
+#include "results.h"
+#include "engine.h"
+#include "trace.h"
+#include "snapshot.h"
 #include "config.h"
 
 /**********************
@@ -27,8 +36,12 @@
 
 /* Misc */
 #define MAXLINE     1024 /* max string size */
-#define HDRLINES       4 /* number of header lines in a trace file */
-#define LINENUM(i) (i+5) /* cnvt trace request nums to linenums (origin 1) */
+
+/* Request types that get their own latency histogram */
+#define NLATOPS 3
+
+/* Max number of engines that can be compared in one run */
+#define MAXENGINES 16
 
 /* Returns true if p is ALIGNMENT-byte aligned */
 #define IS_ALIGNED(p)  ((((unsigned int)(p)) % ALIGNMENT) == 0)
@@ -44,24 +57,6 @@ typedef struct range_t {
     struct range_t *next;  /* next list element */
 } range_t;
 
-/* Characterizes a single trace operation (allocator request) */
-typedef struct {
-    enum {ALLOC, FREE, REALLOC} type; /* type of request */
-    int index;                        /* index for free() to use later */
-    int size;                         /* byte size of alloc/realloc request */
-} traceop_t;
-
-/* Holds the information for one trace file*/
-typedef struct {
-    int sugg_heapsize;   /* suggested heap size (unused) */
-    int num_ids;         /* number of alloc/realloc ids */
-    int num_ops;         /* number of distinct requests */
-    int weight;          /* weight for this trace (unused) */
-    traceop_t *ops;      /* array of requests */
-    char **blocks;       /* array of ptrs returned by malloc/realloc... */
-    size_t *block_sizes; /* ... and a corresponding array of payload sizes */
-} trace_t;
-
 /* 
  * Holds the params to the xxx_speed functions, which are timed by fcyc. 
  * This struct is necessary because fcyc accepts only a pointer array
@@ -72,24 +67,74 @@ typedef struct {
     range_t *ranges;
 } speed_t;
 
-/* Summarizes the important stats for some malloc function on some trace */
+/* Maximum number of snapshot op indices (-Z) */
+#define MAXSNAPS 64
+
+/* Heap state at one point of the utilization pass (see sample_heap) */
 typedef struct {
-    /* defined for both libc malloc and student malloc package (mm.c) */
-    double ops;      /* number of ops (malloc/free/realloc) in the trace */
-    int valid;       /* was the trace processed correctly by the allocator? */
-    double secs;     /* number of secs needed to run the trace */
+    size_t free_bytes;   /* total size of the free blocks */
+    size_t free_blocks;  /* number of free blocks */
+    size_t largest_free; /* size of the largest free block */
+} heapstate_t;
 
-    /* defined only for the student malloc package */
-    double util;     /* space utilization for this trace (always 0 for libc) */
+/* Per-request latency histograms for some malloc function on some trace */
+typedef struct {
+    lathist_t hist[NLATOPS]; /* indexed by the traceop_t type */
+} lat_t;
+
+/* One replay of a trace on the long-lived heap of the soak test */
+typedef struct {
+    trace_t *trace;      /* the trace being replayed */
+    int next;            /* index of the next request */
+    char **blocks;       /* this replay's blocks... */
+    int *sizes;          /* ... and their payload sizes */
+} instance_t;
 
-    /* Note: secs and util are only defined if valid is true */
-} stats_t; 
+/* State of a soak test, passed to soak_epoch by fsecs_once */
+typedef struct {
+    instance_t *inst;    /* one instance per trace */
+    int n;               /* number of traces */
+    int *order;          /* shuffled order of the traces... */
+    int cur;             /* ... and the position in it */
+    int interleave;      /* interleave the traces instead of shuffling */
+    long epoch_ops;      /* requests per epoch */
+    long ops;            /* requests done in the current epoch */
+    size_t live;         /* live payload bytes... */
+    size_t peak;         /* ... and their peak in the current epoch */
+    int failed;          /* set if the allocator ran out of memory */
+} soak_t;
+
+/* Soak epochs shorter than this are merged with the next one, so that
+   their throughput is well above the resolution of every timer */
+#define SOAK_MIN_SECS 1e-4
+
+/* Throughput and heap state at the end of one soak epoch */
+typedef struct {
+    double secs;         /* running time of the epoch */
+    long ops;            /* requests done in the epoch */
+    size_t peak;         /* peak live payload bytes during the epoch */
+    size_t heapsize;     /* size of the heap */
+    heapstate_t h;       /* its free blocks */
+} epoch_t;
 
 /********************
  * Global variables
  *******************/
 int verbose = 0;        /* global flag for verbose output */
 static int errors = 0;  /* number of errs found when running student malloc */
+static lat_ticks_t lat_ovhd = 0; /* timer overhead subtracted from latencies */
+static int bench_mode = 0;  /* if set, time with bench_run instead of fsecs */
+static int run_perf = 0;    /* if set, collect hardware counters (-P) */
+static int sample_ops = 0;  /* if > 0, sample the heap every this many ops */
+static FILE *series_fp = NULL; /* where heap samples are written (-F) */
+static int sweep_ops = 0;   /* if > 0, run the locality pass (-L) and sweep
+			       the live blocks every this many ops */
+static volatile long sink;  /* keeps the locality pass's reads alive */
+static int snap_ops[MAXSNAPS]; /* snapshot the heap after these ops (-Z) */
+static int nsnaps = 0;      /* number of snap_ops */
+static char *snap_prefix = "heap"; /* snapshot file name prefix (-O) */
+static unsigned long long soak_rng = 0x2545F4914F6CDD1DULL; /* for -A */
+static mm_engine_t *engine = &mm_engine; /* the engine being evaluated */
 char msg[MAXLINE];      /* for whenever we need to compose an error message */
 
 /* Directory where default tracefiles are found */
@@ -111,10 +156,6 @@ static int add_range(range_t **ranges, char *lo, int size,
 static void remove_range(range_t **ranges, char *lo);
 static void clear_ranges(range_t **ranges);
 
-/* These functions read, allocate, and free storage for traces */
-static trace_t *read_trace(char *tracedir, char *filename);
-static void free_trace(trace_t *trace);
-
 /* Routines for evaluating the correctness and speed of libc malloc */
 static int eval_libc_valid(trace_t *trace, int tracenum);
 static void eval_libc_speed(void *ptr);
@@ -122,11 +163,37 @@ static void eval_libc_speed(void *ptr);
 /* Routines for evaluating correctnes, space utilization, and speed 
    of the student's malloc package in mm.c */
 static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges);
-static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges);
+static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges,
+			   stats_t *stats);
+static void sample_heap(int tracenum, int opnum, int live, stats_t *stats);
+static void snapshot_heap(int tracenum, int opnum, int num_ops, int live);
 static void eval_mm_speed(void *ptr);
+static void eval_mm_locality(void *ptr);
+static void eval_mm_lat(trace_t *trace, lat_t *lat);
+static void eval_engine(int n, char **tracefiles, stats_t *stats, lat_t *lats);
+static void eval_soak(int n, char **tracefiles, long total_ops, long epoch_ops,
+		      int interleave);
+
+/* Time one of the xxx_speed functions according to the timing mode */
+static void time_speed(fsecs_test_funct f, speed_t *params, stats_t *stats);
 
 /* Various helper routines */
 static void printresults(int n, stats_t *stats);
+static void printperf(perfctr_t *perf, double ops);
+static void printkops(double ops, double secs, int width);
+static void printfrag(int n, stats_t *stats);
+static void printlocality(int n, stats_t *stats);
+#ifdef MM_STATS
+static void printmmstats(int tracenum);
+#endif
+static void printbench(int n, stats_t *stats);
+static void printmatrix(int n, int nengines, mm_engine_t **engines,
+			stats_t **stats);
+static void writeresults(char *path, int csv, int n, char **names,
+			 stats_t *stats, env_t *env);
+static int compare_baseline(char *path, double threshold, int n,
+			    char **names, stats_t *stats);
+static void printlatency(int n, stats_t *stats, lat_t *lats);
 static void usage(void);
 static void unix_error(char *msg);
 static void malloc_error(int tracenum, int opnum, char *msg);
@@ -138,18 +205,44 @@ static void app_error(char *msg);
 int main(int argc, char **argv)
 {
     int i;
-    char c;
+    char c, *p;
     char **tracefiles = NULL;  /* null-terminated array of trace file names */
     int num_tracefiles = 0;    /* the number of traces in that array */
     trace_t *trace = NULL;     /* stores a single trace file in memory */
-    range_t *ranges = NULL;    /* keeps track of block extents for one trace */
     stats_t *libc_stats = NULL;/* libc stats for each trace */
     stats_t *mm_stats = NULL;  /* mm (i.e. student) stats for each trace */
+    lat_t *mm_lats = NULL;     /* mm latency histograms for each trace */
+    mm_engine_t *engines[MAXENGINES]; /* engines to compare, engines[0] is mm */
+    stats_t *engine_stats[MAXENGINES];/* stats for each engine and trace */
+    int nengines = 1;          /* the number of engines */
+    int mm_errors;             /* errors found in the mm package itself */
     speed_t speed_params;      /* input parameters to the xx_speed routines */ 
 
     int team_check = 1;  /* If set, check team structure (reset by -a) */
     int run_libc = 0;    /* If set, run libc malloc (set by -l) */
     int autograder = 0;  /* If set, emit summary info for autograder (-g) */
+    int run_lat = 0;     /* If set, collect per-request latencies (-H) */
+    int timer = DEFAULT_TIMER; /* timing method (set by -T) */
+    int cpu = -1;        /* If >= 0, pin the driver to this CPU (-C) */
+    int warmup = 2;      /* untimed runs per trace in benchmark mode (-w) */
+    int reps = 11;       /* timed runs per trace in benchmark mode (-n) */
+    char *json_path = NULL; /* If set, write the results as JSON (-j) */
+    char *csv_path = NULL;  /* If set, write the results as CSV (-c) */
+    env_t env;           /* machine, build and timer the results come from */
+    char *baseline_path = NULL; /* If set, compare against these results */
+    double threshold = 5.0; /* regression threshold in percent (-x) */
+    int regressions = 0; /* number of traces that got worse than baseline */
+    char *series_path = NULL; /* If set, write heap samples here (-F) */
+    long soak_ops = 0;   /* If > 0, soak the heap for this many ops (-A) */
+    long epoch_ops = 0;  /* requests per soak epoch (-E) */
+    int interleave = 0;  /* If set, interleave the soaked traces (-I) */
+
+    /* Long forms of the options, for the regression gate */
+    static struct option long_options[] = {
+	{"baseline", required_argument, NULL, 'b'},
+	{"threshold", required_argument, NULL, 'x'},
+	{NULL, 0, NULL, 0}
+    };
 
     /* temporaries used to compute the performance index */
     double secs, ops, util, avg_mm_util, avg_mm_throughput, p1, p2, perfindex;
@@ -158,7 +251,8 @@ int main(int argc, char **argv)
     /* 
      * Read and interpret the command line arguments 
      */
-    while ((c = getopt(argc, argv, "f:t:hvVgal")) != EOF) {
+    while ((c = getopt_long(argc, argv, "f:t:T:C:w:n:j:c:b:x:e:S:F:L:A:E:Z:O:hvVgalHBPI",
+			    long_options, NULL)) != EOF) {
         switch (c) {
 	case 'g': /* Generate summary info for the autograder */
 	    autograder = 1;
@@ -184,6 +278,79 @@ int main(int argc, char **argv)
         case 'l': /* Run libc malloc */
             run_libc = 1;
             break;
+        case 'H': /* Collect per-request latency histograms */
+            run_lat = 1;
+            break;
+	case 'T': /* Timing method */
+	    if ((timer = fsecs_parse_timer(optarg)) < 0) {
+		usage();
+		exit(1);
+	    }
+	    break;
+	case 'C': /* Pin to one CPU */
+	    cpu = atoi(optarg);
+	    break;
+	case 'B': /* Benchmark mode */
+	    bench_mode = 1;
+	    break;
+	case 'P': /* Collect hardware performance counters */
+	    run_perf = 1;
+	    break;
+	case 'S': /* Sample the heap every n ops of the utilization pass */
+	    sample_ops = atoi(optarg);
+	    break;
+	case 'Z': /* Snapshot the heap after these ops, e.g. 1000,5000 */
+	    for (p = strtok(optarg, ","); p != NULL; p = strtok(NULL, ",")) {
+		if (nsnaps == MAXSNAPS)
+		    app_error("Too many snapshot ops for -Z");
+		snap_ops[nsnaps++] = atoi(p);
+	    }
+	    break;
+	case 'O': /* Prefix of the snapshot files */
+	    snap_prefix = optarg;
+	    break;
+	case 'L': /* Application locality pass, sweeping every n ops */
+	    sweep_ops = atoi(optarg);
+	    break;
+	case 'A': /* Soak test: age one heap for this many ops */
+	    soak_ops = atol(optarg);
+	    break;
+	case 'E': /* Requests per soak epoch */
+	    epoch_ops = atol(optarg);
+	    break;
+	case 'I': /* Interleave the traces in the soak test */
+	    interleave = 1;
+	    break;
+	case 'F': /* Write the heap samples to a file (implies -S 100) */
+	    series_path = optarg;
+	    if (sample_ops <= 0)
+		sample_ops = 100;
+	    break;
+	case 'w': /* Warmup runs in benchmark mode */
+	    warmup = atoi(optarg);
+	    break;
+	case 'n': /* Timed runs in benchmark mode */
+	    reps = atoi(optarg);
+	    break;
+	case 'j': /* Write results as JSON */
+	    json_path = optarg;
+	    break;
+	case 'c': /* Write results as CSV */
+	    csv_path = optarg;
+	    break;
+	case 'b': /* Compare against baseline results (implies -B) */
+	    baseline_path = optarg;
+	    bench_mode = 1;
+	    break;
+	case 'x': /* Regression threshold in percent */
+	    threshold = atof(optarg);
+	    break;
+	case 'e': /* Load another engine to compare against */
+	    if (nengines == MAXENGINES)
+		app_error("ERROR: too many engines");
+	    if ((engines[nengines++] = engine_load(optarg)) == NULL)
+		exit(1);
+	    break;
         case 'v': /* Print per-trace performance breakdown */
             verbose = 1;
             break;
@@ -235,8 +402,32 @@ int main(int argc, char **argv)
 	printf("Using default tracefiles in %s\n", tracedir);
     }
 
+    /* Pin ourselves to one CPU so that every timing runs on the same core */
+    if (cpu >= 0 && pin_cpu(cpu) < 0)
+	unix_error("ERROR: could not pin to the requested CPU");
+
+    /* Open the heap sample time series */
+    if (series_path) {
+	if ((series_fp = fopen(series_path, "w")) == NULL) {
+	    sprintf(msg, "Could not open %s", series_path);
+	    unix_error(msg);
+	}
+	fprintf(series_fp, "trace,op,live,heap,free,free_blocks,largest_free\n");
+    }
+
     /* Initialize the timing package */
-    init_fsecs();
+    init_fsecs(timer);
+    if (run_perf || sweep_ops > 0) {
+	if (perfctr_open() == 0) {
+	    printf("WARNING: no hardware performance counters available.\n");
+	    run_perf = 0;
+	}
+	perfctr_close(); /* every measured run opens its own */
+    }
+    set_bench_warmup(warmup);
+    set_bench_reps(reps);
+    results_env(&env, fsecs_timer_name(), bench_mode ? warmup : 0,
+		bench_mode ? reps : 0);
 
     /*
      * Optionally run and evaluate the libc malloc package 
@@ -261,7 +452,7 @@ int main(int argc, char **argv)
 		speed_params.trace = trace;
 		if (verbose > 1)
 		    printf("and performance.\n");
-		libc_stats[i].secs = fsecs(eval_libc_speed, &speed_params);
+		time_speed(eval_libc_speed, &speed_params, &libc_stats[i]);
 	    }
 	    free_trace(trace);
 	}
@@ -270,6 +461,8 @@ int main(int argc, char **argv)
 	if (verbose) {
 	    printf("\nResults for libc malloc:\n");
 	    printresults(num_tracefiles, libc_stats);
+	    if (bench_mode)
+		printbench(num_tracefiles, libc_stats);
 	}
     }
 
@@ -283,29 +476,18 @@ int main(int argc, char **argv)
     mm_stats = (stats_t *)calloc(num_tracefiles, sizeof(stats_t));
     if (mm_stats == NULL)
 	unix_error("mm_stats calloc in main failed");
-    
-    /* Initialize the simulated memory system in memlib.c */
-    mem_init(); 
 
-    /* Evaluate student's mm malloc package using the K-best scheme */
-    for (i=0; i < num_tracefiles; i++) {
-	trace = read_trace(tracedir, tracefiles[i]);
-	mm_stats[i].ops = trace->num_ops;
-	if (verbose > 1)
-	    printf("Checking mm_malloc for correctness, ");
-	mm_stats[i].valid = eval_mm_valid(trace, i, &ranges);
-	if (mm_stats[i].valid) {
-	    if (verbose > 1)
-		printf("efficiency, ");
-	    mm_stats[i].util = eval_mm_util(trace, i, &ranges);
-	    speed_params.trace = trace;
-	    speed_params.ranges = ranges;
-	    if (verbose > 1)
-		printf("and performance.\n");
-	    mm_stats[i].secs = fsecs(eval_mm_speed, &speed_params);
-	}
-	free_trace(trace);
+    /* Calibrate the per-request timer if we are collecting latencies */
+    if (run_lat) {
+	if ((mm_lats = (lat_t *)calloc(num_tracefiles, sizeof(lat_t))) == NULL)
+	    unix_error("mm_lats calloc in main failed");
+	lat_ovhd = lat_calibrate();
     }
+    
+    /* Evaluate student's mm malloc package using the K-best scheme */
+    engines[0] = &mm_engine;
+    engine_stats[0] = mm_stats;
+    eval_engine(num_tracefiles, tracefiles, mm_stats, mm_lats);
 
     /* Display the mm results in a compact table */
     if (verbose) {
@@ -313,6 +495,71 @@ int main(int argc, char **argv)
 	printresults(num_tracefiles, mm_stats);
 	printf("\n");
     }
+    if (bench_mode) {
+	printbench(num_tracefiles, mm_stats);
+	printf("\n");
+    }
+    if (sample_ops > 0) {
+	printfrag(num_tracefiles, mm_stats);
+	printf("\n");
+    }
+    if (sweep_ops > 0) {
+	printlocality(num_tracefiles, mm_stats);
+	printf("\n");
+    }
+    if (series_fp) {
+	fclose(series_fp);
+	series_fp = NULL;
+    }
+    if (run_lat) {
+	printlatency(num_tracefiles, mm_stats, mm_lats);
+	printf("\n");
+    }
+    if (soak_ops > 0) {
+	if (epoch_ops <= 0)
+	    epoch_ops = (soak_ops >= 20) ? soak_ops / 20 : 1;
+	eval_soak(num_tracefiles, tracefiles, soak_ops, epoch_ops, interleave);
+	printf("\n");
+    }
+
+    /*
+     * Evaluate any other engines on the same traces. Their errors are
+     * reported, but don't count against the mm package.
+     */
+    mm_errors = errors;
+    for (i = 1; i < nengines; i++) {
+	if (verbose > 1)
+	    printf("\nTesting engine %s\n", engines[i]->name);
+	if ((engine_stats[i] = calloc(num_tracefiles, sizeof(stats_t))) == NULL)
+	    unix_error("engine_stats calloc in main failed");
+	errors = 0;
+	engine = engines[i];
+	eval_engine(num_tracefiles, tracefiles, engine_stats[i], NULL);
+	if (verbose) {
+	    printf("\nResults for engine %s:\n", engine->name);
+	    printresults(num_tracefiles, engine_stats[i]);
+	    printf("\n");
+	}
+    }
+    errors = mm_errors;
+    engine = &mm_engine;
+    if (nengines > 1) {
+	printmatrix(num_tracefiles, nengines, engines, engine_stats);
+	printf("\n");
+    }
+
+    /* Write the machine-readable results */
+    if (json_path)
+	writeresults(json_path, 0, num_tracefiles, tracefiles, mm_stats, &env);
+    if (csv_path)
+	writeresults(csv_path, 1, num_tracefiles, tracefiles, mm_stats, &env);
+
+    /* Flag any trace that got worse than the baseline */
+    if (baseline_path) {
+	regressions = compare_baseline(baseline_path, threshold,
+				       num_tracefiles, tracefiles, mm_stats);
+	printf("\n");
+    }
 
     /* 
      * Accumulate the aggregate statistics for the student's mm package 
@@ -322,8 +569,10 @@ int main(int argc, char **argv)
     util = 0;
     numcorrect = 0;
     for (i=0; i < num_tracefiles; i++) {
-	secs += mm_stats[i].secs;
-	ops += mm_stats[i].ops;
+	if (mm_stats[i].secs > 0) { /* too fast for the timer otherwise */
+	    secs += mm_stats[i].secs;
+	    ops += mm_stats[i].ops;
+	}
 	util += mm_stats[i].util;
 	if (mm_stats[i].valid)
 	    numcorrect++;
@@ -334,7 +583,10 @@ int main(int argc, char **argv)
      * Compute and print the performance index 
      */
     if (errors == 0) {
-	avg_mm_throughput = ops/secs;
+	avg_mm_throughput = (secs > 0) ? ops/secs : 0;
+	if (secs == 0)
+	    printf("WARNING: no trace ran long enough to be timed, "
+		   "throughput counts as 0\n");
 
 	p1 = UTIL_WEIGHT * avg_mm_util;
 	if (avg_mm_throughput > AVG_LIBC_THRUPUT) {
@@ -362,6 +614,11 @@ int main(int argc, char **argv)
 	printf("perfidx:%.0f\n", perfindex);
     }
 
+    if (regressions > 0) {
+	printf("%d trace(s) failed the comparison against %s\n", regressions,
+	       baseline_path);
+	exit(2);
+    }
     exit(0);
 }
 
@@ -396,10 +653,10 @@ static int add_range(range_t **ranges, char *lo, int size,
     }
 
     /* The payload must lie within the extent of the heap */
-    if ((lo < (char *)mem_heap_lo()) || (lo > (char *)mem_heap_hi()) || 
-	(hi < (char *)mem_heap_lo()) || (hi > (char *)mem_heap_hi())) {
+    if ((lo < (char *)engine->heap_lo()) || (lo > (char *)engine->heap_hi()) || 
+	(hi < (char *)engine->heap_lo()) || (hi > (char *)engine->heap_hi())) {
 	sprintf(msg, "Payload (%p:%p) lies outside heap (%p:%p)",
-		lo, hi, mem_heap_lo(), mem_heap_hi());
+		lo, hi, engine->heap_lo(), engine->heap_hi());
 	malloc_error(tracenum, opnum, msg);
         return 0;
     }
@@ -463,109 +720,6 @@ static void clear_ranges(range_t **ranges)
     *ranges = NULL;
 }
 
-
-/**********************************************
- * The following routines manipulate tracefiles
- *********************************************/
-
-/*
- * read_trace - read a trace file and store it in memory
- */
-static trace_t *read_trace(char *tracedir, char *filename)
-{
-    FILE *tracefile;
-    trace_t *trace;
-    char type[MAXLINE];
-    char path[MAXLINE];
-    unsigned index, size;
-    unsigned max_index = 0;
-    unsigned op_index;
-
-    if (verbose > 1)
-	printf("Reading tracefile: %s\n", filename);
-
-    /* Allocate the trace record */
-    if ((trace = (trace_t *) malloc(sizeof(trace_t))) == NULL)
-	unix_error("malloc 1 failed in read_trance");
-	
-    /* Read the trace file header */
-    strcpy(path, tracedir);
-    strcat(path, filename);
-    if ((tracefile = fopen(path, "r")) == NULL) {
-	sprintf(msg, "Could not open %s in read_trace", path);
-	unix_error(msg);
-    }
-    fscanf(tracefile, "%d", &(trace->sugg_heapsize)); /* not used */
-    fscanf(tracefile, "%d", &(trace->num_ids));     
-    fscanf(tracefile, "%d", &(trace->num_ops));     
-    fscanf(tracefile, "%d", &(trace->weight));        /* not used */
-    
-    /* We'll store each request line in the trace in this array */
-    if ((trace->ops = 
-	 (traceop_t *)malloc(trace->num_ops * sizeof(traceop_t))) == NULL)
-	unix_error("malloc 2 failed in read_trace");
-
-    /* We'll keep an array of pointers to the allocated blocks here... */
-    if ((trace->blocks = 
-	 (char **)malloc(trace->num_ids * sizeof(char *))) == NULL)
-	unix_error("malloc 3 failed in read_trace");
-
-    /* ... along with the corresponding byte sizes of each block */
-    if ((trace->block_sizes = 
-	 (size_t *)malloc(trace->num_ids * sizeof(size_t))) == NULL)
-	unix_error("malloc 4 failed in read_trace");
-    
-    /* read every request line in the trace file */
-    index = 0;
-    op_index = 0;
-    while (fscanf(tracefile, "%s", type) != EOF) {
-	switch(type[0]) {
-	case 'a':
-	    fscanf(tracefile, "%u %u", &index, &size);
-	    trace->ops[op_index].type = ALLOC;
-	    trace->ops[op_index].index = index;
-	    trace->ops[op_index].size = size;
-	    max_index = (index > max_index) ? index : max_index;
-	    break;
-	case 'r':
-	    fscanf(tracefile, "%u %u", &index, &size);
-	    trace->ops[op_index].type = REALLOC;
-	    trace->ops[op_index].index = index;
-	    trace->ops[op_index].size = size;
-	    max_index = (index > max_index) ? index : max_index;
-	    break;
-	case 'f':
-	    fscanf(tracefile, "%ud", &index);
-	    trace->ops[op_index].type = FREE;
-	    trace->ops[op_index].index = index;
-	    break;
-	default:
-	    printf("Bogus type character (%c) in tracefile %s\n", 
-		   type[0], path);
-	    exit(1);
-	}
-	op_index++;
-	
-    }
-    fclose(tracefile);
-    assert(max_index == trace->num_ids - 1);
-    assert(trace->num_ops == op_index);
-    
-    return trace;
-}
-
-/*
- * free_trace - Free the trace record and the three arrays it points
- *              to, all of which were allocated in read_trace().
- */
-void free_trace(trace_t *trace)
-{
-    free(trace->ops);         /* free the three arrays... */
-    free(trace->blocks);      
-    free(trace->block_sizes);
-    free(trace);              /* and the trace record itself... */
-}
-
 /**********************************************************************
  * The following functions evaluate the correctness, space utilization,
  * and throughput of the libc and mm malloc packages.
@@ -585,11 +739,11 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
     char *p;
     
     /* Reset the heap and free any records in the range list */
-    mem_reset_brk();
+    engine->heap_reset();
     clear_ranges(ranges);
 
     /* Call the mm package's init function */
-    if (mm_init() < 0) {
+    if (engine->init() < 0) {
 	malloc_error(tracenum, 0, "mm_init failed.");
 	return 0;
     }
@@ -604,7 +758,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
         case ALLOC: /* mm_malloc */
 
 	    /* Call the student's malloc */
-	    if ((p = mm_malloc(size)) == NULL) {
+	    if ((p = engine->malloc(size)) == NULL) {
 		malloc_error(tracenum, i, "mm_malloc failed.");
 		return 0;
 	    }
@@ -633,7 +787,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	    
 	    /* Call the student's realloc */
 	    oldp = trace->blocks[index];
-	    if ((newp = mm_realloc(oldp, size)) == NULL) {
+	    if ((newp = engine->realloc(oldp, size)) == NULL) {
 		malloc_error(tracenum, i, "mm_realloc failed.");
 		return 0;
 	    }
@@ -653,7 +807,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	    oldsize = trace->block_sizes[index];
 	    if (size < oldsize) oldsize = size;
 	    for (j = 0; j < oldsize; j++) {
-	      if (newp[j] != (index & 0xFF)) {
+	      if ((unsigned char)newp[j] != (index & 0xFF)) {
 		malloc_error(tracenum, i, "mm_realloc did not preserve the "
 			     "data from old block");
 		return 0;
@@ -671,7 +825,7 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
 	    /* Remove region from list and call student's free function */
 	    p = trace->blocks[index];
 	    remove_range(ranges, p);
-	    mm_free(p);
+	    engine->free(p);
 	    break;
 
 	default:
@@ -693,9 +847,13 @@ static int eval_mm_valid(trace_t *trace, int tracenum, range_t **ranges)
  *   package on the trace. Note that our implementation of mem_sbrk() 
  *   doesn't allow the students to decrement the brk pointer, so brk
  *   is always the high water mark of the heap. 
- *   
+ *
+ *   If sample_ops is set, the heap is also sampled after every
+ *   sample_ops ops and at the end of the trace, and the time-averaged
+ *   utilization and external fragmentation are recorded in stats.
  */
-static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
+static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges,
+			   stats_t *stats)
 {   
     int i;
     int index;
@@ -706,18 +864,23 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
     char *newp, *oldp;
 
     /* initialize the heap and the mm malloc package */
-    mem_reset_brk();
-    if (mm_init() < 0)
+    engine->heap_reset();
+    if (engine->init() < 0)
 	app_error("mm_init failed in eval_mm_util");
+    stats->avg_util = stats->avg_frag = 0.0;
+    stats->samples = 0;
 
     for (i = 0;  i < trace->num_ops;  i++) {
+	if (nsnaps > 0)
+	    snapshot_heap(tracenum, i, trace->num_ops, total_size);
+
         switch (trace->ops[i].type) {
 
         case ALLOC: /* mm_alloc */
 	    index = trace->ops[i].index;
 	    size = trace->ops[i].size;
 
-	    if ((p = mm_malloc(size)) == NULL) 
+	    if ((p = engine->malloc(size)) == NULL) 
 		app_error("mm_malloc failed in eval_mm_util");
 	    
 	    /* Remember region and size */
@@ -739,7 +902,7 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 	    oldsize = trace->block_sizes[index];
 
 	    oldp = trace->blocks[index];
-	    if ((newp = mm_realloc(oldp,newsize)) == NULL)
+	    if ((newp = engine->realloc(oldp,newsize)) == NULL)
 		app_error("mm_realloc failed in eval_mm_util");
 
 	    /* Remember region and size */
@@ -760,7 +923,7 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 	    size = trace->block_sizes[index];
 	    p = trace->blocks[index];
 	    
-	    mm_free(p);
+	    engine->free(p);
 	    
 	    /* Keep track of current total size
 	     * of all allocated blocks */
@@ -772,11 +935,113 @@ static double eval_mm_util(trace_t *trace, int tracenum, range_t **ranges)
 	    app_error("Nonexistent request type in eval_mm_util");
 
         }
+
+	/* After the op, so that the empty heap of mm_init isn't sampled;
+	   the end of the trace is sampled below */
+	if (sample_ops > 0 && (i + 1) % sample_ops == 0 &&
+	    i + 1 < trace->num_ops)
+	    sample_heap(tracenum, i + 1, total_size, stats);
     }
+    if (sample_ops > 0) {
+	sample_heap(tracenum, trace->num_ops, total_size, stats);
+	stats->avg_util /= stats->samples;
+	stats->avg_frag /= stats->samples;
+    }
+    if (nsnaps > 0)
+	snapshot_heap(tracenum, trace->num_ops, trace->num_ops, total_size);
+
+    return ((double)max_total_size / (double)engine->heapsize());
+}
+
+
+/*
+ * walk_free - mm_heap_walk callback that accumulates a heapstate_t
+ */
+static void walk_free(void *bp, size_t size, int alloc, void *arg)
+{
+    heapstate_t *h = (heapstate_t *)arg;
+
+    if (alloc)
+	return;
+    h->free_bytes += size;
+    h->free_blocks++;
+    if (size > h->largest_free)
+	h->largest_free = size;
+}
 
-    return ((double)max_total_size / (double)mem_heapsize());
+/*
+ * sample_heap - Record the state of the heap after opnum ops, given the
+ *     number of live payload bytes. Accumulates the utilization and the
+ *     external fragmentation (the fraction of free memory that is not
+ *     in the largest free block) into stats for averaging, and appends
+ *     a row to the time series if one is being written.
+ */
+static void sample_heap(int tracenum, int opnum, int live, stats_t *stats)
+{
+    heapstate_t h = {0, 0, 0};
+    size_t heapsize = engine->heapsize();
+
+    if (engine->heap_walk)
+	engine->heap_walk(walk_free, &h);
+
+    stats->samples++;
+    if (heapsize > 0)
+	stats->avg_util += (double)live / heapsize;
+    if (h.free_bytes > 0)
+	stats->avg_frag += 1.0 - (double)h.largest_free / h.free_bytes;
+
+    if (series_fp)
+	fprintf(series_fp, "%d,%d,%d,%lu,%lu,%lu,%lu\n", tracenum, opnum, live,
+		(unsigned long)heapsize, (unsigned long)h.free_bytes,
+		(unsigned long)h.free_blocks, (unsigned long)h.largest_free);
 }
 
+/*
+ * walk_snap - mm_heap_walk callback that adds a block to a snap_t
+ */
+static void walk_snap(void *bp, size_t size, int alloc, void *arg)
+{
+    snap_t *s = (snap_t *)arg;
+
+    if (snap_add(s, (char *)bp - (char *)engine->heap_lo(), size, alloc) < 0)
+	unix_error("snap_add failed in walk_snap");
+}
+
+/*
+ * snapshot_heap - If a snapshot was asked for after opnum ops, write
+ *     every block of the heap to <prefix>.<engine>.<trace>.<op>.snap.
+ *     Ops past the end of the trace snapshot its end.
+ */
+static void snapshot_heap(int tracenum, int opnum, int num_ops, int live)
+{
+    static int warned = 0;
+    char path[MAXLINE];
+    snap_t s;
+    int i;
+
+    for (i = 0; i < nsnaps; i++)
+	if ((snap_ops[i] < num_ops ? snap_ops[i] : num_ops) == opnum)
+	    break;
+    if (i == nsnaps)
+	return;
+    if (engine->heap_walk == NULL) {
+	if (!warned)
+	    fprintf(stderr, "Warning: %s has no mm_heap_walk, no snapshots taken\n",
+		    engine->name);
+	warned = 1;
+	return;
+    }
+
+    snap_init(&s, engine->name, tracenum, opnum, engine->heapsize(), live);
+    engine->heap_walk(walk_snap, &s);
+    snprintf(path, sizeof(path), "%s.%s.%d.%d.snap", snap_prefix,
+	     engine->name, tracenum, opnum);
+    if (snap_write(&s, path) < 0)
+	unix_error(path);
+    if (verbose > 1)
+	printf("Wrote %s (%u blocks)\n", path, s.h.nblocks);
+    snap_free(&s);
+}
 
 /*
  * eval_mm_speed - This is the function that is used by fcyc()
@@ -789,8 +1054,8 @@ static void eval_mm_speed(void *ptr)
     trace_t *trace = ((speed_t *)ptr)->trace;
 
     /* Reset the heap and initialize the mm package */
-    mem_reset_brk();
-    if (mm_init() < 0) 
+    engine->heap_reset();
+    if (engine->init() < 0) 
 	app_error("mm_init failed in eval_mm_speed");
 
     /* Interpret each trace request */
@@ -800,7 +1065,7 @@ static void eval_mm_speed(void *ptr)
         case ALLOC: /* mm_malloc */
             index = trace->ops[i].index;
             size = trace->ops[i].size;
-            if ((p = mm_malloc(size)) == NULL)
+            if ((p = engine->malloc(size)) == NULL)
 		app_error("mm_malloc error in eval_mm_speed");
             trace->blocks[index] = p;
             break;
@@ -809,7 +1074,7 @@ static void eval_mm_speed(void *ptr)
 	    index = trace->ops[i].index;
             newsize = trace->ops[i].size;
 	    oldp = trace->blocks[index];
-            if ((newp = mm_realloc(oldp,newsize)) == NULL)
+            if ((newp = engine->realloc(oldp,newsize)) == NULL)
 		app_error("mm_realloc error in eval_mm_speed");
             trace->blocks[index] = newp;
             break;
@@ -817,7 +1082,7 @@ static void eval_mm_speed(void *ptr)
         case FREE: /* mm_free */
             index = trace->ops[i].index;
             block = trace->blocks[index];
-            mm_free(block);
+            engine->free(block);
             break;
 
 	default:
@@ -825,6 +1090,467 @@ static void eval_mm_speed(void *ptr)
         }
 }
 
+/*
+ * touch - Write every byte of a payload, then read it back a word at a
+ *     time, like an application initializing and then using an object
+ */
+static void touch(char *p, int size)
+{
+    long sum = 0;
+    int i;
+
+    memset(p, size & 0xFF, size);
+    for (i = 0; i + sizeof(long) <= size; i += sizeof(long))
+	sum += *(long *)(p + i);
+    sink += sum;
+}
+
+/*
+ * eval_mm_locality - Replay the trace like an application would use the
+ *     memory: every new or reallocated payload is written and read, and
+ *     every sweep_ops ops all live payloads are read in allocation order.
+ *     Blocks the allocator scatters across the heap make this slower and
+ *     miss more in the caches and TLB, even if the allocator itself is
+ *     fast. Timed by fsecs() like eval_mm_speed.
+ */
+static void eval_mm_locality(void *ptr)
+{
+    int i, j, k, index, size;
+    int norder = 0;
+    int *order;             /* ids in allocation order, dead ones included */
+    long sum = 0;
+    char *p;
+    trace_t *trace = ((speed_t *)ptr)->trace;
+
+    if ((order = malloc(trace->num_ops * sizeof(int))) == NULL)
+	unix_error("malloc failed in eval_mm_locality");
+    for (i = 0; i < trace->num_ids; i++)
+	trace->blocks[i] = NULL;
+
+    /* Reset the heap and initialize the mm package */
+    engine->heap_reset();
+    if (engine->init() < 0) 
+	app_error("mm_init failed in eval_mm_locality");
+
+    for (i = 0;  i < trace->num_ops;  i++) {
+	index = trace->ops[i].index;
+	size = trace->ops[i].size;
+        switch (trace->ops[i].type) {
+
+        case ALLOC: /* mm_malloc */
+            if ((p = engine->malloc(size)) == NULL)
+		app_error("mm_malloc error in eval_mm_locality");
+	    touch(p, size);
+            trace->blocks[index] = p;
+            trace->block_sizes[index] = size;
+	    order[norder++] = index;
+            break;
+
+	case REALLOC: /* mm_realloc, keeps its place in allocation order */
+            if ((p = engine->realloc(trace->blocks[index], size)) == NULL)
+		app_error("mm_realloc error in eval_mm_locality");
+	    touch(p, size);
+            trace->blocks[index] = p;
+            trace->block_sizes[index] = size;
+            break;
+
+        case FREE: /* mm_free */
+            engine->free(trace->blocks[index]);
+            trace->blocks[index] = NULL;
+            break;
+
+	default:
+	    app_error("Nonexistent request type in eval_mm_locality");
+        }
+
+	if ((i + 1) % sweep_ops != 0)
+	    continue;
+
+	/* Sweep the live blocks, dropping dead ones from the order */
+	for (j = k = 0; j < norder; j++) {
+	    if ((p = trace->blocks[order[j]]) == NULL)
+		continue;
+	    order[k++] = order[j];
+	    size = trace->block_sizes[order[j]];
+	    for (index = 0; index + sizeof(long) <= size; index += sizeof(long))
+		sum += *(long *)(p + index);
+	}
+	norder = k;
+    }
+    sink += sum;
+    free(order);
+}
+
+/*
+ * eval_mm_lat - Replay the trace once more, timing every request
+ *    individually, and record the latencies (less the timer overhead)
+ *    in one histogram per request type.
+ */
+static void eval_mm_lat(trace_t *trace, lat_t *lat)
+{
+    int i, index, size;
+    char *p;
+    lat_ticks_t t0, t1, d;
+
+    for (i = 0; i < NLATOPS; i++)
+	lathist_init(&lat->hist[i]);
+
+    /* Reset the heap and initialize the mm package */
+    engine->heap_reset();
+    if (engine->init() < 0) 
+	app_error("mm_init failed in eval_mm_lat");
+
+    for (i = 0;  i < trace->num_ops;  i++) {
+	index = trace->ops[i].index;
+	size = trace->ops[i].size;
+        switch (trace->ops[i].type) {
+
+        case ALLOC: /* mm_malloc */
+	    t0 = lat_start();
+	    p = engine->malloc(size);
+	    t1 = lat_stop();
+	    if (p == NULL)
+		app_error("mm_malloc error in eval_mm_lat");
+	    trace->blocks[index] = p;
+	    break;
+
+	case REALLOC: /* mm_realloc */
+	    t0 = lat_start();
+	    p = engine->realloc(trace->blocks[index], size);
+	    t1 = lat_stop();
+	    if (p == NULL)
+		app_error("mm_realloc error in eval_mm_lat");
+	    trace->blocks[index] = p;
+	    break;
+
+        case FREE: /* mm_free */
+	    p = trace->blocks[index];
+	    t0 = lat_start();
+	    engine->free(p);
+	    t1 = lat_stop();
+	    break;
+
+	default:
+	    app_error("Nonexistent request type in eval_mm_lat");
+	    return;
+        }
+	d = t1 - t0;
+	lathist_add(&lat->hist[trace->ops[i].type],
+		    (d > lat_ovhd) ? d - lat_ovhd : 0);
+    }
+}
+
+/*
+ * eval_engine - Evaluate the current engine for correctness, space
+ *    utilization and speed on every trace, and optionally collect
+ *    per-request latencies if lats is not NULL.
+ */
+static void eval_engine(int n, char **tracefiles, stats_t *stats, lat_t *lats)
+{
+    int i;
+    trace_t *trace;
+    range_t *ranges = NULL;
+    speed_t speed_params;
+
+    /* Initialize the engine's simulated memory system */
+    engine->heap_init(); 
+
+    for (i=0; i < n; i++) {
+	trace = read_trace(tracedir, tracefiles[i]);
+	stats[i].ops = trace->num_ops;
+	if (verbose > 1)
+	    printf("Checking mm_malloc for correctness, ");
+	stats[i].valid = eval_mm_valid(trace, i, &ranges);
+	if (stats[i].valid) {
+	    if (verbose > 1)
+		printf("efficiency, ");
+	    stats[i].util = eval_mm_util(trace, i, &ranges, &stats[i]);
+#ifdef MM_STATS
+	    if (verbose && engine == &mm_engine)
+		printmmstats(i);
+#endif
+	    speed_params.trace = trace;
+	    speed_params.ranges = ranges;
+	    if (verbose > 1)
+		printf("and performance.\n");
+	    time_speed(eval_mm_speed, &speed_params, &stats[i]);
+	    if (run_perf) {
+		perfctr_open();
+		perfctr_start();
+		eval_mm_speed(&speed_params);
+		perfctr_stop(&stats[i].perf);
+		perfctr_close();
+	    }
+	    if (sweep_ops > 0) {
+		stats[i].loc_secs = fsecs(eval_mm_locality, &speed_params);
+		perfctr_open();
+		perfctr_start();
+		eval_mm_locality(&speed_params);
+		perfctr_stop(&stats[i].loc_perf);
+		perfctr_close();
+	    }
+	    if (lats)
+		eval_mm_lat(trace, &lats[i]);
+	}
+	free_trace(trace);
+    }
+    clear_ranges(&ranges);
+}
+
+/*
+ * soak_rand - private generator for the soak test, so that a soak is
+ *     reproducible
+ */
+static unsigned soak_rand(unsigned n)
+{
+    soak_rng ^= soak_rng << 13;
+    soak_rng ^= soak_rng >> 7;
+    soak_rng ^= soak_rng << 17;
+    return (unsigned)(soak_rng % n);
+}
+
+/*
+ * soak_shuffle - Pick a new random order of the traces
+ */
+static void soak_shuffle(soak_t *s)
+{
+    int i, j, t;
+
+    for (i = s->n - 1; i > 0; i--) {
+	j = soak_rand(i + 1);
+	t = s->order[i];
+	s->order[i] = s->order[j];
+	s->order[j] = t;
+    }
+    s->cur = 0;
+}
+
+/*
+ * soak_finish - Free the blocks a replay left allocated when its trace
+ *     ended and start the trace over. Real programs don't hand their
+ *     memory back in trace order, so this is the only place the soak
+ *     test frees blocks the trace itself didn't.
+ */
+static void soak_finish(soak_t *s, instance_t *in)
+{
+    int i;
+
+    for (i = 0; i < in->trace->num_ids; i++) {
+	if (in->blocks[i] == NULL)
+	    continue;
+	engine->free(in->blocks[i]);
+	s->live -= in->sizes[i];
+	in->blocks[i] = NULL;
+	s->ops++;
+    }
+    in->next = 0;
+}
+
+/*
+ * soak_step - Replay the next request of an instance. Returns -1 if
+ *     the allocator failed.
+ */
+static int soak_step(soak_t *s, instance_t *in)
+{
+    traceop_t *op = &in->trace->ops[in->next++];
+    char *p;
+
+    switch (op->type) {
+    case ALLOC:
+    case REALLOC:
+	p = (op->type == ALLOC) ? engine->malloc(op->size)
+	    : engine->realloc(in->blocks[op->index], op->size);
+	if (p == NULL)
+	    return -1;
+	s->live += op->size - in->sizes[op->index];
+	if (s->live > s->peak)
+	    s->peak = s->live;
+	in->blocks[op->index] = p;
+	in->sizes[op->index] = op->size;
+	break;
+    case FREE:
+	engine->free(in->blocks[op->index]);
+	s->live -= in->sizes[op->index];
+	in->blocks[op->index] = NULL;
+	in->sizes[op->index] = 0;
+	break;
+    }
+    s->ops++;
+    return 0;
+}
+
+/*
+ * soak_epoch - Replay epoch_ops requests, timed by fsecs_once. Traces
+ *     are either replayed back to back in a shuffled order, or all at
+ *     once with every request taken from a random trace.
+ */
+static void soak_epoch(void *ptr)
+{
+    soak_t *s = (soak_t *)ptr;
+    instance_t *in;
+
+    s->ops = 0;
+    s->peak = s->live;
+    while (s->ops < s->epoch_ops) {
+	if (s->interleave)
+	    in = &s->inst[soak_rand(s->n)];
+	else
+	    in = &s->inst[s->order[s->cur]];
+
+	if (in->next < in->trace->num_ops && soak_step(s, in) < 0) {
+	    s->failed = 1;
+	    return;
+	}
+	if (in->next == in->trace->num_ops) {
+	    soak_finish(s, in);
+	    if (!s->interleave && ++s->cur == s->n)
+		soak_shuffle(s);
+	}
+    }
+}
+
+/*
+ * soak_steady - Return the first epoch from which on throughput and
+ *     utilization no longer drift: the mean Kops of the first and the
+ *     second half of the remaining epochs differ by at most 5%, and
+ *     their mean utilization by at most one point. Comparing halves
+ *     rather than single epochs keeps timing noise from hiding a
+ *     steady state. Returns -1 if there is none over at least four
+ *     epochs.
+ */
+static int soak_steady(epoch_t *e, int n)
+{
+    int i, j, half;
+    double kops[2], util[2];
+
+    for (i = 0; i + 4 <= n; i++) {
+	half = (n - i) / 2;
+	kops[0] = kops[1] = util[0] = util[1] = 0;
+	for (j = i; j < n; j++) {
+	    kops[j >= n - half] += e[j].ops / e[j].secs;
+	    util[j >= n - half] += (double)e[j].peak / e[j].heapsize;
+	}
+	kops[0] /= n - i - half;
+	util[0] /= n - i - half;
+	kops[1] /= half;
+	util[1] /= half;
+	if (fabs(kops[1] - kops[0]) <= 0.05 * kops[0] &&
+	    fabs(util[1] - util[0]) <= 0.01)
+	    return i;
+    }
+    return -1;
+}
+
+/*
+ * eval_soak - Age one heap of the current engine by replaying the
+ *     traces over and over for total_ops requests, without ever
+ *     resetting it. Every epoch_ops requests, print the throughput of
+ *     the epoch, its utilization (peak live bytes over heap size, as in
+ *     eval_mm_util) and the free blocks of the heap, then report whether
+ *     and where throughput and utilization reached a steady state.
+ */
+static void eval_soak(int n, char **tracefiles, long total_ops, long epoch_ops,
+		      int interleave)
+{
+    soak_t s;
+    epoch_t *e;
+    int i, nepochs, steady, merged;
+    long done;
+    double kops0, util0, kops, util, frag;
+
+    nepochs = (total_ops + epoch_ops - 1) / epoch_ops;
+    if ((s.inst = calloc(n, sizeof(instance_t))) == NULL ||
+	(s.order = malloc(n * sizeof(int))) == NULL ||
+	(e = calloc(nepochs, sizeof(epoch_t))) == NULL)
+	unix_error("malloc failed in eval_soak");
+    for (i = 0; i < n; i++) {
+	s.inst[i].trace = read_trace(tracedir, tracefiles[i]);
+	if ((s.inst[i].blocks = calloc(s.inst[i].trace->num_ids,
+				       sizeof(char *))) == NULL ||
+	    (s.inst[i].sizes = calloc(s.inst[i].trace->num_ids,
+				      sizeof(int))) == NULL)
+	    unix_error("malloc failed in eval_soak");
+	if (s.inst[i].trace->num_ops == 0) {
+	    sprintf(msg, "Trace %s has no requests to soak with", tracefiles[i]);
+	    app_error(msg);
+	}
+	s.order[i] = i;
+    }
+    s.n = n;
+    s.interleave = interleave;
+    s.epoch_ops = epoch_ops;
+    s.live = 0;
+    s.failed = 0;
+    soak_shuffle(&s);
+
+    /* The only reset of the whole test */
+    engine->heap_reset();
+    if (engine->init() < 0)
+	app_error("mm_init failed in eval_soak");
+
+    printf("Soak test (%s, %d traces, %ld ops in epochs of %ld):\n",
+	   interleave ? "interleaved" : "shuffled", n, total_ops, epoch_ops);
+    printf("%5s%12s%9s%6s%11s%7s%8s\n",
+	   "epoch", "ops", "Kops", "util", "heap", "frag", "nfree");
+    for (i = 0, done = 0, merged = 0; done < total_ops && !s.failed; i++) {
+	/* An epoch too short for the timer takes in the next ones */
+	do {
+	    s.epoch_ops = (total_ops - done < epoch_ops) ? total_ops - done : epoch_ops;
+	    e[i].secs += fsecs_once(soak_epoch, &s);
+	    e[i].ops += s.ops;
+	    if (s.peak > e[i].peak)
+		e[i].peak = s.peak;
+	    done += s.ops;
+	    merged += (e[i].ops > s.ops);
+	} while (e[i].secs < SOAK_MIN_SECS && done < total_ops && !s.failed);
+	if (e[i].secs <= 0)
+	    break;
+	e[i].heapsize = engine->heapsize();
+	if (engine->heap_walk)
+	    engine->heap_walk(walk_free, &e[i].h);
+
+	frag = e[i].h.free_bytes ?
+	    1.0 - (double)e[i].h.largest_free / e[i].h.free_bytes : 0.0;
+	printf("%5d%12ld%9.0f%5.0f%%%11lu%6.1f%%%8lu\n", i, done,
+	       (e[i].ops/1e3)/e[i].secs, 100.0 * e[i].peak / e[i].heapsize,
+	       (unsigned long)e[i].heapsize, 100.0 * frag,
+	       (unsigned long)e[i].h.free_blocks);
+    }
+    nepochs = i;
+    if (s.failed)
+	printf("The allocator ran out of memory after %ld ops.\n", done);
+    if (merged > 0)
+	printf("Epochs too short to time took in the %d epoch(s) of %ld ops "
+	       "after them (raise -E).\n", merged, epoch_ops);
+
+    /* Compare the steady state, if any, with the fresh heap */
+    if (nepochs > 0 && (steady = soak_steady(e, nepochs)) >= 0) {
+	kops0 = (e[0].ops/1e3)/e[0].secs;
+	util0 = (double)e[0].peak / e[0].heapsize;
+	for (i = steady, kops = util = 0; i < nepochs; i++) {
+	    kops += (e[i].ops/1e3)/e[i].secs;
+	    util += (double)e[i].peak / e[i].heapsize;
+	}
+	kops /= nepochs - steady;
+	util /= nepochs - steady;
+	printf("Steady state from epoch %d: %.0f Kops, %.0f%% util "
+	       "(%+.1f%% Kops, %+.1f points util since epoch 0)\n",
+	       steady, kops, 100.0 * util, 100.0 * (kops - kops0) / kops0,
+	       100.0 * (util - util0));
+    }
+    else if (nepochs > 0)
+	printf("No steady state reached, soak longer (-A).\n");
+
+    for (i = 0; i < n; i++) {
+	free(s.inst[i].blocks);
+	free(s.inst[i].sizes);
+	free_trace(s.inst[i].trace);
+    }
+    free(s.inst);
+    free(s.order);
+    free(e);
+}
+
 /*
  * eval_libc_valid - We run this function to make sure that the
  *    libc malloc can run to completion on the set of traces.
@@ -910,6 +1636,21 @@ static void eval_libc_speed(void *ptr)
     }
 }
 
+/*
+ * time_speed - Time f, one of the xxx_speed functions, and record the
+ *     result in stats. In benchmark mode the trace is run repeatedly
+ *     and secs is the median of the runs after outlier rejection.
+ */
+static void time_speed(fsecs_test_funct f, speed_t *params, stats_t *stats)
+{
+    if (bench_mode) {
+	bench_run(f, params, &stats->bench);
+	stats->secs = stats->bench.median;
+    }
+    else
+	stats->secs = fsecs(f, params);
+}
+
 /*************************************
  * Some miscellaneous helper routines
  ************************************/
@@ -920,26 +1661,40 @@ static void eval_libc_speed(void *ptr)
  */
 static void printresults(int n, stats_t *stats) 
 {
-    int i;
+    int i, j;
     double secs = 0;
     double ops = 0;
     double util = 0;
+    perfctr_t perf;
+
+    memset(&perf, 0, sizeof(perf));
+    for (j = 0; j < PERF_NCOUNTERS; j++)
+	perf.valid[j] = 1;
 
     /* Print the individual results for each trace */
-    printf("%5s%7s %5s%8s%10s%6s\n", 
+    printf("%5s%7s %5s%8s%10s%6s", 
 	   "trace", " valid", "util", "ops", "secs", "Kops");
+    if (run_perf)
+	for (j = 0; j < PERF_NCOUNTERS; j++)
+	    printf("%8s", perfctr_name(j));
+    printf("\n");
     for (i=0; i < n; i++) {
 	if (stats[i].valid) {
-	    printf("%2d%10s%5.0f%%%8.0f%10.6f%6.0f\n", 
+	    printf("%2d%10s%5.0f%%%8.0f%10.6f", 
 		   i,
 		   "yes",
 		   stats[i].util*100.0,
 		   stats[i].ops,
-		   stats[i].secs,
-		   (stats[i].ops/1e3)/stats[i].secs);
+		   stats[i].secs);
+	    printkops(stats[i].ops, stats[i].secs, 6);
+	    printperf(&stats[i].perf, stats[i].ops);
 	    secs += stats[i].secs;
 	    ops += stats[i].ops;
 	    util += stats[i].util;
+	    for (j = 0; j < PERF_NCOUNTERS; j++) {
+		perf.valid[j] &= stats[i].perf.valid[j];
+		perf.count[j] += stats[i].perf.count[j];
+	    }
 	}
 	else {
 	    printf("%2d%10s%6s%8s%10s%6s\n", 
@@ -954,12 +1709,13 @@ static void printresults(int n, stats_t *stats)
 
     /* Print the aggregate results for the set of traces */
     if (errors == 0) {
-	printf("%12s%5.0f%%%8.0f%10.6f%6.0f\n", 
+	printf("%12s%5.0f%%%8.0f%10.6f", 
 	       "Total       ",
 	       (util/n)*100.0,
 	       ops, 
-	       secs,
-	       (ops/1e3)/secs);
+	       secs);
+	printkops(ops, secs, 6);
+	printperf(&perf, ops);
     }
     else {
 	printf("%12s%6s%8s%10s%6s\n", 
@@ -972,6 +1728,346 @@ static void printresults(int n, stats_t *stats)
 
 }
 
+/*
+ * printfrag - prints the peak utilization next to the time-averaged
+ *     utilization and external fragmentation of each trace
+ */
+static void printfrag(int n, stats_t *stats)
+{
+    int i;
+
+    printf("%5s%8s%8s%10s%9s\n", "trace", "samples", "util", "avg util",
+	   "avg frag");
+    for (i = 0; i < n; i++) {
+	if (!stats[i].valid || stats[i].samples == 0)
+	    continue;
+	printf("%2d%11d%7.0f%%%9.0f%%%8.0f%%\n", i, stats[i].samples,
+	       stats[i].util*100.0, stats[i].avg_util*100.0,
+	       stats[i].avg_frag*100.0);
+    }
+}
+
+#ifdef MM_STATS
+/*
+ * printmmstats - prints the counters of the mm package after the
+ *     utilization pass of a trace
+ */
+static void printmmstats(int tracenum)
+{
+    mm_stats_t st;
+    int c;
+
+    mm_stats(&st);
+    printf("mm stats for trace %d:\n", tracenum);
+    printf("  calls     %lu malloc, %lu free, %lu realloc\n",
+	   st.mallocs, st.frees, st.reallocs);
+    printf("  bytes     %lu requested, %lu handed out (%.0f%%)\n",
+	   st.bytes_requested, st.bytes_allocated,
+	   st.bytes_allocated ? 100.0 * st.bytes_requested / st.bytes_allocated : 0.0);
+    printf("  search    %lu searches, %.1f blocks avg, %lu max\n",
+	   st.searches, st.searches ? (double)st.search_steps / st.searches : 0.0,
+	   st.search_max);
+    printf("  coalesce  %lu / %lu / %lu / %lu (cases 1-4), %lu splits\n",
+	   st.coalesce[0], st.coalesce[1], st.coalesce[2], st.coalesce[3],
+	   st.splits);
+    printf("  extend    %lu times, %lu bytes\n", st.extends, st.extend_bytes);
+    printf("  live     ");
+    for (c = 0; c < MM_NCLASSES; c++)
+	if (st.live[c] != 0)
+	    printf(" %ld@%d%s", st.live[c], 16 << c,
+		   c == MM_NCLASSES - 1 ? "+" : "");
+    printf("\n");
+}
+#endif /* MM_STATS */
+
+/*
+ * printlocality - prints the running time and cache and TLB misses of
+ *     the locality pass of each trace
+ */
+static void printlocality(int n, stats_t *stats)
+{
+    int i, j;
+    static int events[] = {PERF_L1D_MISSES, PERF_LLC_MISSES, PERF_DTLB_MISSES};
+    perfctr_t *c;
+
+    printf("Application locality (sweep every %d ops), per op:\n", sweep_ops);
+    printf("%5s%10s%8s", "trace", "secs", "Kops");
+    for (j = 0; j < sizeof(events)/sizeof(int); j++)
+	printf("%8s", perfctr_name(events[j]));
+    printf("\n");
+    for (i = 0; i < n; i++) {
+	if (!stats[i].valid)
+	    continue;
+	c = &stats[i].loc_perf;
+	printf("%2d%13.6f", i, stats[i].loc_secs);
+	printkops(stats[i].ops, stats[i].loc_secs, 8);
+	for (j = 0; j < sizeof(events)/sizeof(int); j++) {
+	    if (c->valid[events[j]])
+		printf("%8.2f", c->count[events[j]]/stats[i].ops);
+	    else
+		printf("%8s", "-");
+	}
+	printf("\n");
+    }
+}
+
+/*
+ * printperf - finishes a printresults line with the hardware counts
+ *     per op, if they were collected
+ */
+static void printperf(perfctr_t *perf, double ops)
+{
+    int j;
+
+    if (run_perf) {
+	for (j = 0; j < PERF_NCOUNTERS; j++) {
+	    if (perf->valid[j])
+		printf("%8.2f", perf->count[j]/ops);
+	    else
+		printf("%8s", "-");
+	}
+    }
+    printf("\n");
+}
+
+/*
+ * printlatency - prints tail latency percentiles for each request type
+ *     of each trace
+ */
+static void printlatency(int n, stats_t *stats, lat_t *lats)
+{
+    static char *opnames[NLATOPS] = {"malloc", "free", "realloc"};
+    int i, j;
+    lathist_t *h;
+
+    printf("Latency per request in %s (timer overhead of %llu subtracted):\n",
+	   LAT_UNITS, lat_ovhd);
+    printf("%5s %-8s%9s%8s%8s%8s%8s%10s\n",
+	   "trace", "op", "count", "p50", "p90", "p99", "p99.9", "max");
+    for (i = 0; i < n; i++) {
+	if (!stats[i].valid)
+	    continue;
+	for (j = 0; j < NLATOPS; j++) {
+	    h = &lats[i].hist[j];
+	    if (h->count == 0)
+		continue;
+	    printf("%2d    %-8s%9llu%8llu%8llu%8llu%8llu%10llu\n",
+		   i, opnames[j], h->count,
+		   lathist_percentile(h, 50.0),
+		   lathist_percentile(h, 90.0),
+		   lathist_percentile(h, 99.0),
+		   lathist_percentile(h, 99.9),
+		   h->max);
+	}
+    }
+}
+
+/*
+ * printkops - prints the throughput of ops in secs in a field of width,
+ *     or "-" if secs is 0, too short for the timer to measure
+ */
+static void printkops(double ops, double secs, int width)
+{
+    if (secs > 0)
+	printf("%*.0f", width, (ops/1e3)/secs);
+    else
+	printf("%*s", width, "-");
+}
+
+/*
+ * printbench - prints the distribution of the timed runs of each trace
+ *     in benchmark mode, with throughputs at the ends of the confidence
+ *     interval of the median time
+ */
+static void printbench(int n, stats_t *stats)
+{
+    int i;
+    bench_t *b;
+
+    printf("%5s%5s%5s%12s%12s%8s%8s%8s\n", 
+	   "trace", "runs", "out", "median", "stddev", "Kops", "Kops-", "Kops+");
+    for (i = 0; i < n; i++) {
+	b = &stats[i].bench;
+	if (!stats[i].valid || b->n == 0)
+	    continue;
+	printf("%2d%8d%5d%12.6f%12.6f", i, b->n, b->outliers, b->median,
+	       b->stddev);
+	printkops(stats[i].ops, b->median, 8);
+	printkops(stats[i].ops, b->ci_hi, 8);
+	printkops(stats[i].ops, b->ci_lo, 8);
+	printf("\n");
+    }
+}
+
+/*
+ * printmatrix - prints utilization and throughput of every engine on
+ *     every trace side by side
+ */
+static void printmatrix(int n, int nengines, mm_engine_t **engines,
+			stats_t **stats)
+{
+    int i, j;
+    double ops, secs, util, kops[MAXENGINES];
+    int valid;
+
+    printf("Engine comparison (util%%, Kops):\n");
+    printf("%5s", "trace");
+    for (j = 0; j < nengines; j++)
+	printf("  %16.16s", engines[j]->name);
+    printf("\n");
+    for (i = 0; i < n; i++) {
+	printf("%2d   ", i);
+	for (j = 0; j < nengines; j++) {
+	    if (stats[j][i].valid) {
+		printf("  %6.0f%%", stats[j][i].util*100.0);
+		printkops(stats[j][i].ops, stats[j][i].secs, 9);
+	    }
+	    else
+		printf("  %16s", "invalid");
+	}
+	printf("\n");
+    }
+
+    /* Averaged utilization and overall throughput, over valid traces;
+       the throughput only counts the traces the timer could measure */
+    printf("%5s", "Total");
+    for (j = 0; j < nengines; j++) {
+	ops = secs = util = 0;
+	valid = 0;
+	for (i = 0; i < n; i++) {
+	    if (!stats[j][i].valid)
+		continue;
+	    if (stats[j][i].secs > 0) {
+		ops += stats[j][i].ops;
+		secs += stats[j][i].secs;
+	    }
+	    util += stats[j][i].util;
+	    valid++;
+	}
+	if (valid == n) {
+	    printf("  %6.0f%%", (util/n)*100.0);
+	    printkops(ops, secs, 9);
+	}
+	else
+	    printf("  %16s", "-");
+	kops[j] = (valid == n && secs > 0) ? (ops/1e3)/secs : 0;
+    }
+    printf("\n");
+
+    /* Throughput of each engine relative to the first one, e.g. the
+       cost of a hardened build of the same allocator */
+    printf("%5s", "vs 0");
+    for (j = 0; j < nengines; j++) {
+	if (kops[0] > 0 && kops[j] > 0)
+	    printf("  %15.1f%%", 100.0 * (kops[j] / kops[0] - 1.0));
+	else
+	    printf("  %16s", "-");
+    }
+    printf("\n");
+}
+
+/*
+ * writeresults - write the results of every trace to path as JSON or CSV
+ */
+static void writeresults(char *path, int csv, int n, char **names,
+			 stats_t *stats, env_t *env)
+{
+    FILE *fp;
+
+    if ((fp = fopen(path, "w")) == NULL) {
+	sprintf(msg, "Could not open %s in writeresults", path);
+	unix_error(msg);
+    }
+    if (csv)
+	results_write_csv(fp, env, n, names, stats);
+    else
+	results_write_json(fp, env, n, names, stats);
+    fclose(fp);
+}
+
+/*
+ * compare_baseline - print the change of each trace against the results
+ *     in path and return the number of traces that got worse by more
+ *     than threshold percent. Throughput only counts as worse if the
+ *     confidence intervals of both runs don't overlap, so noise alone
+ *     can't trip the gate. Utilization is deterministic and is compared
+ *     directly. A trace that was valid and no longer is always counts,
+ *     and so does one that can't be compared because it has no time
+ *     (too fast for the timer) or no utilization on either side.
+ */
+static int compare_baseline(char *path, double threshold, int n,
+			    char **names, stats_t *stats)
+{
+    char **base_names;
+    stats_t *base_stats, *b, *s;
+    int i, j, nbase, worse, regressions = 0, unmeasured = 0;
+    double kops, base_kops, dkops, dutil;
+    char *verdict;
+
+    if ((nbase = results_read_json(path, &base_names, &base_stats)) < 0) {
+	sprintf(msg, "Could not read baseline %s", path);
+	unix_error(msg);
+    }
+
+    printf("Comparison against baseline %s (threshold %.1f%%):\n",
+	   path, threshold);
+    printf("%5s%7s%7s%8s%9s%9s%8s  %s\n",
+	   "trace", "util", "base", "delta", "Kops", "base", "delta", "verdict");
+    for (i = 0; i < n; i++) {
+	s = &stats[i];
+	for (j = 0, b = NULL; j < nbase && b == NULL; j++)
+	    if (!strcmp(names[i], base_names[j]))
+		b = &base_stats[j];
+
+	if (b == NULL || !b->valid) {
+	    printf("%2d%49s  %s\n", i, "", b ? "base invalid" : "new");
+	    continue;
+	}
+	if (!s->valid) {
+	    printf("%2d%49s  %s\n", i, "", "REGRESSED (invalid)");
+	    regressions++;
+	    continue;
+	}
+
+	if (s->secs <= 0 || b->secs <= 0 || s->util <= 0 || b->util <= 0) {
+	    printf("%2d%49s  %s\n", i, "", "unmeasurable");
+	    unmeasured++;
+	    continue;
+	}
+	kops = (s->ops/1e3)/s->secs;
+	base_kops = (b->ops/1e3)/b->secs;
+	dkops = 100.0 * (kops - base_kops) / base_kops;
+	dutil = 100.0 * (s->util - b->util) / b->util;
+
+	worse = 0;
+	if (-dutil > threshold)
+	    worse = 1;
+	if (-dkops > threshold &&
+	    (s->bench.n == 0 || b->bench.n == 0 || s->bench.ci_lo > b->bench.ci_hi))
+	    worse = 1;
+	if (worse)
+	    verdict = "REGRESSED";
+	else if (dutil > threshold || dkops > threshold)
+	    verdict = "improved";
+	else
+	    verdict = "ok";
+	regressions += worse;
+
+	printf("%2d%9.1f%%%6.1f%%%+7.1f%%%9.0f%9.0f%+7.1f%%  %s\n",
+	       i, s->util*100.0, b->util*100.0, dutil,
+	       kops, base_kops, dkops, verdict);
+    }
+
+    if (unmeasured > 0)
+	printf("%d trace(s) could not be compared\n", unmeasured);
+
+    for (j = 0; j < nbase; j++)
+	free(base_names[j]);
+    free(base_names);
+    free(base_stats);
+    return regressions + unmeasured;
+}
+
 /* 
  * app_error - Report an arbitrary application error
  */
@@ -1004,14 +2100,45 @@ void malloc_error(int tracenum, int opnum, char *msg)
  */
 static void usage(void) 
 {
-    fprintf(stderr, "Usage: mdriver [-hvVal] [-f <file>] [-t <dir>]\n");
+    fprintf(stderr, "Usage: mdriver [-hvValHBPI] [-f <file>] [-t <dir>] [-T <timer>] [-C <cpu>]\n");
+    fprintf(stderr, "               [-w <n>] [-n <n>] [-j <file>] [-c <file>] [-e <engine.so>]...\n");
+    fprintf(stderr, "               [-S <n>] [-F <file>] [-L <n>] [-A <ops>] [-E <ops>]\n");
+    fprintf(stderr, "               [-Z <op>,...] [-O <prefix>]\n");
+    fprintf(stderr, "               [--baseline <file>] [--threshold <pct>]\n");
     fprintf(stderr, "Options\n");
     fprintf(stderr, "\t-a         Don't check the team structure.\n");
+    fprintf(stderr, "\t-A <ops>   Soak test: replay the traces for <ops> requests\n");
+    fprintf(stderr, "\t           on one heap that is never reset.\n");
+    fprintf(stderr, "\t-b <file>  (--baseline) Compare against JSON results in <file>,\n");
+    fprintf(stderr, "\t           exit with status 2 if any trace regressed. Implies -B.\n");
+    fprintf(stderr, "\t-B         Benchmark mode: median, stddev and 95%% CI of runs.\n");
+    fprintf(stderr, "\t-c <file>  Write the results to <file> as CSV.\n");
+    fprintf(stderr, "\t-e <file>  Also evaluate the engine in shared object <file>.\n");
+    fprintf(stderr, "\t-E <ops>   Requests per soak test epoch (default 1/20 of -A).\n");
+    fprintf(stderr, "\t-C <cpu>   Pin the driver to CPU <cpu>.\n");
     fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
+    fprintf(stderr, "\t-F <file>  Write the heap samples to <file> as CSV (implies -S 100).\n");
     fprintf(stderr, "\t-g         Generate summary info for autograder.\n");
     fprintf(stderr, "\t-h         Print this message.\n");
+    fprintf(stderr, "\t-H         Print per-request latency percentiles.\n");
+    fprintf(stderr, "\t-I         Interleave the traces in the soak test, instead of\n");
+    fprintf(stderr, "\t           replaying them back to back in a shuffled order.\n");
+    fprintf(stderr, "\t-j <file>  Write the results to <file> as JSON.\n");
     fprintf(stderr, "\t-l         Run libc malloc as well.\n");
+    fprintf(stderr, "\t-L <n>     Time an application-like replay that touches every\n");
+    fprintf(stderr, "\t           payload and sweeps the live blocks every <n> ops.\n");
+    fprintf(stderr, "\t-n <n>     Timed runs per trace in benchmark mode (default 11).\n");
+    fprintf(stderr, "\t-O <pfx>   Prefix of the snapshot files (default heap).\n");
+    fprintf(stderr, "\t-S <n>     Sample the heap every <n> ops, report average\n");
+    fprintf(stderr, "\t           utilization and external fragmentation.\n");
+    fprintf(stderr, "\t-P         Count cycles, instructions, cache, TLB and branch\n");
+    fprintf(stderr, "\t           misses per op (Linux perf_event_open).\n");
     fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
+    fprintf(stderr, "\t-T <timer> Timing method: fcyc, itimer or gettod.\n");
     fprintf(stderr, "\t-v         Print per-trace performance breakdowns.\n");
     fprintf(stderr, "\t-V         Print additional debug info.\n");
+    fprintf(stderr, "\t-w <n>     Warmup runs per trace in benchmark mode (default 2).\n");
+    fprintf(stderr, "\t-x <pct>   (--threshold) Regression threshold in percent (default 5).\n");
+    fprintf(stderr, "\t-Z <ops>   Snapshot the heap after each of these ops (comma\n");
+    fprintf(stderr, "\t           separated) for heapmap, in every trace.\n");
 }
@@ -14,10 +14,21 @@
 #include "memlib.h"
 #include "config.h"
 
+/* A heap and the memory it grows in */
+struct mem_region {
+    char *start_brk;         /* points to first byte of heap */
+    char *brk;               /* points to last byte of heap */
+    char *max_addr;          /* largest legal heap address */ 
+    int reserved;            /* heap was mapped rather than malloc'ed */
+    char *reserve_end;       /* end of that mapping */
+};
+
+/* Space left for a region's own struct at the start of its mapping */
+#define REGION_HDR 64
+
 /* private variables */
-static char *mem_start_brk;  /* points to first byte of heap */
-static char *mem_brk;        /* points to last byte of heap */
-static char *mem_max_addr;   /* largest legal heap address */ 
+static mem_region_t mem_default;     /* the heap of mem_init */
+static mem_region_t *mem = &mem_default; /* the heap mem_sbrk grows */
 
 /* 
  * mem_init - initialize the memory system model
@@ -25,13 +36,55 @@ static char *mem_max_addr;   /* largest legal heap address */
 void mem_init(void)
 {
     /* allocate the storage we will use to model the available VM */
-    if ((mem_start_brk = (char *)malloc(MAX_HEAP)) == NULL) {
+    if ((mem_default.start_brk = (char *)malloc(MAX_HEAP)) == NULL) {
 	fprintf(stderr, "mem_init_vm: malloc error\n");
 	exit(1);
     }
 
-    mem_max_addr = mem_start_brk + MAX_HEAP;  /* max legal heap address */
-    mem_brk = mem_start_brk;                  /* heap is empty initially */
+    mem_default.max_addr = mem_default.start_brk + MAX_HEAP;  /* max legal heap address */
+    mem_default.brk = mem_default.start_brk;                  /* heap is empty initially */
+}
+
+/*
+ * mem_init_reserve - initialize the memory system on size bytes of
+ *    reserved address space rather than a block from the libc malloc,
+ *    for when the mm package replaces it. Pages are only backed by
+ *    memory once the heap grows over them and they are touched.
+ */
+void mem_init_reserve(size_t size)
+{
+    mem_default.start_brk = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mem_default.start_brk == MAP_FAILED) {
+	fprintf(stderr, "mem_init_reserve: mmap error\n");
+	exit(1);
+    }
+
+    mem_default.max_addr = mem_default.start_brk + size;      /* max legal heap address */
+    mem_default.brk = mem_default.start_brk;                  /* heap is empty initially */
+    mem_default.reserved = 1;
+    mem_default.reserve_end = mem_default.max_addr;
+}
+
+/*
+ * mem_reserve_top - take size bytes, a multiple of the page size, off
+ *    the top of the reserved address space, for the caller to map as it
+ *    likes (the guarded pool of guardpool.c). The heap can no longer
+ *    grow over them. Returns NULL unless the heap was reserved by
+ *    mem_init_reserve and has that much room left.
+ */
+void *mem_reserve_top(size_t size)
+{
+    char *top;
+
+    if (!mem->reserved || size % mem_pagesize() != 0 ||
+	size > (size_t)(mem->max_addr - mem->brk))
+	return NULL;
+    top = (char *)((size_t)(mem->max_addr - size) & ~(mem_pagesize() - 1));
+    if (top < mem->brk)
+	return NULL;
+    mem->max_addr = top;
+    return top;
 }
 
 /* 
@@ -39,7 +92,10 @@ void mem_init(void)
  */
 void mem_deinit(void)
 {
-    free(mem_start_brk);
+    if (mem_default.reserved)
+	munmap(mem_default.start_brk, mem_default.reserve_end - mem_default.start_brk);
+    else
+	free(mem_default.start_brk);
 }
 
 /*
@@ -47,7 +103,7 @@ void mem_deinit(void)
  */
 void mem_reset_brk()
 {
-    mem_brk = mem_start_brk;
+    mem->brk = mem->start_brk;
 }
 
 /* 
@@ -57,15 +113,7 @@ void mem_reset_brk()
  */
 void *mem_sbrk(int incr) 
 {
-    char *old_brk = mem_brk;
-
-    if ( (incr < 0) || ((mem_brk + incr) > mem_max_addr)) {
-	errno = ENOMEM;
-	fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
-	return (void *)-1;
-    }
-    mem_brk += incr;
-    return (void *)old_brk;
+    return mem_region_sbrk(mem, incr);
 }
 
 /*
@@ -73,7 +121,7 @@ void *mem_sbrk(int incr)
  */
 void *mem_heap_lo()
 {
-    return (void *)mem_start_brk;
+    return (void *)mem->start_brk;
 }
 
 /* 
@@ -81,7 +129,7 @@ void *mem_heap_lo()
  */
 void *mem_heap_hi()
 {
-    return (void *)(mem_brk - 1);
+    return (void *)(mem->brk - 1);
 }
 
 /*
@@ -89,7 +137,7 @@ void *mem_heap_hi()
  */
 size_t mem_heapsize() 
 {
-    return (size_t)(mem_brk - mem_start_brk);
+    return (size_t)(mem->brk - mem->start_brk);
 }
 
 /*
@@ -99,3 +147,66 @@ size_t mem_pagesize()
 {
     return (size_t)getpagesize();
 }
+
+/*
+ * mem_region_create - map size bytes of address space for a heap of its
+ *    own, which mem_sbrk grows while the region is switched in. Pages
+ *    are only backed by memory once they are touched. Returns NULL if
+ *    the mapping fails.
+ */
+mem_region_t *mem_region_create(size_t size)
+{
+    mem_region_t *r;
+
+    r = mmap(NULL, REGION_HDR + size, PROT_READ | PROT_WRITE,
+	     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (r == MAP_FAILED)
+	return NULL;
+    r->start_brk = (char *)r + REGION_HDR;
+    r->brk = r->start_brk;
+    r->max_addr = r->start_brk + size;
+    r->reserved = 1;
+    r->reserve_end = r->max_addr;
+    return r;
+}
+
+/*
+ * mem_region_destroy - unmap a region and everything allocated in it.
+ *    It must not be switched in.
+ */
+void mem_region_destroy(mem_region_t *r)
+{
+    munmap(r, r->reserve_end - (char *)r);
+}
+
+/*
+ * mem_region_sbrk - mem_sbrk on region r, whether it is switched in or not.
+ *    Only the heap of mem_init complains when it runs out; heaps of their
+ *    own and arenas are expected to fill up.
+ */
+void *mem_region_sbrk(mem_region_t *r, int incr)
+{
+    char *old_brk = r->brk;
+
+    if ( (incr < 0) || ((r->brk + incr) > r->max_addr)) {
+	errno = ENOMEM;
+	if (r == &mem_default)
+	    fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory...\n");
+	return (void *)-1;
+    }
+    r->brk += incr;
+    return (void *)old_brk;
+}
+
+/*
+ * mem_region_switch - make mem_sbrk and the mem_heap functions work on
+ *    region r, or on the heap of mem_init if r is NULL, and return the
+ *    region they worked on until then
+ */
+mem_region_t *mem_region_switch(mem_region_t *r)
+{
+    mem_region_t *old = (mem == &mem_default) ? NULL : mem;
+
+    mem = (r != NULL) ? r : &mem_default;
+    return old;
+}
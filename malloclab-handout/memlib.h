@@ -1,6 +1,8 @@
 #include <unistd.h>
 
 void mem_init(void);               
+void mem_init_reserve(size_t size);
+void *mem_reserve_top(size_t size);
 void mem_deinit(void);
 void *mem_sbrk(int incr);
 void mem_reset_brk(void); 
@@ -9,3 +11,11 @@ void *mem_heap_hi(void);
 size_t mem_heapsize(void);
 size_t mem_pagesize(void);
 
+/* Heaps of their own, for mm_heap_create */
+typedef struct mem_region mem_region_t;
+
+mem_region_t *mem_region_create(size_t size);
+void mem_region_destroy(mem_region_t *r);
+void *mem_region_sbrk(mem_region_t *r, int incr);
+mem_region_t *mem_region_switch(mem_region_t *r);
+
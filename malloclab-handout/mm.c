@@ -14,9 +14,32 @@
 #include <assert.h>
 #include <unistd.h>
 #include <string.h>
+#include <limits.h>
+#ifdef MM_CHECK
+#include <sys/mman.h>
+#endif
+#if defined(MM_SELFTEST) && defined(MM_GUARD)
+#include <signal.h>
+#include <sys/wait.h>
+#endif
 
 #include "mm.h"
 #include "memlib.h"
+#ifdef MM_HEAPPROF
+#include "heapprof.h"
+#else
+#define HEAPPROF_ALLOC(bp, size)
+#define HEAPPROF_FREE(bp)
+#define HEAPPROF_MOVE(oldbp, newbp, size)
+#endif
+#ifdef MM_GUARD
+#include "guardpool.h"
+#else
+#define GUARD_MALLOC(size, align)
+#define GUARD_OWNS(bp) 0
+#define guard_free(bp)
+#define guard_usable_size(bp) 0
+#endif
 
 /*********************************************************
  * NOTE TO STUDENTS: Before you do anything else, please
@@ -46,11 +69,18 @@ team_t team = {
 #define WSIZE 4 /*  Word and header/footer size (bytes) */
 #define DSIZE 8 /* Double word size (bytes) */
 #define CHUNKSIZE (1 << 12) /* Extend heap by this amount (bytes) */
+#define MAXBLOCK ((size_t)INT_MAX & ~(size_t)(DSIZE - 1)) /* Largest block, for mem_sbrk(int) */
 
 #define MAX(x, y) ((x) > (y) ? (x) : (y))
 
-/* Pack a size allocated bit into a word */
+/* Pack a size allocated bit into a word. Hardened, allocated blocks
+   also carry a magic bit that free blocks and stray data lack. */
+#ifdef MM_HARDEN
+#define HARDEN_MAGIC 0x2
+#define PACK(size, alloc) ((size) | ((alloc) ? (1 | HARDEN_MAGIC) : 0))
+#else
 #define PACK(size, alloc) ((size) | (alloc))
+#endif
 
 static char *heap_listp;
 
@@ -70,82 +100,383 @@ static char *heap_listp;
 #define NEXT_BLKP(bp) ((char *)(bp) + GET_SIZE(((char *)(bp)-WSIZE)))
 #define PREV_BLKP(bp) ((char *)(bp)-GET_SIZE(((char *)(bp)-DSIZE)))
 
-int mm_check(char useExplicitFreeList, char verbose)
-{
-    char status = 1;
-    void *bp;
+/*
+ * Statistics. Every thread counts into a slot of its own without any
+ * synchronization, and mm_stats() adds the slots up. Threads beyond
+ * MM_STATS_THREADS share the last slot, whose counts may then be
+ * slightly off. Without MM_STATS all of this compiles away.
+ */
+#ifdef MM_STATS
+#define MM_STATS_THREADS 64
+
+static mm_stats_t stats_slots[MM_STATS_THREADS];
+static int stats_nslots = 0;
+static __thread mm_stats_t *stats_local;
 
-    printf("\nmm check\n\n==========\n\n");
+static mm_stats_t *stats_slot(void)
+{
+    int i;
 
-    /*Is every block in the free list marked as free?*/
-    if (useExplicitFreeList)
+    if (stats_local == NULL)
     {
+        i = __atomic_fetch_add(&stats_nslots, 1, __ATOMIC_RELAXED);
+        stats_local = &stats_slots[i < MM_STATS_THREADS ? i : MM_STATS_THREADS - 1];
     }
+    return stats_local;
+}
 
-    /*Are there any contiguous free blocks that somehow escaped coalescing?*/
-    char previousBlockWasFree = 0;
-    printf("Are there any contiguous free blocks that somehow escaped coalescing?\n\n");
-    for (bp = heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp))
-    {
-        if (verbose)
-        {
-            printf("Block address: %p ; Free: %d\n", bp, !GET_ALLOC(HDRP(bp)));
-        }
+/* Size class of a block of size bytes */
+static int stats_class(size_t size)
+{
+    int c = 0;
 
-        if (!GET_ALLOC(HDRP(bp)) && previousBlockWasFree && GET_SIZE(HDRP(NEXT_BLKP(bp))) > 0)
-        {
-            // Notice that bp is not the footer
-            printf("Two contiguous free blocks escaped coalescing\n");
-            status = 0;
-        }
+    for (size >>= 5; size > 0 && c < MM_NCLASSES - 1; size >>= 1)
+        c++;
+    return c;
+}
+
+/* Run stmt on the calling thread's counters, which it calls stats */
+#define STAT(stmt)                        \
+    do                                    \
+    {                                     \
+        mm_stats_t *stats = stats_slot(); \
+        stmt;                             \
+    } while (0)
+#else
+#define STAT(stmt)
+#endif
+
+/*
+ * Heap checking. check_block validates one block in constant time and
+ * mm_check sweeps the whole heap with it; errors go to the report
+ * function, by default one line on stderr each.
+ *
+ * With MM_CHECK, two bitmaps also shadow the heap, one bit per double
+ * word: the payload addresses where blocks start, and those of the free
+ * blocks. Every block that mm_free, place and coalesce touch is checked
+ * against them, so bad and double frees are caught when they happen,
+ * and the shadow is kept up to date with the heap. A full sweep also
+ * runs every MM_CHECK_INTERVAL calls (environment, or mm_check_interval).
+ * Without MM_CHECK, the CHECK() hooks compile to nothing.
+ */
+static void report_stderr(const mm_report_t *r);
+static mm_report_funct report_funct = report_stderr;
+
+#ifdef MM_CHECK
+static unsigned char *start_map; /* blocks starting at each double word */
+static unsigned char *free_map;  /* the free ones */
+static size_t map_bytes = 0;     /* size of each bitmap */
+static unsigned long check_ops;  /* allocator calls since mm_init */
+static unsigned long check_every = 0; /* full sweep interval, 0 for none */
+
+#define MAP_BIT(bp) ((size_t)((char *)(bp) - (char *)mem_heap_lo()) / DSIZE)
+#define MAP_GET(map, bp) (((map)[MAP_BIT(bp) >> 3] >> (MAP_BIT(bp) & 7)) & 1)
+#define MAP_SET(map, bp) ((map)[MAP_BIT(bp) >> 3] |= 1 << (MAP_BIT(bp) & 7))
+#define MAP_CLR(map, bp) ((map)[MAP_BIT(bp) >> 3] &= ~(1 << (MAP_BIT(bp) & 7)))
+
+#define CHECK(stmt) \
+    do              \
+    {               \
+        stmt;       \
+    } while (0)
+#else
+#define CHECK(stmt)
+#endif
+
+const char *mm_err_name(mm_err_t err)
+{
+    static const char *names[] = {"bad-pointer", "double-free", "bad-header",
+                                  "bad-layout", "uncoalesced", "shadow-mismatch"};
+
+    return (err >= 0 && err <= MM_ERR_SHADOW) ? names[err] : "unknown";
+}
+
+static void report_stderr(const mm_report_t *r)
+{
+    fprintf(stderr, "mm_check: %s in %s at op %lu: block %p header %#x footer %#x\n",
+            mm_err_name(r->err), r->where, r->op, r->bp, r->header, r->footer);
+}
 
-        previousBlockWasFree = !GET_ALLOC(HDRP(bp));
+void mm_set_report(mm_report_funct f)
+{
+    report_funct = f ? f : report_stderr;
+}
+
+/*
+ * report - Describe an error to the report function, reading the
+ *     header and footer of bp only where they lie inside the heap
+ */
+static int report(mm_err_t err, const char *where, void *bp)
+{
+    mm_report_t r;
+    char *lo = mem_heap_lo(), *hi = mem_heap_hi();
+
+    r.err = err;
+    r.where = where;
+    r.bp = bp;
+    r.header = r.footer = 0;
+    if (bp != NULL && HDRP(bp) >= lo && (char *)bp <= hi)
+    {
+        r.header = GET(HDRP(bp));
+        if (GET_SIZE(HDRP(bp)) >= DSIZE && (char *)FTRP(bp) + WSIZE <= hi + 1)
+            r.footer = GET(FTRP(bp));
     }
-    printf("\n==========\n\n");
+#ifdef MM_CHECK
+    r.op = check_ops;
+#else
+    r.op = 0;
+#endif
+    report_funct(&r);
+    return 1;
+}
+
+/*
+ * check_block - Check in constant time that bp is an aligned payload
+ *     inside the heap, whose size is sane and whose header and footer
+ *     agree (and, with MM_CHECK, that the shadow agrees). Returns 1 if
+ *     an error was reported.
+ */
+static int check_block(void *bp, const char *where)
+{
+    char *lo = mem_heap_lo(), *hi = mem_heap_hi();
+    size_t size;
 
-    /*Is every free block actually in the free list?*/
-    if (useExplicitFreeList)
+    if ((char *)bp <= heap_listp || (char *)bp > hi || ((char *)bp - lo) % DSIZE != 0)
+        return report(MM_ERR_POINTER, where, bp);
+    size = GET_SIZE(HDRP(bp));
+    if (size < 2 * DSIZE || (char *)bp + size > hi + 1 ||
+        GET(HDRP(bp)) != GET(FTRP(bp)))
+        return report(MM_ERR_HEADER, where, bp);
+#ifdef MM_CHECK
+    if (!MAP_GET(start_map, bp) || MAP_GET(free_map, bp) == GET_ALLOC(HDRP(bp)))
+        return report(MM_ERR_SHADOW, where, bp);
+#endif
+    return 0;
+}
+
+#if defined(MM_CHECK) || defined(MM_HARDEN)
+/*
+ * check_neighbours - Check the blocks coalesce may merge bp with.
+ *     Returns 1 if an error was reported.
+ */
+static int check_neighbours(void *bp)
+{
+    if (PREV_BLKP(bp) != heap_listp && check_block(PREV_BLKP(bp), "coalesce"))
+        return 1;
+    if (GET_SIZE(HDRP(NEXT_BLKP(bp))) > 0 && check_block(NEXT_BLKP(bp), "coalesce"))
+        return 1;
+    return 0;
+}
+#endif
+
+/*
+ * Hardened mode. With MM_HARDEN, mm_free, mm_realloc and mm_usable_size
+ * check the pointer they are given in constant time, and report and
+ * ignore it unless it is an allocated block: inside the heap, aligned,
+ * with the allocated and magic bits set, a sane size, and a footer that
+ * matches its header. mm_free also checks the boundary tags of the two
+ * neighbours before coalescing follows them. This needs no extra memory,
+ * unlike MM_CHECK.
+ */
+#ifdef MM_HARDEN
+#define HARDEN(stmt) \
+    do               \
+    {                \
+        stmt;        \
+    } while (0)
+
+/* check_allocated - Returns 1 if bp is not an allocated block */
+static int check_allocated(void *bp, const char *where)
+{
+    char *lo = mem_heap_lo(), *hi = mem_heap_hi();
+    size_t size;
+
+    if ((char *)bp <= heap_listp || (char *)bp > hi || ((char *)bp - lo) % DSIZE != 0)
+        return report(MM_ERR_POINTER, where, bp);
+    if (GET(HDRP(bp)) & HARDEN_MAGIC)
+        return check_block(bp, where);
+
+    /* A block freed before still has matching boundary tags, unless it
+       was coalesced since; anything else is not the start of a block */
+    size = GET_SIZE(HDRP(bp));
+    if (!GET_ALLOC(HDRP(bp)) && size >= 2 * DSIZE && (char *)bp + size <= hi + 1 &&
+        GET(HDRP(bp)) == GET(FTRP(bp)))
+        return report(MM_ERR_DOUBLE_FREE, where, bp);
+    return report(MM_ERR_POINTER, where, bp);
+}
+#else
+#define HARDEN(stmt)
+#endif
+
+#ifdef MM_CHECK
+/*
+ * check_pointer - Check a pointer passed in by the caller, which must
+ *     be an allocated block. Returns 1 if an error was reported.
+ */
+static int check_pointer(void *bp, const char *where)
+{
+    char *lo = mem_heap_lo(), *hi = mem_heap_hi();
+
+    if ((char *)bp <= heap_listp || (char *)bp > hi ||
+        ((char *)bp - lo) % DSIZE != 0 || !MAP_GET(start_map, bp))
+        return report(MM_ERR_POINTER, where, bp);
+    if (MAP_GET(free_map, bp))
+        return report(MM_ERR_DOUBLE_FREE, where, bp);
+    return check_block(bp, where);
+}
+
+/* Record that a block starts at bp, free or not */
+static void shadow_mark(void *bp, int free)
+{
+    MAP_SET(start_map, bp);
+    if (free)
+        MAP_SET(free_map, bp);
+    else
+        MAP_CLR(free_map, bp);
+}
+
+/* Record that no block starts at bp any more */
+static void shadow_unmark(void *bp)
+{
+    MAP_CLR(start_map, bp);
+    MAP_CLR(free_map, bp);
+}
+
+static unsigned char *map_alloc(size_t bytes)
+{
+    void *p = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (p == MAP_FAILED)
     {
+        fprintf(stderr, "mm_check: out of memory for the shadow bitmaps\n");
+        abort();
     }
+    return p;
+}
 
-    /*Do the pointers in the free list point to valid free blocks?*/
-    if (useExplicitFreeList)
+/*
+ * shadow_grow - Make the bitmaps cover the whole heap, doubling them
+ *     when it outgrows them
+ */
+static void shadow_grow(void)
+{
+    size_t need = mem_heapsize() / DSIZE / 8 + 1, bytes = MAX(2 * map_bytes, 4096);
+    unsigned char *s, *f;
+
+    if (need <= map_bytes)
+        return;
+    while (bytes < need)
+        bytes *= 2;
+    s = map_alloc(bytes);
+    f = map_alloc(bytes);
+    if (map_bytes > 0)
     {
+        memcpy(s, start_map, map_bytes);
+        memcpy(f, free_map, map_bytes);
+        munmap(start_map, map_bytes);
+        munmap(free_map, map_bytes);
     }
+    start_map = s;
+    free_map = f;
+    map_bytes = bytes;
+}
+
+/* Number of set bits in the first bytes of map */
+static size_t count_bits(unsigned char *map, size_t bytes)
+{
+    size_t i, n = 0;
+
+    for (i = 0; i < bytes && i < map_bytes; i++)
+        n += __builtin_popcount(map[i]);
+    return n;
+}
+
+/* check_init - Reset the checker for a new heap */
+static void check_init(void)
+{
+    char *env = getenv("MM_CHECK_INTERVAL");
 
-    /*Do any allocated blocks overlap?*/
-    printf("Do any allocated blocks overlap?\n\n");
-    for (bp = heap_listp; GET_SIZE(HDRP(NEXT_BLKP(bp))) > 0; bp = NEXT_BLKP(bp))
+    if (map_bytes > 0)
     {
-        if (verbose)
-        {
-            printf("Block address: %p ; Block size: %d ; Next block: %p\n",
-                   bp, GET_SIZE(HDRP(bp)), NEXT_BLKP(bp));
-        }
-        if (bp + GET_SIZE(HDRP(bp)) != NEXT_BLKP(bp))
-        {
-            printf("Overlap found\n");
-            status = 0;
-        }
+        memset(start_map, 0, map_bytes);
+        memset(free_map, 0, map_bytes);
     }
-    printf("\n==========\n\n");
+    check_ops = 0;
+    if (env != NULL)
+        check_every = strtoul(env, NULL, 10);
+}
+
+/* check_tick - Count an allocator call, sweep if one is due */
+static void check_tick(void)
+{
+    if (++check_ops, check_every > 0 && check_ops % check_every == 0)
+        mm_check();
+}
+
+void mm_check_interval(unsigned long calls)
+{
+    check_every = calls;
+}
+#endif /* MM_CHECK */
+
+/*
+ * mm_check - Check every block, that no two free blocks are next to
+ *     each other, the prologue and the epilogue, and with MM_CHECK that
+ *     the shadow holds exactly the blocks of the heap
+ */
+int mm_check(void)
+{
+    char *bp, *hi = mem_heap_hi();
+    int errors = 0, prev_free = 0;
+    size_t nblocks = 0, nfree = 0;
 
-    /*Do the pointers in a heap block point to valid heap addresses?*/
+    if (GET(HDRP(heap_listp)) != PACK(DSIZE, 1) || GET(FTRP(heap_listp)) != PACK(DSIZE, 1))
+        errors += report(MM_ERR_LAYOUT, "mm_check", heap_listp);
 
-    return status;
+    for (bp = NEXT_BLKP(heap_listp); GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp))
+    {
+        /* A bad block's size can't be trusted to find the next one */
+        if (check_block(bp, "mm_check"))
+            return errors + 1;
+        if (!GET_ALLOC(HDRP(bp)) && prev_free)
+            errors += report(MM_ERR_COALESCE, "mm_check", bp);
+        prev_free = !GET_ALLOC(HDRP(bp));
+        nblocks++;
+        nfree += prev_free;
+    }
+    if (HDRP(bp) != hi + 1 - WSIZE || GET(HDRP(bp)) != PACK(0, 1))
+        errors += report(MM_ERR_LAYOUT, "mm_check", bp);
+
+#ifdef MM_CHECK
+    if (count_bits(start_map, mem_heapsize() / DSIZE / 8 + 1) != nblocks ||
+        count_bits(free_map, mem_heapsize() / DSIZE / 8 + 1) != nfree)
+        errors += report(MM_ERR_SHADOW, "mm_check", NULL);
+#endif
+    return errors;
 }
 
 static void *coalesce(void *bp)
 {
-    size_t prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(bp)));
-    size_t next_alloc = GET_ALLOC(HDRP(PREV_BLKP(bp)));
-    size_t size = GET_SIZE(HDRP(bp));
+    size_t prev_alloc, next_alloc, size;
+
+    /* Leave bp alone rather than merge it with a corrupted block */
+    CHECK(if (check_neighbours(bp)) return bp);
+
+    prev_alloc = GET_ALLOC(FTRP(PREV_BLKP(bp)));
+    next_alloc = GET_ALLOC(HDRP(NEXT_BLKP(bp)));
+    size = GET_SIZE(HDRP(bp));
 
     if (prev_alloc && next_alloc)
-        return bp; /* Case 1 */
+    { /* Case 1 */
+        STAT(stats->coalesce[0]++);
+        return bp;
+    }
 
     else if (prev_alloc && !next_alloc)
     { /* Case 2 */
+        STAT(stats->coalesce[1]++);
+        CHECK(shadow_unmark(NEXT_BLKP(bp)));
         size += GET_SIZE(HDRP(NEXT_BLKP(bp)));
         PUT(HDRP(bp), PACK(size, 0));
         PUT(FTRP(bp), PACK(size, 0));
@@ -153,6 +484,8 @@ static void *coalesce(void *bp)
 
     else if (!prev_alloc && next_alloc)
     { /* Case 3 */
+        STAT(stats->coalesce[2]++);
+        CHECK(shadow_unmark(bp));
         size += GET_SIZE(HDRP(PREV_BLKP(bp)));
         PUT(FTRP(bp), PACK(size, 0));
         PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
@@ -161,6 +494,8 @@ static void *coalesce(void *bp)
 
     else
     { /* Case 4 */
+        STAT(stats->coalesce[3]++);
+        CHECK(shadow_unmark(bp); shadow_unmark(NEXT_BLKP(bp)));
         size += GET_SIZE(HDRP(PREV_BLKP(bp))) + GET_SIZE(FTRP(NEXT_BLKP(bp)));
         PUT(HDRP(PREV_BLKP(bp)), PACK(size, 0));
         PUT(FTRP(NEXT_BLKP(bp)), PACK(size, 0));
@@ -180,11 +515,13 @@ static void *extend_heap(size_t words)
     size = (words % 2) ? (words + 1) * WSIZE : words * WSIZE;
     if ((long)(bp = mem_sbrk(size)) == -1)
         return NULL;
+    STAT(stats->extends++; stats->extend_bytes += size);
 
     /* Initialize free block header/footer and the epilogue header */
     PUT(HDRP(bp), PACK(size, 0));         /* Free block header */
     PUT(FTRP(bp), PACK(size, 0));         /* Free block footer */
     PUT(HDRP(NEXT_BLKP(bp)), PACK(0, 1)); /* New epilogue header */
+    CHECK(shadow_grow(); shadow_mark(bp, 1));
 
     /* Coalesce if the previous block was free */
     return coalesce(bp);
@@ -194,17 +531,29 @@ static void *find_fit(size_t asize)
 {
     /* First fit search */
     void *bp;
+#ifdef MM_STATS
+    unsigned long steps = 0;
+#endif
+
     for (bp = heap_listp; GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp))
+    {
+#ifdef MM_STATS
+        steps++;
+#endif
         if (!GET_ALLOC(HDRP(bp)) && (asize <= GET_SIZE(HDRP(bp))))
-            return bp;
+            break;
+    }
+    STAT(stats->searches++; stats->search_steps += steps;
+         stats->search_max = MAX(stats->search_max, steps));
 
-    return NULL; /* No fit */
+    return GET_SIZE(HDRP(bp)) > 0 ? bp : NULL; /* NULL if no fit */
 }
 
 static void place(void *bp, size_t asize)
 {
     size_t csize = GET_SIZE(HDRP(bp));
 
+    CHECK(check_block(bp, "place"); shadow_mark(bp, 0));
     if ((csize - asize) >= (2 * DSIZE))
     {
         PUT(HDRP(bp), PACK(asize, 1));
@@ -212,6 +561,8 @@ static void place(void *bp, size_t asize)
         bp = NEXT_BLKP(bp);
         PUT(HDRP(bp), PACK(csize - asize, 0));
         PUT(FTRP(bp), PACK(csize - asize, 0));
+        STAT(stats->splits++);
+        CHECK(shadow_mark(bp, 1));
     }
     else
     {
@@ -220,10 +571,10 @@ static void place(void *bp, size_t asize)
     }
 }
 
-/* 
- * mm_init - initialize the malloc package.
+/*
+ * heap_init - Lay out an empty heap in the current memlib region
  */
-int mm_init(void)
+static int heap_init(void)
 {
     /* Create the initial empty heap */
     if ((heap_listp = mem_sbrk(4 * WSIZE)) == (void *)-1)
@@ -242,10 +593,22 @@ int mm_init(void)
 }
 
 /* 
- * mm_malloc - Allocate a block by incrementing the brk pointer.
- *     Always allocate a block whose size is a multiple of the alignment.
+ * mm_init - initialize the malloc package.
  */
-void *mm_malloc(size_t size)
+int mm_init(void)
+{
+#ifdef MM_STATS
+    memset(stats_slots, 0, sizeof(stats_slots));
+#endif
+    CHECK(check_init());
+    return heap_init();
+}
+
+
+/*
+ * heap_malloc - Allocate a block from the heap
+ */
+static void *heap_malloc(size_t size)
 {
     /*
     int newsize = ALIGN(size + SIZE_T_SIZE);
@@ -262,8 +625,11 @@ void *mm_malloc(size_t size)
     size_t extendsize; /* Amount to extend heap if no hit */
     char *bp;
 
-    /* Ignore spurious requests */
-    if (size == 0)
+    STAT(stats->mallocs++; stats->bytes_requested += size);
+    CHECK(check_tick());
+
+    /* Ignore spurious requests, and those too big for a block */
+    if (size == 0 || size > MAXBLOCK - DSIZE)
         return NULL;
 
     /* Adjust block size to include overhead and alignment reqs */
@@ -276,6 +642,9 @@ void *mm_malloc(size_t size)
     if ((bp = find_fit(asize)) != NULL)
     {
         place(bp, asize);
+        STAT(stats->bytes_allocated += GET_SIZE(HDRP(bp));
+             stats->live[stats_class(GET_SIZE(HDRP(bp)))]++);
+        HEAPPROF_ALLOC(bp, size);
         return bp;
     }
 
@@ -285,18 +654,45 @@ void *mm_malloc(size_t size)
         return NULL;
 
     place(bp, asize);
+    STAT(stats->bytes_allocated += GET_SIZE(HDRP(bp));
+         stats->live[stats_class(GET_SIZE(HDRP(bp)))]++);
+    HEAPPROF_ALLOC(bp, size);
 
     return bp;
 }
 
+/* 
+ * mm_malloc - Allocate a block by incrementing the brk pointer.
+ *     Always allocate a block whose size is a multiple of the alignment.
+ *     With MM_GUARD, about one call in the sampling rate is served from
+ *     the guarded pool instead (guardpool.h).
+ */
+void *mm_malloc(size_t size)
+{
+    GUARD_MALLOC(size, ALIGNMENT);
+    return heap_malloc(size);
+}
+
 /*
  * mm_free - Freeing a block does nothing.
  */
 void mm_free(void *ptr)
 {
-    size_t size = GET_SIZE(HDRP(ptr));
+    size_t size;
+
+    if (GUARD_OWNS(ptr))
+    {
+        guard_free(ptr);
+        return;
+    }
+    CHECK(check_tick(); if (check_pointer(ptr, "mm_free")) return);
+    HARDEN(if (check_allocated(ptr, "mm_free") || check_neighbours(ptr)) return);
+    size = GET_SIZE(HDRP(ptr));
+    STAT(stats->frees++; stats->live[stats_class(size)]--);
+    HEAPPROF_FREE(ptr);
     PUT(HDRP(ptr), PACK(size, 0));
     PUT(FTRP(ptr), PACK(size, 0));
+    CHECK(shadow_mark(ptr, 1));
     coalesce(ptr);
 }
 
@@ -309,10 +705,26 @@ void *mm_realloc(void *ptr, size_t size)
     void *newptr;
     size_t copySize;
 
+    STAT(stats->reallocs++);
+    if (ptr == NULL)
+        return mm_malloc(size);
+    if (GUARD_OWNS(ptr))
+        copySize = guard_usable_size(ptr);
+    else
+    {
+        CHECK(if (check_pointer(ptr, "mm_realloc")) return NULL);
+        HARDEN(if (check_allocated(ptr, "mm_realloc")) return NULL);
+        copySize = GET_SIZE(HDRP(oldptr)) - DSIZE;
+    }
+    if (size == 0)
+    {
+        mm_free(ptr);
+        return NULL;
+    }
+
     newptr = mm_malloc(size);
     if (newptr == NULL)
         return NULL;
-    copySize = *(size_t *)((char *)oldptr - SIZE_T_SIZE);
     if (size < copySize)
         copySize = size;
     memcpy(newptr, oldptr, copySize);
@@ -320,17 +732,476 @@ void *mm_realloc(void *ptr, size_t size)
     return newptr;
 }
 
+/*
+ * mm_memalign - Allocate a block whose payload is aligned to alignment,
+ *     a power of two. The block is allocated with enough slack to find
+ *     an aligned payload at least one minimum block past the start; the
+ *     front is split off as a free block and the unused tail is given
+ *     back the same way.
+ */
+void *mm_memalign(size_t alignment, size_t size)
+{
+    size_t asize, csize, fsize;
+    char *bp, *abp, *bp0;
+
+    if (alignment <= ALIGNMENT)
+        return mm_malloc(size);
+    if (size == 0 || size > (size_t)-1 - alignment - 2 * DSIZE)
+        return NULL;
+    GUARD_MALLOC(size, alignment);
+
+    if ((bp = heap_malloc(size + alignment + 2 * DSIZE)) == NULL)
+        return NULL;
+    STAT(stats->live[stats_class(GET_SIZE(HDRP(bp)))]--);
+    abp = bp0 = bp;
+    if ((size_t)bp % alignment != 0)
+        abp = (char *)(((size_t)bp + 2 * DSIZE + alignment - 1) & ~(alignment - 1));
+
+    /* Split off the front */
+    if (abp != bp)
+    {
+        csize = GET_SIZE(HDRP(bp));
+        fsize = abp - bp;
+        PUT(HDRP(abp), PACK(csize - fsize, 1));
+        PUT(FTRP(abp), PACK(csize - fsize, 1));
+        PUT(HDRP(bp), PACK(fsize, 0));
+        PUT(FTRP(bp), PACK(fsize, 0));
+        CHECK(shadow_mark(abp, 0); shadow_mark(bp, 1));
+        coalesce(bp);
+    }
+
+    /* Give back the tail */
+    asize = (size <= DSIZE) ? 2 * DSIZE : DSIZE * ((size + (DSIZE) + (DSIZE - 1)) / DSIZE);
+    csize = GET_SIZE(HDRP(abp));
+    if ((csize - asize) >= (2 * DSIZE))
+    {
+        PUT(HDRP(abp), PACK(asize, 1));
+        PUT(FTRP(abp), PACK(asize, 1));
+        bp = NEXT_BLKP(abp);
+        PUT(HDRP(bp), PACK(csize - asize, 0));
+        PUT(FTRP(bp), PACK(csize - asize, 0));
+        CHECK(shadow_mark(bp, 1));
+        coalesce(bp);
+    }
+    STAT(stats->live[stats_class(GET_SIZE(HDRP(abp)))]++);
+    HEAPPROF_MOVE(bp0, abp, size);
+
+    return abp;
+}
+
+/*
+ * mm_usable_size - Return the number of payload bytes of an allocated
+ *     block, which may be more than were asked for
+ */
+size_t mm_usable_size(void *ptr)
+{
+    if (GUARD_OWNS(ptr))
+        return guard_usable_size(ptr);
+    CHECK(if (check_pointer(ptr, "mm_usable_size")) return 0);
+    HARDEN(if (check_allocated(ptr, "mm_usable_size")) return 0);
+    return GET_SIZE(HDRP(ptr)) - DSIZE;
+}
+
+#ifdef MM_STATS
+/*
+ * mm_stats - Sum the counters of all threads since the last mm_init
+ */
+void mm_stats(mm_stats_t *out)
+{
+    mm_stats_t *s;
+    int i, j, n = __atomic_load_n(&stats_nslots, __ATOMIC_RELAXED);
+
+    memset(out, 0, sizeof(mm_stats_t));
+    for (i = 0; i < n && i < MM_STATS_THREADS; i++)
+    {
+        s = &stats_slots[i];
+        out->mallocs += s->mallocs;
+        out->frees += s->frees;
+        out->reallocs += s->reallocs;
+        out->bytes_requested += s->bytes_requested;
+        out->bytes_allocated += s->bytes_allocated;
+        out->searches += s->searches;
+        out->search_steps += s->search_steps;
+        out->search_max = MAX(out->search_max, s->search_max);
+        for (j = 0; j < 4; j++)
+            out->coalesce[j] += s->coalesce[j];
+        out->splits += s->splits;
+        out->extends += s->extends;
+        out->extend_bytes += s->extend_bytes;
+        for (j = 0; j < MM_NCLASSES; j++)
+            out->live[j] += s->live[j];
+    }
+}
+#endif /* MM_STATS */
+
+/*
+ * mm_heap_walk - Call f on every block between the prologue and the
+ *     epilogue, in address order, with its payload pointer, total block
+ *     size (header and footer included) and allocated bit.
+ */
+void mm_heap_walk(mm_walk_funct f, void *arg)
+{
+    void *bp;
+
+    for (bp = NEXT_BLKP(heap_listp); GET_SIZE(HDRP(bp)) > 0; bp = NEXT_BLKP(bp))
+        f(bp, GET_SIZE(HDRP(bp)), GET_ALLOC(HDRP(bp)), arg);
+}
+
+/*
+ * Heaps of their own. Each lives in a memlib region, with its mm_heap_t
+ * at the bottom, and mm_heap_* swap it with the current heap around the
+ * operation, so that the code above works on it unchanged. Destroying a
+ * heap unmaps its region, whatever is still allocated in it. Blocks of
+ * these heaps are never served from the guarded pool.
+ */
+struct mm_heap
+{
+    mem_region_t *region;
+    char *heap_listp;
+#ifdef MM_CHECK
+    unsigned char *start_map, *free_map;
+    size_t map_bytes;
+#endif
+};
+
+/*
+ * heap_swap - Exchange the current heap with h: called once to make h
+ *     current, and again to put the previous heap back and save h
+ */
+static void heap_swap(mm_heap_t *h)
+{
+    char *listp = heap_listp;
+#ifdef MM_CHECK
+    unsigned char *smap = start_map, *fmap = free_map;
+    size_t bytes = map_bytes;
+
+    start_map = h->start_map;
+    free_map = h->free_map;
+    map_bytes = h->map_bytes;
+    h->start_map = smap;
+    h->free_map = fmap;
+    h->map_bytes = bytes;
+#endif
+    heap_listp = h->heap_listp;
+    h->heap_listp = listp;
+    h->region = mem_region_switch(h->region);
+}
+
+/*
+ * heap_unmap - Give back the memory of a heap and of its shadow maps
+ */
+static void heap_unmap(mm_heap_t *h)
+{
+#ifdef MM_CHECK
+    if (h->map_bytes > 0)
+    {
+        munmap(h->start_map, h->map_bytes);
+        munmap(h->free_map, h->map_bytes);
+    }
+#endif
+    mem_region_destroy(h->region);
+}
+
+/*
+ * mm_heap_create - Create an empty heap that can grow to size bytes
+ */
+mm_heap_t *mm_heap_create(size_t size)
+{
+    mm_heap_t tmp, *h;
+
+    memset(&tmp, 0, sizeof(tmp));
+    if ((tmp.region = mem_region_create(size)) == NULL)
+        return NULL;
+    heap_swap(&tmp);
+    if ((h = mem_sbrk(DSIZE * ((sizeof(mm_heap_t) + DSIZE - 1) / DSIZE))) == (void *)-1 ||
+        heap_init() < 0)
+        h = NULL;
+    heap_swap(&tmp);
+    if (h == NULL)
+    {
+        /* No blocks to forget, and maybe no heap to walk: just unmap it */
+        heap_unmap(&tmp);
+        return NULL;
+    }
+    *h = tmp;
+    return h;
+}
+
+#if defined(MM_STATS) || defined(MM_HEAPPROF)
+/*
+ * heap_drop_block - Forget an allocated block of a heap being destroyed,
+ *     as mm_free would have
+ */
+static void heap_drop_block(void *bp, size_t size, int alloc, void *arg)
+{
+    if (!alloc)
+        return;
+    STAT(stats->live[stats_class(size)]--);
+    HEAPPROF_FREE(bp);
+}
+#endif
+
+/*
+ * mm_heap_destroy - Free a heap and every block in it at once
+ */
+void mm_heap_destroy(mm_heap_t *h)
+{
+#if defined(MM_STATS) || defined(MM_HEAPPROF)
+    /* The live counts and profile samples of its blocks go with it */
+    heap_swap(h);
+    mm_heap_walk(heap_drop_block, NULL);
+    heap_swap(h);
+#endif
+    heap_unmap(h);
+}
+
+void *mm_heap_malloc(mm_heap_t *h, size_t size)
+{
+    void *bp;
+
+    heap_swap(h);
+    bp = heap_malloc(size);
+    heap_swap(h);
+    return bp;
+}
+
+void mm_heap_free(mm_heap_t *h, void *ptr)
+{
+    heap_swap(h);
+    mm_free(ptr);
+    heap_swap(h);
+}
+
+/*
+ * mm_heap_realloc - Like mm_realloc, within heap h
+ */
+void *mm_heap_realloc(mm_heap_t *h, void *ptr, size_t size)
+{
+    void *newptr;
+    size_t copySize;
+
+    if (ptr == NULL)
+        return mm_heap_malloc(h, size);
+    if (size == 0)
+    {
+        mm_heap_free(h, ptr);
+        return NULL;
+    }
+
+    heap_swap(h);
+    copySize = mm_usable_size(ptr);
+    newptr = heap_malloc(size);
+    if (newptr != NULL)
+    {
+        memcpy(newptr, ptr, size < copySize ? size : copySize);
+        mm_free(ptr);
+    }
+    heap_swap(h);
+    return newptr;
+}
+
+#ifdef MM_SELFTEST
+static int selftest_errors = 0;   /* reports received */
+static int selftest_failures = 0; /* checks that did not go as expected */
+static char selftest_seen[256];   /* reports since the last selftest_expect */
+
+/* Print a report, count it, and keep it for selftest_expect */
+static void selftest_report(const mm_report_t *r)
+{
+    size_t n = strlen(selftest_seen);
+
+    printf("  report: %s in %s, block %p\n", mm_err_name(r->err), r->where, r->bp);
+    snprintf(selftest_seen + n, sizeof(selftest_seen) - n, "%s%s in %s",
+             n > 0 ? "; " : "", mm_err_name(r->err), r->where);
+    selftest_errors++;
+}
+
+/*
+ * selftest_expect - The reports since the last call must be exactly
+ *     expect, e.g. "double-free in mm_free", or none if it is ""
+ */
+static void selftest_expect(const char *expect)
+{
+    if (strcmp(selftest_seen, expect) != 0)
+    {
+        printf("  FAILED: expected \"%s\", got \"%s\"\n", expect, selftest_seen);
+        selftest_failures++;
+    }
+    selftest_seen[0] = '\0';
+}
+
+/* Print every block of the heap */
+static void selftest_block(void *bp, size_t size, int alloc, void *arg)
+{
+    printf("  block %p size %zu %s\n", bp, size, alloc ? "allocated" : "free");
+}
+
+static void selftest_check(void)
+{
+    mm_heap_walk(selftest_block, NULL);
+    printf("mm_check: %d errors\n\n", mm_check());
+}
+
+/* Check the heap, which must be sound */
+static void selftest_sound(void)
+{
+    selftest_check();
+    selftest_expect("");
+}
+
+/*
+ * selftest_heaps - Blocks of a heap of its own keep their contents
+ *     through realloc, leave the default heap alone, and are all
+ *     forgotten when the heap is destroyed
+ */
+static void selftest_heaps(void)
+{
+    mm_heap_t *h;
+    char *p[100], *q;
+    int i, bad = 0;
+#ifdef MM_STATS
+    mm_stats_t before, after;
+
+    mm_stats(&before);
+#endif
+
+    printf("Heap of its own\n");
+    if ((h = mm_heap_create(1 << 20)) == NULL)
+    {
+        printf("  FAILED: mm_heap_create\n");
+        selftest_failures++;
+        return;
+    }
+    q = mm_malloc(DSIZE);
+    for (i = 0; i < 100; i++)
+    {
+        p[i] = mm_heap_malloc(h, 40);
+        memset(p[i], i, 40);
+    }
+    for (i = 0; i < 100; i += 2)
+        mm_heap_free(h, p[i]);
+    for (i = 1; i < 100; i += 2)
+    {
+        p[i] = mm_heap_realloc(h, p[i], 200);
+        bad += (p[i] == NULL || p[i][0] != i || p[i][39] != i);
+    }
+    bad += (mm_heap_realloc(h, p[1], 0) != NULL);
+    p[1] = mm_heap_realloc(h, NULL, 10);
+    bad += (p[1] == NULL || ((char *)p[1] >= (char *)mem_heap_lo() &&
+                             (char *)p[1] <= (char *)mem_heap_hi()));
+    bad += (mm_heap_malloc(h, (size_t)-5) != NULL || mm_malloc((size_t)-5) != NULL);
+    bad += (mm_heap_create(DSIZE) != NULL);
+    printf("  %d bad blocks\n", bad);
+    selftest_failures += bad;
+    heap_swap(h);
+    printf("  mm_check of the heap: %d errors\n", mm_check());
+    heap_swap(h);
+    selftest_expect("");
+    mm_heap_destroy(h);
+    mm_free(q);
+    selftest_sound();
+
+#ifdef MM_STATS
+    mm_stats(&after);
+    for (i = 0; i < MM_NCLASSES; i++)
+        if (after.live[i] != before.live[i])
+        {
+            printf("  FAILED: %ld live blocks of class %d left\n",
+                   after.live[i] - before.live[i], i);
+            selftest_failures++;
+        }
+#endif
+}
+
+#ifdef MM_GUARD
+/* The guarded pool's cases, each run in a child of its own */
+static void guard_overflow(void)
+{
+    char *p = mm_malloc(4 * DSIZE);
+
+    p[4 * DSIZE] = 1;
+}
+
+static void guard_use_after_free(void)
+{
+    char *p = mm_malloc(4 * DSIZE);
+
+    mm_free(p);
+    p[0] = 1;
+}
+
+static void guard_double_free(void)
+{
+    char *p = mm_malloc(4 * DSIZE);
+
+    mm_free(p);
+    mm_free(p);
+}
+
+/*
+ * selftest_guard - Run f in a child with stderr on a pipe. The pool
+ *     must diagnose what f does with expect, and the child must die of
+ *     the fault if fault is set, or exit normally otherwise.
+ */
+static void selftest_guard(const char *name, void (*f)(void), const char *expect,
+                           int fault)
+{
+    char out[8192];
+    int fds[2], status;
+    ssize_t n, len = 0;
+    pid_t pid;
+
+    printf("%s\n", name);
+    fflush(stdout);
+    if (pipe(fds) < 0 || (pid = fork()) < 0)
+    {
+        printf("  FAILED: could not start the child\n");
+        selftest_failures++;
+        return;
+    }
+    if (pid == 0)
+    {
+        close(fds[0]);
+        dup2(fds[1], STDERR_FILENO);
+        f();
+        _exit(0);
+    }
+    close(fds[1]);
+    while (len < (ssize_t)sizeof(out) - 1 &&
+           (n = read(fds[0], out + len, sizeof(out) - 1 - len)) > 0)
+        len += n;
+    out[len] = '\0';
+    close(fds[0]);
+    waitpid(pid, &status, 0);
+
+    if (strstr(out, expect) == NULL ||
+        (fault ? !WIFSIGNALED(status) || WTERMSIG(status) != SIGSEGV
+               : !WIFEXITED(status) || WEXITSTATUS(status) != 0))
+    {
+        printf("  FAILED: expected \"%s\"%s\n", expect, fault ? " and a fault" : "");
+        selftest_failures++;
+    }
+    else
+        printf("  guardpool: %s\n", expect);
+}
+#endif
+
 /*
 * basic tests for the checker
 */
 int main()
 {
+#ifdef MM_GUARD
+    mem_init_reserve(1 << 30); /* the guarded pool takes the top of it */
+#else
     mem_init();
+#endif
+    mm_set_report(selftest_report);
 
     printf("Init mm\n");
     mm_init();
 
-    mm_check(0, 1);
+    selftest_sound();
 
     printf("Add a\n");
 
@@ -338,7 +1209,7 @@ int main()
     printf("Add b\n");
     void *b = mm_malloc(DSIZE);
 
-    mm_check(0, 1);
+    selftest_sound();
 
     printf("Add c\n");
     void *c = mm_malloc(DSIZE);
@@ -346,7 +1217,7 @@ int main()
     printf("Free b\n");
     mm_free(b);
 
-    mm_check(0, 1);
+    selftest_sound();
 
     printf("Add d\n");
     void *d = mm_malloc(DSIZE);
@@ -354,7 +1225,7 @@ int main()
     printf("Free c\n");
     mm_free(c);
 
-    mm_check(0, 1);
+    selftest_sound();
 
     printf("Free a\n");
     mm_free(a);
@@ -362,7 +1233,56 @@ int main()
     printf("Free d\n");
     mm_free(d);
 
-    mm_check(0, 1);
+    selftest_sound();
+
+    selftest_heaps();
+
+#if defined(MM_CHECK) || defined(MM_HARDEN)
+    /* Errors the checkers must catch as they happen */
+    printf("Free b twice\n");
+    a = mm_malloc(DSIZE);
+    b = mm_malloc(DSIZE);
+    c = mm_malloc(DSIZE);
+    mm_free(b);
+    mm_free(b);
+    mm_free(a);
+    mm_free(c);
+    selftest_expect("double-free in mm_free");
+    printf("Free a pointer into a block\n");
+    a = mm_malloc(4 * DSIZE);
+    mm_free((char *)a + DSIZE);
+    mm_free(a);
+    selftest_expect("bad-pointer in mm_free");
+    printf("Overwrite a footer\n");
+    a = mm_malloc(4 * DSIZE);
+    b = mm_malloc(4 * DSIZE);
+    memset(a, 0xff, 4 * DSIZE + WSIZE);
+    mm_free(b);
+    selftest_expect("bad-pointer in coalesce");
+
+    selftest_check();
+    selftest_expect("bad-header in mm_check");
+#endif
+
+#ifdef MM_GUARD
+    /* Every allocation from here on is served from the pool */
+    if (guard_start(1, 4) < 0)
+    {
+        printf("  FAILED: guard_start\n");
+        selftest_failures++;
+    }
+    else
+    {
+        selftest_guard("Overflow a guarded block", guard_overflow,
+                       "buffer overflow", 1);
+        selftest_guard("Use a guarded block after free", guard_use_after_free,
+                       "use after free", 1);
+        selftest_guard("Free a guarded block twice", guard_double_free,
+                       "double free", 0);
+    }
+#endif
 
-    exit(0);
+    printf("%d errors reported, %d checks failed\n", selftest_errors, selftest_failures);
+    exit(selftest_failures > 0);
 }
+#endif /* MM_SELFTEST */
@@ -4,6 +4,86 @@ extern int mm_init (void);
 extern void *mm_malloc (size_t size);
 extern void mm_free (void *ptr);
 extern void *mm_realloc(void *ptr, size_t size);
+extern void *mm_memalign(size_t alignment, size_t size);
+extern size_t mm_usable_size(void *ptr);
+
+/* Heaps of their own, each in its own memory, freed all at once. The
+   mm_heap_* calls swap the heap in for the file-static state of mm.c
+   that mm_malloc and mm_free work on, so they are not reentrant and
+   need the same serialization as calls on the default heap. */
+typedef struct mm_heap mm_heap_t;
+
+extern mm_heap_t *mm_heap_create(size_t size);
+extern void mm_heap_destroy(mm_heap_t *heap);
+extern void *mm_heap_malloc(mm_heap_t *heap, size_t size);
+extern void mm_heap_free(mm_heap_t *heap, void *ptr);
+extern void *mm_heap_realloc(mm_heap_t *heap, void *ptr, size_t size);
+
+#ifdef MM_STATS
+/* Number of size classes of mm_stats_t.live: class i holds the blocks
+   of 2^(i+4) up to 2^(i+5)-1 bytes, the last one everything larger */
+#define MM_NCLASSES 16
+
+/* Counters of the malloc package since the last mm_init */
+typedef struct {
+    unsigned long mallocs;         /* mm_malloc calls, also from realloc */
+    unsigned long frees;           /* mm_free calls, also from realloc */
+    unsigned long reallocs;        /* mm_realloc calls */
+    unsigned long bytes_requested; /* payload bytes asked for */
+    unsigned long bytes_allocated; /* block bytes handed out */
+    unsigned long searches;        /* free list searches */
+    unsigned long search_steps;    /* blocks visited by all searches */
+    unsigned long search_max;      /* blocks visited by the longest one */
+    unsigned long coalesce[4];     /* coalesce cases 1 to 4 */
+    unsigned long splits;          /* blocks split by place */
+    unsigned long extends;         /* heap extensions */
+    unsigned long extend_bytes;    /* bytes added by them */
+    long live[MM_NCLASSES];        /* live blocks per size class */
+} mm_stats_t;
+
+/* Sum the counters of all threads into stats */
+extern void mm_stats(mm_stats_t *stats);
+#endif /* MM_STATS */
+
+/* Heap errors, found by mm_check and, with MM_CHECK, on every call */
+typedef enum {
+    MM_ERR_POINTER,    /* pointer that is not a block of the heap */
+    MM_ERR_DOUBLE_FREE,/* block freed, or used, while it is free */
+    MM_ERR_HEADER,     /* bad size, or header and footer differ */
+    MM_ERR_LAYOUT,     /* bad prologue or epilogue */
+    MM_ERR_COALESCE,   /* two free blocks next to each other */
+    MM_ERR_SHADOW      /* heap and checker metadata disagree */
+} mm_err_t;
+
+/* One error, as passed to the report function */
+typedef struct {
+    mm_err_t err;
+    const char *where;     /* function that found it */
+    void *bp;              /* block concerned, or NULL */
+    unsigned int header;   /* its header and footer words, 0 if they */
+    unsigned int footer;   /*   are not in the heap */
+    unsigned long op;      /* allocator calls since mm_init (MM_CHECK) */
+} mm_report_t;
+
+typedef void (*mm_report_funct)(const mm_report_t *report);
+
+/* Check the whole heap, return the number of errors reported */
+extern int mm_check(void);
+
+/* Send reports to f instead of stderr, or back to stderr if f is NULL */
+extern void mm_set_report(mm_report_funct f);
+
+/* Short name of an error, e.g. "double-free" */
+extern const char *mm_err_name(mm_err_t err);
+
+#ifdef MM_CHECK
+/* Also run mm_check every calls allocator calls, never if 0 */
+extern void mm_check_interval(unsigned long calls);
+#endif
+
+/* Visit every block in the heap in address order */
+typedef void (*mm_walk_funct)(void *bp, size_t size, int alloc, void *arg);
+extern void mm_heap_walk(mm_walk_funct f, void *arg);
 
 
 /* 
@@ -0,0 +1,335 @@
+/*
+ * mm.hpp - C++ allocators on top of the mm package
+ *
+ * mm::Allocator<T> is a standard allocator that allocates with
+ * mm_malloc (mm_memalign for types aligned to more than 8 bytes) and
+ * frees with mm_free, for containers like
+ * std::vector<int, mm::Allocator<int> >.
+ *
+ * The std::pmr::memory_resource classes let the pmr containers, and
+ * everything else that takes a polymorphic_allocator, allocate from:
+ *
+ *   mm::resource()     the heap of mm_init, through mm_malloc and mm_free
+ *   mm::HeapResource   a heap of its own (mm_heap_create), freed all at
+ *                      once when the resource is released or destroyed
+ *   mm::ArenaResource  an arena (arena.h): deallocate does nothing, and
+ *                      release() empties the arena
+ *
+ * For sizes known at compile time, mm::alloc<N>() and mm::dealloc<N>()
+ * are an inline fast path through size-class bins (see below).
+ *
+ * Like the rest of the mm package, none of them is thread safe, and
+ * what they allocated from the heap of mm_init doesn't survive mm_init.
+ * To send the global operator new and delete to mm.c, link in mmnew.o.
+ */
+#ifndef __MM_HPP_
+#define __MM_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <memory_resource>
+
+extern "C" {
+#include "mm.h"
+#include "arena.h"
+}
+
+namespace mm {
+
+/* Alignment of mm_malloc and mm_heap_malloc */
+constexpr std::size_t ALIGN = 8;
+
+/* Largest size or alignment, so that blocks fit in mm.c's 32-bit headers
+   and the padded sizes below cannot wrap */
+constexpr std::size_t MAXSIZE = std::size_t(1) << 30;
+
+/* Allocate bytes aligned to align from the heap of mm_init, or throw */
+inline void *allocate(std::size_t bytes, std::size_t align = ALIGN)
+{
+    void *p;
+
+    if (bytes > MAXSIZE || align > MAXSIZE)
+	throw std::bad_alloc();
+    if (bytes == 0)
+	bytes = 1;
+    p = (align <= ALIGN) ? mm_malloc(bytes) : mm_memalign(align, bytes);
+    if (p == nullptr)
+	throw std::bad_alloc();
+    return p;
+}
+
+template <class T>
+class Allocator {
+public:
+    using value_type = T;
+
+    Allocator() noexcept = default;
+    template <class U>
+    Allocator(const Allocator<U> &) noexcept {}
+
+    T *allocate(std::size_t n)
+    {
+	if (n > SIZE_MAX / sizeof(T))
+	    throw std::bad_array_new_length();
+	return static_cast<T *>(mm::allocate(n * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T *p, std::size_t) noexcept { mm_free(p); }
+};
+
+/* All of them allocate from the same heap */
+template <class T, class U>
+bool operator==(const Allocator<T> &, const Allocator<U> &) noexcept
+{
+    return true;
+}
+
+template <class T, class U>
+bool operator!=(const Allocator<T> &, const Allocator<U> &) noexcept
+{
+    return false;
+}
+
+/* The heap of mm_init as a memory resource */
+class Resource : public std::pmr::memory_resource {
+protected:
+    void *do_allocate(std::size_t bytes, std::size_t align) override
+    {
+	return mm::allocate(bytes, align);
+    }
+
+    void do_deallocate(void *p, std::size_t, std::size_t) override
+    {
+	mm_free(p);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+	return dynamic_cast<const Resource *>(&other) != nullptr;
+    }
+};
+
+inline Resource *resource() noexcept
+{
+    static Resource r;
+
+    return &r;
+}
+
+/* A heap of its own as a memory resource */
+class HeapResource : public std::pmr::memory_resource {
+public:
+    /* A heap that can grow to size bytes */
+    explicit HeapResource(std::size_t size) : size_(size), heap_(mm_heap_create(size))
+    {
+	if (heap_ == nullptr)
+	    throw std::bad_alloc();
+    }
+
+    ~HeapResource()
+    {
+	if (heap_ != nullptr)
+	    mm_heap_destroy(heap_);
+    }
+
+    HeapResource(const HeapResource &) = delete;
+    HeapResource &operator=(const HeapResource &) = delete;
+
+    /* Free everything at once. If the heap cannot be made again, throw,
+       and every later allocation throws too. */
+    void release()
+    {
+	if (heap_ != nullptr)
+	    mm_heap_destroy(heap_);
+	if ((heap_ = mm_heap_create(size_)) == nullptr)
+	    throw std::bad_alloc();
+    }
+
+protected:
+    /* Heaps have no memalign, so larger alignments take an aligned
+       block out of a bigger one and keep its address just below */
+    void *do_allocate(std::size_t bytes, std::size_t align) override
+    {
+	char *p, *q;
+
+	if (heap_ == nullptr || bytes > MAXSIZE || align > MAXSIZE)
+	    throw std::bad_alloc();
+	if (bytes == 0)
+	    bytes = 1;
+	if (align <= ALIGN) {
+	    if ((p = static_cast<char *>(mm_heap_malloc(heap_, bytes))) == nullptr)
+		throw std::bad_alloc();
+	    return p;
+	}
+	if ((p = static_cast<char *>(mm_heap_malloc(heap_, bytes + align))) == nullptr)
+	    throw std::bad_alloc();
+	q = p + align - reinterpret_cast<std::uintptr_t>(p) % align;
+	reinterpret_cast<char **>(q)[-1] = p;
+	return q;
+    }
+
+    void do_deallocate(void *p, std::size_t, std::size_t align) override
+    {
+	if (heap_ == nullptr)
+	    return; /* went with the heap */
+	if (align > ALIGN)
+	    p = static_cast<char **>(p)[-1];
+	mm_heap_free(heap_, p);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+	return this == &other;
+    }
+
+private:
+    std::size_t size_;
+    mm_heap_t *heap_;
+};
+
+/* An arena as a memory resource */
+class ArenaResource : public std::pmr::memory_resource {
+public:
+    /* An arena that can grow to size bytes */
+    explicit ArenaResource(std::size_t size) : arena_(mm_arena_create(size))
+    {
+	if (arena_ == nullptr)
+	    throw std::bad_alloc();
+    }
+
+    ~ArenaResource() { mm_arena_destroy(arena_); }
+
+    ArenaResource(const ArenaResource &) = delete;
+    ArenaResource &operator=(const ArenaResource &) = delete;
+
+    /* Free everything at once, keeping the chunks */
+    void release() noexcept { mm_arena_reset(arena_); }
+
+    mm_arena_t *arena() const noexcept { return arena_; }
+
+protected:
+    void *do_allocate(std::size_t bytes, std::size_t align) override
+    {
+	char *p;
+
+	if (bytes > MAXSIZE || align > MAXSIZE)
+	    throw std::bad_alloc();
+	if (align <= ARENA_ALIGN) {
+	    if ((p = static_cast<char *>(mm_arena_alloc(arena_, bytes))) == nullptr)
+		throw std::bad_alloc();
+	    return p;
+	}
+	if ((p = static_cast<char *>(mm_arena_alloc(arena_, bytes + align - ARENA_ALIGN))) == nullptr)
+	    throw std::bad_alloc();
+	return p + (align - reinterpret_cast<std::uintptr_t>(p) % align) % align;
+    }
+
+    void do_deallocate(void *, std::size_t, std::size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override
+    {
+	return this == &other;
+    }
+
+private:
+    mm_arena_t *arena_;
+};
+
+/*
+ * Size-class bins for sizes known at compile time: alloc<N>() rounds N
+ * up to one of size_classes when it is compiled and pops a block off
+ * that class's bin, calling mm_malloc only when the bin is empty, and
+ * dealloc<N>() pushes the block back, calling mm_free once the bin holds
+ * BIN_BYTES. Sizes above the largest class go straight to mm_malloc and
+ * mm_free. The blocks are ordinary blocks of the heap, linked through
+ * their first word while in a bin, so mm_free can free them too. Call
+ * bin_flush() before mm_init, which would leave the bins pointing into
+ * the old heap.
+ */
+constexpr std::size_t size_classes[] = {
+    8, 16, 24, 32, 48, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320, 384, 448, 512
+};
+constexpr std::size_t NCLASSES = sizeof(size_classes) / sizeof(size_classes[0]);
+constexpr std::size_t BIN_BYTES = 64 << 10;   /* bytes a bin holds at most */
+
+/* Index of the smallest class of at least n bytes, NCLASSES if none */
+constexpr std::size_t size_class(std::size_t n)
+{
+    std::size_t c = 0;
+
+    while (c < NCLASSES && size_classes[c] < n)
+	c++;
+    return c;
+}
+
+struct Bin {
+    void *free;                  /* blocks, linked through their first word */
+    std::size_t count;
+};
+
+inline Bin bins[NCLASSES];
+
+/* Allocate N bytes, or return NULL if the heap is full */
+template <std::size_t N>
+inline void *alloc()
+{
+    constexpr std::size_t c = size_class(N);
+
+    if constexpr (c == NCLASSES) {
+	return mm_malloc(N);
+    }
+    else {
+	Bin &b = bins[c];
+	void *p = b.free;
+
+	if (p == nullptr)
+	    return mm_malloc(size_classes[c]);
+	b.free = *static_cast<void **>(p);
+	b.count--;
+	return p;
+    }
+}
+
+/* Free a block of alloc<N> */
+template <std::size_t N>
+inline void dealloc(void *p)
+{
+    constexpr std::size_t c = size_class(N);
+
+    if (p == nullptr)
+	return;
+    if constexpr (c == NCLASSES) {
+	mm_free(p);
+    }
+    else {
+	Bin &b = bins[c];
+
+	if (b.count >= BIN_BYTES / size_classes[c]) {
+	    mm_free(p);
+	    return;
+	}
+	*static_cast<void **>(p) = b.free;
+	b.free = p;
+	b.count++;
+    }
+}
+
+/* Give every block in the bins back to the heap */
+inline void bin_flush()
+{
+    void *p;
+    std::size_t c;
+
+    for (c = 0; c < NCLASSES; c++) {
+	while ((p = bins[c].free) != nullptr) {
+	    bins[c].free = *static_cast<void **>(p);
+	    mm_free(p);
+	}
+	bins[c].count = 0;
+    }
+}
+
+} /* namespace mm */
+
+#endif /* __MM_HPP_ */
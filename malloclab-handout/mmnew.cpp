@@ -0,0 +1,178 @@
+/*
+ * mmnew.cpp - The global operator new and delete on top of mm.c
+ *
+ * Linked into a C++ program (with mm.o and memlib.o), this replaces
+ * every form of the global operator new and delete, so that new
+ * expressions and the default std::allocator of every container use
+ * the mm package while malloc stays the C library's. The heap is
+ * address space reserved by mem_init_reserve() on the first call
+ * (MMNEW_HEAP_MB megabytes from the environment, by default the same
+ * as mmshim.so), so the program must not call mem_init or mm_init
+ * itself. Every call holds one global lock.
+ *
+ * Plain operator new must return memory aligned for any type of up to
+ * __STDCPP_DEFAULT_NEW_ALIGNMENT__ bytes (16 on x86-64) while mm_malloc
+ * only aligns to 8. The size of such a type is a multiple of its
+ * alignment, so only sizes that are multiples of it go through
+ * mm_memalign. The sized forms of delete are given the size of the
+ * object, but mm_free reads it from the block header anyway.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+
+extern "C" {
+#include "mm.h"
+#include "memlib.h"
+}
+
+#define NEW_ALIGN 8                                  /* alignment of mm_malloc */
+#define NEW_MAXSIZE ((std::size_t)1 << 30)           /* largest size or alignment */
+#define NEW_HEAP_MB (sizeof(void *) == 8 ? 32768 : 1024) /* default heap size */
+
+static std::mutex new_lock;
+static bool new_ready;
+
+/*
+ * new_init - Reserve the heap and initialize the mm package on the
+ *     first call. Called with the lock held.
+ */
+static void new_init(void)
+{
+    char *env;
+    std::size_t mb = NEW_HEAP_MB;
+
+    if ((env = getenv("MMNEW_HEAP_MB")) != NULL && atol(env) > 0)
+	mb = atol(env);
+    mem_init_reserve(mb << 20);
+    if (mm_init() < 0) {
+	fprintf(stderr, "mmnew: mm_init failed\n");
+	abort();
+    }
+    new_ready = true;
+}
+
+/*
+ * new_alloc - Allocate size bytes aligned to align, or return NULL.
+ *     Like mmshim.so, it refuses sizes whose blocks would not fit in
+ *     mm.c's 32-bit headers.
+ */
+static void *new_alloc(std::size_t size, std::size_t align) noexcept
+{
+    if (size > NEW_MAXSIZE || align > NEW_MAXSIZE)
+	return NULL;
+    std::lock_guard<std::mutex> guard(new_lock);
+
+    if (!new_ready)
+	new_init();
+    if (size == 0)
+	size = 1; /* new must return a unique pointer */
+    return (align <= NEW_ALIGN) ? mm_malloc(size) : mm_memalign(align, size);
+}
+
+/*
+ * new_throw - Allocate like new_alloc, calling the new handler until
+ *     it succeeds or there is no handler, then throwing bad_alloc
+ */
+static void *new_throw(std::size_t size, std::size_t align)
+{
+    std::new_handler handler;
+    void *p;
+
+    while ((p = new_alloc(size, align)) == NULL) {
+	if ((handler = std::get_new_handler()) == NULL)
+	    throw std::bad_alloc();
+	handler();
+    }
+    return p;
+}
+
+/*
+ * new_nothrow - new_throw for the nothrow forms
+ */
+static void *new_nothrow(std::size_t size, std::size_t align) noexcept
+{
+    try {
+	return new_throw(size, align);
+    }
+    catch (...) {
+	return NULL;
+    }
+}
+
+/*
+ * new_align - Alignment plain new needs for size bytes
+ */
+static inline std::size_t new_align(std::size_t size)
+{
+    return (size % __STDCPP_DEFAULT_NEW_ALIGNMENT__ == 0) ?
+	__STDCPP_DEFAULT_NEW_ALIGNMENT__ : NEW_ALIGN;
+}
+
+/*
+ * new_free - Free a block of new_alloc
+ */
+static void new_free(void *p) noexcept
+{
+    if (p == NULL)
+	return;
+    std::lock_guard<std::mutex> guard(new_lock);
+    mm_free(p);
+}
+
+/*
+ * The replacements
+ */
+void *operator new(std::size_t size)
+{
+    return new_throw(size, new_align(size));
+}
+
+void *operator new[](std::size_t size)
+{
+    return new_throw(size, new_align(size));
+}
+
+void *operator new(std::size_t size, std::align_val_t align)
+{
+    return new_throw(size, static_cast<std::size_t>(align));
+}
+
+void *operator new[](std::size_t size, std::align_val_t align)
+{
+    return new_throw(size, static_cast<std::size_t>(align));
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    return new_nothrow(size, new_align(size));
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return new_nothrow(size, new_align(size));
+}
+
+void *operator new(std::size_t size, std::align_val_t align, const std::nothrow_t &) noexcept
+{
+    return new_nothrow(size, static_cast<std::size_t>(align));
+}
+
+void *operator new[](std::size_t size, std::align_val_t align, const std::nothrow_t &) noexcept
+{
+    return new_nothrow(size, static_cast<std::size_t>(align));
+}
+
+void operator delete(void *p) noexcept { new_free(p); }
+void operator delete[](void *p) noexcept { new_free(p); }
+void operator delete(void *p, std::size_t) noexcept { new_free(p); }
+void operator delete[](void *p, std::size_t) noexcept { new_free(p); }
+void operator delete(void *p, std::align_val_t) noexcept { new_free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept { new_free(p); }
+void operator delete(void *p, std::size_t, std::align_val_t) noexcept { new_free(p); }
+void operator delete[](void *p, std::size_t, std::align_val_t) noexcept { new_free(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { new_free(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { new_free(p); }
+void operator delete(void *p, std::align_val_t, const std::nothrow_t &) noexcept { new_free(p); }
+void operator delete[](void *p, std::align_val_t, const std::nothrow_t &) noexcept { new_free(p); }
@@ -0,0 +1,382 @@
+/*
+ * mmrecord.c - Record the allocator calls of real programs as traces
+ *
+ * Built as mmrecord.so with "make mmrecord.so", this interposes on
+ * malloc, free, realloc, calloc and the aligned allocation functions
+ * of any program run with
+ *
+ *     unix> LD_PRELOAD=./mmrecord.so <program>
+ *
+ * forwarding every call to the C library and logging it. When the
+ * program exits, the log is converted to a tracefile that mdriver -f
+ * can replay. Calls are logged into a buffer per thread, with no lock
+ * on the fast path: each event just takes a global sequence number
+ * with one atomic add. Full buffers are appended to a binary log file
+ * (see reclog.h), and the conversion sorts the events back into one
+ * sequence and maps pointers to dense block ids.
+ *
+ * Environment:
+ *   MMRECORD_OUT     output path, %p is replaced by the process id
+ *                    (default mmrecord.%p.rep or mmrecord.%p.bin)
+ *   MMRECORD_FORMAT  "rep" (default) converts at exit; "bin" keeps the
+ *                    binary log, for long captures, to be converted
+ *                    later with rec2rep
+ *
+ * Each process writes its own file, so programs that run others can
+ * be recorded too; a forked child that doesn't exec isn't recorded.
+ * Programs that leave with _exit() or a signal lose their last
+ * buffers and leave the binary log behind as <out>.log, which rec2rep
+ * can still convert. Threads still running at exit may lose a few
+ * events.
+ */
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dlfcn.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "reclog.h"
+
+#define REC_BUFEVENTS 4096      /* events per thread buffer */
+#define REC_BOOTSTRAP 16384     /* bytes handed out while resolving */
+#define REC_MAXPATH   1024
+
+/* A thread's event buffer. Buffers are never freed, so that the ones
+   of threads that have exited can still be flushed at exit. */
+typedef struct rec_buf {
+    struct rec_buf *next;       /* all buffers, for the final flush */
+    uint32_t tid;
+    int n;                      /* number of buffered events */
+    rec_event_t events[REC_BUFEVENTS];
+} rec_buf_t;
+
+/* The C library's functions */
+static void *(*real_malloc)(size_t);
+static void (*real_free)(void *);
+static void *(*real_calloc)(size_t, size_t);
+static void *(*real_realloc)(void *, size_t);
+static void *(*real_memalign)(size_t, size_t);
+static int (*real_posix_memalign)(void **, size_t, size_t);
+static void *(*real_aligned_alloc)(size_t, size_t);
+
+/* Memory handed out while dlsym looks the functions up */
+static char bootstrap[REC_BOOTSTRAP] __attribute__((aligned(16)));
+static size_t bootstrap_used = 0;
+static int resolving = 0;
+
+static int active = 0;          /* set while recording */
+static uint64_t next_seq = 0;   /* global event order */
+static uint32_t next_tid = 0;
+static int log_fd = -1;
+static char log_path[REC_MAXPATH];  /* binary log */
+static char out_path[REC_MAXPATH];  /* tracefile, if converting */
+static rec_buf_t *buffers = NULL;
+static pthread_mutex_t rec_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static __thread rec_buf_t *tbuf __attribute__((tls_model("initial-exec")));
+
+/*
+ * expand_path - Copy pattern to path with %p replaced by the pid,
+ *     without stdio, which may allocate
+ */
+static void expand_path(char *path, const char *pattern, const char *ext)
+{
+    char digits[24];
+    int i, n = 0, len = 0;
+    pid_t pid = getpid();
+
+    do
+	digits[n++] = '0' + pid % 10;
+    while ((pid /= 10) > 0);
+
+    for (; *pattern && len < REC_MAXPATH - 32; pattern++) {
+	if (pattern[0] == '%' && pattern[1] == 'p') {
+	    for (i = n - 1; i >= 0; i--)
+		path[len++] = digits[i];
+	    pattern++;
+	}
+	else
+	    path[len++] = *pattern;
+    }
+    strcpy(path + len, ext);
+}
+
+/*
+ * rec_resolve - Look up the C library's functions. dlsym may itself
+ *     call calloc, which is served from the bootstrap buffer meanwhile.
+ */
+static void rec_resolve(void)
+{
+    resolving = 1;
+    real_malloc = dlsym(RTLD_NEXT, "malloc");
+    real_free = dlsym(RTLD_NEXT, "free");
+    real_calloc = dlsym(RTLD_NEXT, "calloc");
+    real_realloc = dlsym(RTLD_NEXT, "realloc");
+    real_memalign = dlsym(RTLD_NEXT, "memalign");
+    real_posix_memalign = dlsym(RTLD_NEXT, "posix_memalign");
+    real_aligned_alloc = dlsym(RTLD_NEXT, "aligned_alloc");
+    resolving = 0;
+}
+
+static void *bootstrap_alloc(size_t size)
+{
+    void *p;
+
+    size = (size + 15) & ~(size_t)15;
+    if (bootstrap_used + size > REC_BOOTSTRAP)
+	return NULL;
+    p = bootstrap + bootstrap_used;
+    bootstrap_used += size;
+    return p;
+}
+
+static int is_bootstrap(void *p)
+{
+    return (char *)p >= bootstrap && (char *)p < bootstrap + REC_BOOTSTRAP;
+}
+
+/*
+ * rec_flush - Append a buffer to the log. Called with rec_lock held.
+ */
+static void rec_flush(rec_buf_t *b)
+{
+    size_t bytes = b->n * sizeof(rec_event_t);
+    char *p = (char *)b->events;
+    ssize_t w;
+
+    while (bytes > 0 && log_fd >= 0) {
+	if ((w = write(log_fd, p, bytes)) < 0) {
+	    if (errno == EINTR)
+		continue;
+	    break;
+	}
+	p += w;
+	bytes -= w;
+    }
+    b->n = 0;
+}
+
+/*
+ * rec_log - Log one call in the calling thread's buffer
+ */
+static void rec_log(uint32_t type, void *ptr, void *old, size_t size)
+{
+    rec_buf_t *b = tbuf;
+    rec_event_t *e;
+
+    if (!__atomic_load_n(&active, __ATOMIC_RELAXED))
+	return;
+    if (b == NULL) {
+	b = mmap(NULL, sizeof(rec_buf_t), PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (b == MAP_FAILED)
+	    return;
+	pthread_mutex_lock(&rec_lock);
+	b->tid = next_tid++;
+	b->next = buffers;
+	buffers = b;
+	pthread_mutex_unlock(&rec_lock);
+	tbuf = b;
+    }
+
+    e = &b->events[b->n];
+    e->seq = __atomic_fetch_add(&next_seq, 1, __ATOMIC_RELAXED);
+    e->type = type;
+    e->ptr = (uintptr_t)ptr;
+    e->old = (uintptr_t)old;
+    e->size = size;
+    e->tid = b->tid;
+    if (++b->n == REC_BUFEVENTS) {
+	pthread_mutex_lock(&rec_lock);
+	rec_flush(b);
+	pthread_mutex_unlock(&rec_lock);
+    }
+}
+
+/* A forked child that doesn't exec is not recorded */
+static void rec_child(void)
+{
+    active = 0;
+    log_fd = -1;
+}
+
+/*
+ * rec_start - Open the log when the library is loaded
+ */
+__attribute__((constructor))
+static void rec_start(void)
+{
+    rec_header_t h;
+    char *out = getenv("MMRECORD_OUT");
+    char *format = getenv("MMRECORD_FORMAT");
+    int binary = (format && !strcmp(format, "bin"));
+
+    if (real_malloc == NULL)
+	rec_resolve();
+    if (out == NULL)
+	out = binary ? "mmrecord.%p.bin" : "mmrecord.%p.rep";
+    if (binary)
+	expand_path(log_path, out, "");
+    else {
+	expand_path(out_path, out, "");
+	expand_path(log_path, out, ".log");
+    }
+
+    if ((log_fd = open(log_path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+	return;
+    memcpy(h.magic, RECLOG_MAGIC, sizeof(h.magic));
+    h.version = RECLOG_VERSION;
+    h.event_size = sizeof(rec_event_t);
+    if (write(log_fd, &h, sizeof(h)) != sizeof(h)) {
+	close(log_fd);
+	log_fd = -1;
+	return;
+    }
+    pthread_atfork(NULL, NULL, rec_child);
+    active = 1;
+}
+
+/*
+ * rec_stop - Flush every buffer when the program exits and, unless a
+ *     binary log was asked for, convert the log to a tracefile
+ */
+__attribute__((destructor))
+static void rec_stop(void)
+{
+    rec_buf_t *b;
+    rec_event_t *events;
+    long n;
+    FILE *fp;
+
+    if (!active)
+	return;
+    __atomic_store_n(&active, 0, __ATOMIC_RELAXED);
+    pthread_mutex_lock(&rec_lock);
+    for (b = buffers; b != NULL; b = b->next)
+	rec_flush(b);
+    close(log_fd);
+    log_fd = -1;
+    pthread_mutex_unlock(&rec_lock);
+
+    if (out_path[0] == '\0')
+	return;
+    if ((n = reclog_read(log_path, &events)) < 0 ||
+	(fp = fopen(out_path, "w")) == NULL) {
+	fprintf(stderr, "mmrecord: could not convert %s\n", log_path);
+	return;
+    }
+    reclog_convert(events, n, fp);
+    fclose(fp);
+    free(events);
+    unlink(log_path);
+}
+
+/*
+ * The interposed functions. Each forwards to the C library and logs
+ * the call; frees are logged before the block is released and
+ * allocations after they return, so that a block reused by another
+ * thread is always freed earlier in the sequence than it is reused.
+ * A realloc both releases a block and returns one, so it is logged
+ * twice: a REC_RELEASE of the old block before the call, and the
+ * REC_REALLOC after it.
+ */
+void *malloc(size_t size)
+{
+    void *p;
+
+    if (real_malloc == NULL) {
+	if (resolving)
+	    return bootstrap_alloc(size);
+	rec_resolve();
+    }
+    p = real_malloc(size);
+    rec_log(REC_ALLOC, p, NULL, size);
+    return p;
+}
+
+void free(void *ptr)
+{
+    if (ptr == NULL || is_bootstrap(ptr))
+	return;
+    if (real_free == NULL)
+	rec_resolve();
+    rec_log(REC_FREE, ptr, NULL, 0);
+    real_free(ptr);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    void *p;
+
+    if (real_calloc == NULL) {
+	if (resolving)
+	    return bootstrap_alloc(nmemb * size); /* static, so zeroed */
+	rec_resolve();
+    }
+    p = real_calloc(nmemb, size);
+    rec_log(REC_ALLOC, p, NULL, nmemb * size);
+    return p;
+}
+
+void *realloc(void *ptr, size_t size)
+{
+    void *p;
+    size_t avail;
+
+    if (real_realloc == NULL) {
+	if (resolving)
+	    return NULL;
+	rec_resolve();
+    }
+    if (is_bootstrap(ptr)) {
+	/* Move it out of the bootstrap buffer, copying what may be there */
+	avail = bootstrap + REC_BOOTSTRAP - (char *)ptr;
+	if ((p = malloc(size)) != NULL)
+	    memcpy(p, ptr, size < avail ? size : avail);
+	return p;
+    }
+    if (ptr != NULL)
+	rec_log(REC_RELEASE, ptr, NULL, 0);
+    p = real_realloc(ptr, size);
+    rec_log(REC_REALLOC, p, ptr, size);
+    return p;
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    void *p;
+
+    if (real_memalign == NULL)
+	rec_resolve();
+    p = real_memalign(alignment, size);
+    rec_log(REC_ALLOC, p, NULL, size);
+    return p;
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    int ret;
+
+    if (real_posix_memalign == NULL)
+	rec_resolve();
+    if ((ret = real_posix_memalign(memptr, alignment, size)) == 0)
+	rec_log(REC_ALLOC, *memptr, NULL, size);
+    return ret;
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    void *p;
+
+    if (real_aligned_alloc == NULL)
+	rec_resolve();
+    p = real_aligned_alloc(alignment, size);
+    rec_log(REC_ALLOC, p, NULL, size);
+    return p;
+}
@@ -0,0 +1,331 @@
+/*
+ * mmshim.c - Run the mm.c allocator under real programs
+ *
+ * Built as mmshim.so with "make mmshim.so", this exports the C
+ * library's allocation functions on top of the mm package, so that
+ *
+ *     unix> LD_PRELOAD=./mmshim.so ls -lR /usr/include
+ *
+ * runs an unmodified program with mm.c as its malloc. The heap is
+ * address space reserved by mem_init_reserve() (MMSHIM_HEAP_MB
+ * megabytes from the environment, by default 32 GB on 64-bit systems
+ * and 1 GB otherwise), so memory is only used as mem_sbrk hands it out
+ * and the program's RSS can be compared with the libc malloc's.
+ *
+ * The mm package is not thread safe, so every call holds one global
+ * lock, which is also held across fork() so that the child never
+ * inherits it locked. mm.c only aligns payloads to 8 bytes while malloc
+ * must return memory suitable for any type (16 bytes, like glibc), so
+ * every request goes through mm_memalign. Pointers the heap didn't
+ * come from (allocated by the dynamic loader before the shim was in
+ * place) are ignored by free.
+ *
+ * With MMSHIM_PROFILE set to a number of bytes, the shim also runs the
+ * sampling heap profiler (heapprof.h) at that rate, and writes the live
+ * heap to <prefix>.<pid>.<n>.heap when the program gets SIGUSR2 (at its
+ * next allocator call) and when it exits. The prefix is MMSHIM_PROFILE_OUT,
+ * by default "mmshim". Read the profiles with pprof.
+ *
+ * With MMSHIM_GUARD set to N, about one allocation in N of at most a
+ * page is served from a pool of guarded slots (guardpool.h) instead,
+ * MMSHIM_GUARD_SLOTS of them (default 256), so that overflows and uses
+ * after free of those blocks fault at once and are diagnosed on stderr.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "mm.h"
+#include "memlib.h"
+#include "heapprof.h"
+#include "guardpool.h"
+
+/* Alignment of every payload returned by the shim */
+#define SHIM_ALIGN 16
+
+/* Largest request or alignment, so that block sizes fit in mm.c's
+   32-bit headers */
+#define SHIM_MAXSIZE ((size_t)1 << 30)
+
+/* Default size of the reserved heap, in megabytes */
+#define SHIM_HEAP_MB (sizeof(void *) == 8 ? 32768 : 1024)
+
+/* Max length of a profile path */
+#define SHIM_MAXPATH 1024
+
+/* Default number of guarded slots */
+#define SHIM_GUARD_SLOTS 256
+
+static pthread_mutex_t shim_lock = PTHREAD_MUTEX_INITIALIZER;
+static int shim_ready = 0;
+
+static int profiling = 0;
+static char *profile_prefix = "mmshim";
+static int profile_seq = 0;
+static volatile sig_atomic_t dump_requested = 0;
+
+/*
+ * Fork handlers, so that the child gets an unlocked, consistent heap
+ */
+static void shim_prepare(void) { pthread_mutex_lock(&shim_lock); }
+static void shim_parent(void)  { pthread_mutex_unlock(&shim_lock); }
+static void shim_child(void)   { pthread_mutex_init(&shim_lock, NULL); }
+
+static void shim_sigusr2(int sig) { dump_requested = 1; }
+
+static void shim_init(void);
+
+/*
+ * shim_dump - Write the next heap profile. Called with the lock held,
+ *     so it must not allocate.
+ */
+static void shim_dump(void)
+{
+    char path[SHIM_MAXPATH];
+    int fd;
+
+    dump_requested = 0;
+    snprintf(path, sizeof(path), "%s.%d.%04d.heap", profile_prefix,
+	     (int)getpid(), profile_seq++);
+    if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644)) < 0)
+	return;
+    heapprof_dump(fd);
+    close(fd);
+}
+
+/*
+ * shim_guard - Start the guarded pool, which needs the heap
+ */
+static void shim_guard(long rate)
+{
+    char *env;
+    int nslots = SHIM_GUARD_SLOTS;
+
+    if ((env = getenv("MMSHIM_GUARD_SLOTS")) != NULL && atoi(env) > 0)
+	nslots = atoi(env);
+    pthread_mutex_lock(&shim_lock);
+    shim_init();
+    pthread_mutex_unlock(&shim_lock);
+    if (guard_start(rate, nslots) < 0)
+	fprintf(stderr, "mmshim: could not start the guarded pool\n");
+}
+
+/*
+ * shim_register - Install the fork handlers and start the guarded pool
+ *     and the profiler when the shim is loaded, outside of any
+ *     allocation since they may allocate themselves
+ */
+__attribute__((constructor))
+static void shim_register(void)
+{
+    char *env;
+
+    pthread_atfork(shim_prepare, shim_parent, shim_child);
+    if ((env = getenv("MMSHIM_GUARD")) != NULL && atol(env) > 0)
+	shim_guard(atol(env));
+    if ((env = getenv("MMSHIM_PROFILE")) == NULL || atol(env) <= 0)
+	return;
+    if ((profile_prefix = getenv("MMSHIM_PROFILE_OUT")) == NULL)
+	profile_prefix = "mmshim";
+    if (heapprof_start(atol(env)) < 0) {
+	fprintf(stderr, "mmshim: could not start the heap profiler\n");
+	return;
+    }
+    signal(SIGUSR2, shim_sigusr2);
+    profiling = 1;
+}
+
+/*
+ * shim_finish - Write the last profile when the program exits
+ */
+__attribute__((destructor))
+static void shim_finish(void)
+{
+    if (!profiling)
+	return;
+    pthread_mutex_lock(&shim_lock);
+    shim_dump();
+    pthread_mutex_unlock(&shim_lock);
+}
+
+/*
+ * shim_init - Reserve the heap and initialize the mm package on the
+ *     first call. Called with the lock held.
+ */
+static void shim_init(void)
+{
+    char *env;
+    size_t mb = SHIM_HEAP_MB;
+
+    if (shim_ready)
+	return;
+    if ((env = getenv("MMSHIM_HEAP_MB")) != NULL && atol(env) > 0)
+	mb = atol(env);
+    mem_init_reserve(mb << 20);
+    if (mm_init() < 0) {
+	fprintf(stderr, "mmshim: mm_init failed\n");
+	abort();
+    }
+    shim_ready = 1;
+}
+
+/*
+ * shim_owns - Is p a payload in our heap or guarded pool? Called with
+ *     the lock held.
+ */
+static int shim_owns(void *p)
+{
+    return ((char *)p > (char *)mem_heap_lo() && (char *)p <= (char *)mem_heap_hi()) ||
+	GUARD_OWNS(p);
+}
+
+/*
+ * shim_alloc - Allocate size bytes aligned to align (a power of two)
+ */
+static void *shim_alloc(size_t align, size_t size)
+{
+    void *p;
+
+    if (size > SHIM_MAXSIZE || align > SHIM_MAXSIZE) {
+	errno = ENOMEM;
+	return NULL;
+    }
+    if (size == 0)
+	size = 1; /* malloc(0) must return a unique pointer */
+    if (align < SHIM_ALIGN)
+	align = SHIM_ALIGN;
+
+    pthread_mutex_lock(&shim_lock);
+    shim_init();
+    p = mm_memalign(align, size);
+    if (dump_requested)
+	shim_dump();
+    pthread_mutex_unlock(&shim_lock);
+    if (p == NULL)
+	errno = ENOMEM;
+    return p;
+}
+
+/*
+ * The C library's allocation interface
+ */
+void *malloc(size_t size)
+{
+    return shim_alloc(SHIM_ALIGN, size);
+}
+
+void free(void *ptr)
+{
+    if (ptr == NULL)
+	return;
+    pthread_mutex_lock(&shim_lock);
+    if (shim_ready && shim_owns(ptr))
+	mm_free(ptr);
+    pthread_mutex_unlock(&shim_lock);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+    void *p;
+
+    if (size != 0 && nmemb > SHIM_MAXSIZE / size) {
+	errno = ENOMEM;
+	return NULL;
+    }
+    if ((p = shim_alloc(SHIM_ALIGN, nmemb * size)) != NULL)
+	memset(p, 0, nmemb * size);
+    return p;
+}
+
+/*
+ * realloc - Keep the block if it is big enough and no more than twice
+ *     the new size, otherwise move it. mm_realloc is not used because
+ *     it would not keep the payload SHIM_ALIGN aligned.
+ */
+void *realloc(void *ptr, size_t size)
+{
+    void *newp;
+    size_t oldsize;
+
+    if (ptr == NULL)
+	return malloc(size);
+    if (size == 0) {
+	free(ptr);
+	return NULL;
+    }
+
+    pthread_mutex_lock(&shim_lock);
+    if (!shim_ready || !shim_owns(ptr)) {
+	pthread_mutex_unlock(&shim_lock);
+	fprintf(stderr, "mmshim: realloc of a pointer not from the heap\n");
+	abort();
+    }
+    oldsize = mm_usable_size(ptr);
+    pthread_mutex_unlock(&shim_lock);
+    if (size <= oldsize && size >= oldsize / 2)
+	return ptr;
+
+    if ((newp = malloc(size)) == NULL)
+	return NULL;
+    memcpy(newp, ptr, size < oldsize ? size : oldsize);
+    free(ptr);
+    return newp;
+}
+
+void *memalign(size_t alignment, size_t size)
+{
+    if (alignment == 0 || (alignment & (alignment - 1)) != 0) {
+	errno = EINVAL;
+	return NULL;
+    }
+    return shim_alloc(alignment, size);
+}
+
+int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    void *p;
+
+    if (alignment == 0 || alignment % sizeof(void *) != 0 ||
+	(alignment & (alignment - 1)) != 0)
+	return EINVAL;
+    if ((p = shim_alloc(alignment, size)) == NULL)
+	return ENOMEM;
+    *memptr = p;
+    return 0;
+}
+
+void *aligned_alloc(size_t alignment, size_t size)
+{
+    return memalign(alignment, size);
+}
+
+void *valloc(size_t size)
+{
+    return shim_alloc(getpagesize(), size);
+}
+
+void *pvalloc(size_t size)
+{
+    size_t page = getpagesize();
+
+    return shim_alloc(page, (size + page - 1) & ~(page - 1));
+}
+
+size_t malloc_usable_size(void *ptr)
+{
+    size_t size = 0;
+
+    if (ptr == NULL)
+	return 0;
+    pthread_mutex_lock(&shim_lock);
+    if (shim_ready && shim_owns(ptr))
+	size = mm_usable_size(ptr);
+    pthread_mutex_unlock(&shim_lock);
+    return size;
+}
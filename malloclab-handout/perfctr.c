@@ -0,0 +1,151 @@
+/*
+ * perfctr.c - Hardware performance counters around a piece of code
+ *
+ * Each event gets its own perf_event_open descriptor rather than one
+ * group, so that events the machine (or a VM) doesn't support are just
+ * left out. If the kernel has to multiplex the counters, the counts
+ * are scaled up by the fraction of time each one was actually running.
+ * Only user-space events of the calling thread are counted.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "perfctr.h"
+
+static char *names[PERF_NCOUNTERS] = {
+    "cyc", "ins", "L1dm", "LLCm", "dTLBm", "brm"
+};
+
+#if defined(__linux__)
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+static int fds[PERF_NCOUNTERS] = {-1, -1, -1, -1, -1, -1};
+
+/* Type and config of each event, in the order of the enum */
+static struct {
+    unsigned type;
+    unsigned long long config;
+} events[PERF_NCOUNTERS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D |
+			 (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+			 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB |
+			 (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+			 (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+/*
+ * perfctr_open - Open a disabled counter for each event, closing any
+ *     still open first. Returns the number of events that can be
+ *     counted on this machine.
+ */
+int perfctr_open(void)
+{
+    struct perf_event_attr attr;
+    int i, n = 0;
+
+    perfctr_close();
+    for (i = 0; i < PERF_NCOUNTERS; i++) {
+	memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = events[i].type;
+	attr.config = events[i].config;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+			   PERF_FORMAT_TOTAL_TIME_RUNNING;
+	fds[i] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+	if (fds[i] >= 0)
+	    n++;
+    }
+    return n;
+}
+
+/*
+ * perfctr_close - Close every open counter
+ */
+void perfctr_close(void)
+{
+    int i;
+
+    for (i = 0; i < PERF_NCOUNTERS; i++) {
+	if (fds[i] >= 0)
+	    close(fds[i]);
+	fds[i] = -1;
+    }
+}
+
+/*
+ * perfctr_start - Reset and enable every open counter
+ */
+void perfctr_start(void)
+{
+    int i;
+
+    for (i = 0; i < PERF_NCOUNTERS; i++) {
+	if (fds[i] < 0)
+	    continue;
+	ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+	ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+
+/*
+ * perfctr_stop - Disable the counters and read them into *c
+ */
+void perfctr_stop(perfctr_t *c)
+{
+    unsigned long long v[3]; /* value, time enabled, time running */
+    int i;
+
+    for (i = 0; i < PERF_NCOUNTERS; i++)
+	if (fds[i] >= 0)
+	    ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+
+    for (i = 0; i < PERF_NCOUNTERS; i++) {
+	c->valid[i] = 0;
+	c->count[i] = 0.0;
+	if (fds[i] < 0 || read(fds[i], v, sizeof(v)) != sizeof(v) || v[2] == 0)
+	    continue;
+	c->valid[i] = 1;
+	c->count[i] = (double)v[0] * ((double)v[1] / (double)v[2]);
+    }
+}
+
+#else
+
+int perfctr_open(void)
+{
+    return 0;
+}
+
+void perfctr_close(void)
+{
+}
+
+void perfctr_start(void)
+{
+}
+
+void perfctr_stop(perfctr_t *c)
+{
+    memset(c, 0, sizeof(perfctr_t));
+}
+
+#endif
+
+/*
+ * perfctr_name - Short name of event i, for table headers
+ */
+char *perfctr_name(int i)
+{
+    return names[i];
+}
@@ -0,0 +1,40 @@
+/*
+ * perfctr.h - Hardware performance counters around a piece of code
+ *     (Linux perf_event_open; elsewhere no counters are available)
+ */
+#ifndef __PERFCTR_H_
+#define __PERFCTR_H_
+
+/* The events we count */
+enum {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_L1D_MISSES,
+    PERF_LLC_MISSES,
+    PERF_DTLB_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_NCOUNTERS
+};
+
+/* Counts of one measured region */
+typedef struct {
+    int valid[PERF_NCOUNTERS];     /* was this event counted? */
+    double count[PERF_NCOUNTERS];  /* event counts, scaled for multiplexing */
+} perfctr_t;
+
+/* Open the counters. Returns the number of events that can be counted */
+int perfctr_open(void);
+
+/* Close the counters */
+void perfctr_close(void);
+
+/* Reset and start every open counter */
+void perfctr_start(void);
+
+/* Stop the counters and read them into *c */
+void perfctr_stop(perfctr_t *c);
+
+/* Short name of event i, for table headers */
+char *perfctr_name(int i);
+
+#endif /* __PERFCTR_H_ */
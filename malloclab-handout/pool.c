@@ -0,0 +1,66 @@
+/*
+ * pool.c - Fixed-size object pools (see pool.h)
+ *
+ * A chunk starts with the link to the next chunk, padded to the object
+ * alignment, and the objects follow. A new chunk's objects are all
+ * pushed on the free list at once, last first, so that they are then
+ * handed out in address order.
+ */
+#include "pool.h"
+#include "mm.h"
+
+#define POOL_ALIGN 8             /* alignment of mm_malloc */
+
+mm_pool_t *mm_pool_create(size_t obj_size, size_t align)
+{
+    mm_pool_t *p;
+
+    if (align == 0)
+	align = POOL_ALIGN;
+    /* The bound keeps the rounded size and a chunk of POOL_MINOBJS
+       objects from wrapping */
+    if ((align & (align - 1)) != 0 || obj_size == 0 ||
+	obj_size > POOL_MAXOBJ || align > POOL_MAXOBJ)
+	return NULL;
+    if (align < sizeof(void *))
+	align = sizeof(void *);
+    if ((p = mm_malloc(sizeof(mm_pool_t))) == NULL)
+	return NULL;
+    p->free = NULL;
+    p->chunks = NULL;
+    p->align = align;
+    p->size = (obj_size + align - 1) & ~(align - 1);
+    return p;
+}
+
+void mm_pool_destroy(mm_pool_t *p)
+{
+    void *chunk, *next;
+
+    for (chunk = p->chunks; chunk != NULL; chunk = next) {
+	next = *(void **)chunk;
+	mm_free(chunk);
+    }
+    mm_free(p);
+}
+
+void *mm_pool_refill(mm_pool_t *p)
+{
+    size_t head = (sizeof(void *) + p->align - 1) & ~(p->align - 1);
+    size_t n = (POOL_CHUNK - head) / p->size;
+    char *chunk, *obj;
+
+    if (n < POOL_MINOBJS)
+	n = POOL_MINOBJS;
+    chunk = (p->align > POOL_ALIGN) ? mm_memalign(p->align, head + n * p->size)
+	: mm_malloc(head + n * p->size);
+    if (chunk == NULL)
+	return NULL;
+    *(void **)chunk = p->chunks;
+    p->chunks = chunk;
+
+    /* Hand out the first object, free the others */
+    for (obj = chunk + head + (n - 1) * p->size; obj > chunk + head; obj -= p->size)
+	mm_pool_free(p, obj);
+    return chunk + head;
+}
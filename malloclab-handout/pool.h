@@ -0,0 +1,67 @@
+/*
+ * pool.h - Fixed-size object pools on top of the mm package
+ *
+ * A pool hands out objects of one size and alignment from chunks it
+ * allocates from the heap with mm_memalign. Objects carry no header:
+ * a free object holds the link of the pool's free list in its first
+ * word, so allocating and freeing are a pop and a push, and only a
+ * refill, when the free list is empty, calls into mm.c. Chunks are
+ * given back to the heap when the pool is destroyed, never before.
+ *
+ * A pool must only be used by one thread at a time, and doesn't
+ * survive mm_init, which empties the heap its chunks are in.
+ */
+#ifndef __POOL_H_
+#define __POOL_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define POOL_CHUNK (16 << 10)    /* bytes of the chunks, unless objects are bigger */
+#define POOL_MINOBJS 16          /* objects in a chunk at least */
+#define POOL_MAXOBJ (16 << 20)   /* largest object size and alignment */
+
+typedef struct {
+    void *free;                  /* free objects, linked through their first word */
+    size_t size;                 /* object size, a multiple of align */
+    size_t align;                /* object alignment, a power of two */
+    void *chunks;                /* chunks, linked through their first word */
+} mm_pool_t;
+
+/* Create a pool of objects of obj_size bytes aligned to align (0 for
+   the heap's alignment), or return NULL, also if either is more than
+   POOL_MAXOBJ */
+mm_pool_t *mm_pool_create(size_t obj_size, size_t align);
+
+/* Give every chunk back to the heap, with the objects still in them */
+void mm_pool_destroy(mm_pool_t *p);
+
+/* Slow path of mm_pool_alloc: allocate a chunk and take an object */
+void *mm_pool_refill(mm_pool_t *p);
+
+/* Allocate an object, or return NULL if the heap is full */
+static inline void *mm_pool_alloc(mm_pool_t *p)
+{
+    void *obj = p->free;
+
+    if (obj == NULL)
+	return mm_pool_refill(p);
+    p->free = *(void **)obj;
+    return obj;
+}
+
+/* Free an object of pool p */
+static inline void mm_pool_free(mm_pool_t *p, void *obj)
+{
+    *(void **)obj = p->free;
+    p->free = obj;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __POOL_H_ */
@@ -0,0 +1,65 @@
+/*
+ * pool.hpp - Typed C++ wrapper of the object pools of pool.h
+ *
+ * mm::Pool<T> is a pool of objects of type T: create() allocates one
+ * and constructs it in place with the given arguments, destroy() runs
+ * its destructor and gives it back to the pool. Objects still alive
+ * when the pool is destroyed are freed without being destroyed.
+ */
+#ifndef __POOL_HPP_
+#define __POOL_HPP_
+
+#include <new>
+#include <utility>
+
+#include "pool.h"
+
+namespace mm {
+
+template <class T>
+class Pool {
+public:
+    Pool() : pool_(mm_pool_create(sizeof(T), alignof(T)))
+    {
+	if (pool_ == nullptr)
+	    throw std::bad_alloc();
+    }
+
+    ~Pool() { mm_pool_destroy(pool_); }
+
+    Pool(const Pool &) = delete;
+    Pool &operator=(const Pool &) = delete;
+
+    /* Allocate a T and construct it from args */
+    template <class... Args>
+    T *create(Args &&... args)
+    {
+	void *p = mm_pool_alloc(pool_);
+
+	if (p == nullptr)
+	    throw std::bad_alloc();
+	try {
+	    return new (p) T(std::forward<Args>(args)...);
+	}
+	catch (...) {
+	    mm_pool_free(pool_, p);
+	    throw;
+	}
+    }
+
+    /* Destroy a T made by create and free it */
+    void destroy(T *obj)
+    {
+	if (obj == nullptr)
+	    return;
+	obj->~T();
+	mm_pool_free(pool_, obj);
+    }
+
+private:
+    mm_pool_t *pool_;
+};
+
+} /* namespace mm */
+
+#endif /* __POOL_HPP_ */
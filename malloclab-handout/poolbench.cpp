@@ -0,0 +1,265 @@
+/*
+ * poolbench.cpp - Compare object pools with mm_malloc and mm_free
+ *
+ * For each object size, allocates -n objects and frees them again in a
+ * shuffled order, -r times over, four ways: with mm_malloc and mm_free,
+ * with the inline mm::alloc<N> and mm::dealloc<N> of mm.hpp, with
+ * mm_pool_alloc and mm_pool_free, and with the create and destroy of
+ * mm::Pool<T>, which also construct and destroy the objects. Every run
+ * starts from an empty heap, as in mdriver, and includes creating and
+ * destroying the pool and flushing the bins. Prints the time per
+ * allocation and free pair, and how many times faster than mm_malloc
+ * and mm_free the bins and the C pool are. With -n 1, the bins never
+ * miss and mm_malloc never searches, so only the cost of the calls
+ * remains.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+
+#include "mm.hpp"
+#include "pool.hpp"
+
+extern "C" {
+#include "memlib.h"
+#include "fsecs.h"
+#include "clock.h"
+#include "config.h"
+}
+
+/*******************
+ * Global variables
+ *******************/
+int verbose = 0;                /* global flag for verbose output */
+
+static int nobjs = 1000;        /* objects live at once (-n) */
+static int rounds = 100;        /* allocations and frees of all of them (-r) */
+static int *order;              /* shuffled order of the frees */
+static void **objs;
+
+/* An object of N bytes */
+template <size_t N>
+struct Obj {
+    char data[N];
+    Obj() { data[0] = 0; }
+};
+
+/*********************
+ * Function prototypes
+ *********************/
+static void usage(void);
+static void app_error(const char *msg);
+
+/*
+ * run_mm - The general path
+ */
+template <size_t N>
+static void run_mm(void *)
+{
+    int r, i;
+
+    mem_reset_brk();
+    if (mm_init() < 0)
+	app_error("mm_init failed in run_mm");
+    for (r = 0; r < rounds; r++) {
+	for (i = 0; i < nobjs; i++) {
+	    if ((objs[i] = mm_malloc(N)) == NULL)
+		app_error("mm_malloc failed in run_mm");
+	    static_cast<char *>(objs[i])[0] = 0;
+	}
+	for (i = 0; i < nobjs; i++)
+	    mm_free(objs[order[i]]);
+    }
+}
+
+/*
+ * run_bins - The inline path through the size-class bins
+ */
+template <size_t N>
+static void run_bins(void *)
+{
+    int r, i;
+
+    mem_reset_brk();
+    if (mm_init() < 0)
+	app_error("mm_init failed in run_bins");
+    for (r = 0; r < rounds; r++) {
+	for (i = 0; i < nobjs; i++) {
+	    if ((objs[i] = mm::alloc<N>()) == NULL)
+		app_error("mm::alloc failed in run_bins");
+	    static_cast<char *>(objs[i])[0] = 0;
+	}
+	for (i = 0; i < nobjs; i++)
+	    mm::dealloc<N>(objs[order[i]]);
+    }
+    mm::bin_flush();
+}
+
+/*
+ * run_pool - The C pool
+ */
+template <size_t N>
+static void run_pool(void *)
+{
+    mm_pool_t *p;
+    int r, i;
+
+    mem_reset_brk();
+    if (mm_init() < 0 || (p = mm_pool_create(N, 0)) == NULL)
+	app_error("mm_pool_create failed in run_pool");
+    for (r = 0; r < rounds; r++) {
+	for (i = 0; i < nobjs; i++) {
+	    if ((objs[i] = mm_pool_alloc(p)) == NULL)
+		app_error("mm_pool_alloc failed in run_pool");
+	    static_cast<char *>(objs[i])[0] = 0;
+	}
+	for (i = 0; i < nobjs; i++)
+	    mm_pool_free(p, objs[order[i]]);
+    }
+    mm_pool_destroy(p);
+}
+
+/*
+ * run_typed - mm::Pool<T>
+ */
+template <size_t N>
+static void run_typed(void *)
+{
+    int r, i;
+
+    mem_reset_brk();
+    if (mm_init() < 0)
+	app_error("mm_init failed in run_typed");
+    mm::Pool<Obj<N> > pool;
+    for (r = 0; r < rounds; r++) {
+	for (i = 0; i < nobjs; i++)
+	    objs[i] = pool.create();
+	for (i = 0; i < nobjs; i++)
+	    pool.destroy(static_cast<Obj<N> *>(objs[order[i]]));
+    }
+}
+
+/* The four ways, for one size */
+struct size_funcs {
+    size_t size;
+    fsecs_test_funct mm, bins, pool, typed;
+};
+
+#define SIZE_FUNCS(n) { n, run_mm<n>, run_bins<n>, run_pool<n>, run_typed<n> }
+
+static const size_funcs sizes[] = {
+    SIZE_FUNCS(16), SIZE_FUNCS(24), SIZE_FUNCS(48), SIZE_FUNCS(64),
+    SIZE_FUNCS(128), SIZE_FUNCS(256), SIZE_FUNCS(1024)
+};
+
+/**************
+ * Main routine
+ **************/
+int main(int argc, char **argv)
+{
+    int c, i, j, t, cpu = -1;
+    fsecs_timer_t timer = DEFAULT_TIMER;
+    unsigned long long rng = 0x9E3779B97F4A7C15ULL;
+    double pairs, mm_secs, bins_secs, pool_secs, typed_secs;
+
+    while ((c = getopt(argc, argv, "n:r:T:C:hv")) != EOF) {
+        switch (c) {
+	case 'n': /* Objects live at once */
+	    nobjs = atoi(optarg);
+	    break;
+	case 'r': /* Rounds */
+	    rounds = atoi(optarg);
+	    break;
+	case 'T': /* Timing method */
+	    if ((t = fsecs_parse_timer(optarg)) < 0) {
+		usage();
+		exit(1);
+	    }
+	    timer = (fsecs_timer_t)t;
+	    break;
+	case 'C': /* Pin to one CPU */
+	    cpu = atoi(optarg);
+	    break;
+	case 'v': /* Print timer calibration details */
+	    verbose = 1;
+	    break;
+        case 'h': /* Print this message */
+	    usage();
+            exit(0);
+        default:
+	    usage();
+            exit(1);
+        }
+    }
+    if (nobjs <= 0 || rounds <= 0) {
+	usage();
+	exit(1);
+    }
+
+    if (cpu >= 0 && pin_cpu(cpu) < 0)
+	app_error("ERROR: could not pin to the requested CPU");
+    init_fsecs(timer);
+    mem_init();
+
+    /* Fisher-Yates shuffle of the free order */
+    if ((order = (int *)malloc(nobjs * sizeof(int))) == NULL ||
+	(objs = (void **)malloc(nobjs * sizeof(void *))) == NULL)
+	app_error("malloc failed in main");
+    for (i = 0; i < nobjs; i++)
+	order[i] = i;
+    for (i = nobjs - 1; i > 0; i--) {
+	rng ^= rng << 13;
+	rng ^= rng >> 7;
+	rng ^= rng << 17;
+	j = (int)(rng % (i + 1));
+	t = order[i];
+	order[i] = order[j];
+	order[j] = t;
+    }
+
+    printf("Pools and bins vs mm_malloc/mm_free, %d objects x %d rounds (timer %s):\n",
+	   nobjs, rounds, fsecs_timer_name());
+    printf("%6s%10s%13s%10s%13s%12s%10s\n", "size", "mm ns", "alloc<N> ns",
+	   "pool ns", "Pool<T> ns", "alloc<N> x", "pool x");
+    pairs = (double)nobjs * rounds;
+    for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++) {
+	mm_secs = fsecs(sizes[i].mm, NULL);
+	bins_secs = fsecs(sizes[i].bins, NULL);
+	pool_secs = fsecs(sizes[i].pool, NULL);
+	typed_secs = fsecs(sizes[i].typed, NULL);
+	printf("%6lu%10.1f%13.1f%10.1f%13.1f%11.1fx%9.1fx\n",
+	       (unsigned long)sizes[i].size, mm_secs / pairs * 1e9,
+	       bins_secs / pairs * 1e9, pool_secs / pairs * 1e9,
+	       typed_secs / pairs * 1e9, mm_secs / bins_secs, mm_secs / pool_secs);
+    }
+
+    free(order);
+    free(objs);
+    mem_deinit();
+    exit(0);
+}
+
+/*
+ * app_error - Report an arbitrary application error
+ */
+static void app_error(const char *msg)
+{
+    printf("%s\n", msg);
+    exit(1);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: poolbench [-hv] [-n <objs>] [-r <rounds>] [-T <timer>] [-C <cpu>]\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-C <cpu>    Pin the benchmark to CPU <cpu>.\n");
+    fprintf(stderr, "\t-h          Print this message.\n");
+    fprintf(stderr, "\t-n <objs>   Objects live at once (default 1000).\n");
+    fprintf(stderr, "\t-r <rounds> Times all of them are allocated and freed (default 100).\n");
+    fprintf(stderr, "\t-T <timer>  Timing method: fcyc, itimer or gettod.\n");
+    fprintf(stderr, "\t-v          Print timer calibration details.\n");
+}
@@ -0,0 +1,68 @@
+/*
+ * rec2rep.c - Convert a binary log captured by mmrecord.so with
+ *     MMRECORD_FORMAT=bin to a tracefile
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "reclog.h"
+
+static void usage(void);
+
+int main(int argc, char **argv)
+{
+    int c;
+    char *outfile = NULL;
+    rec_event_t *events;
+    long n;
+    FILE *fp;
+
+    while ((c = getopt(argc, argv, "o:h")) != EOF) {
+        switch (c) {
+	case 'o': /* Output file (default stdout) */
+	    outfile = optarg;
+	    break;
+        case 'h': /* Print this message */
+	    usage();
+            exit(0);
+        default:
+	    usage();
+            exit(1);
+        }
+    }
+    if (optind != argc - 1) {
+	usage();
+	exit(1);
+    }
+
+    if ((n = reclog_read(argv[optind], &events)) < 0) {
+	fprintf(stderr, "rec2rep: %s is not a readable mmrecord log\n",
+		argv[optind]);
+	exit(1);
+    }
+    if (outfile) {
+	if ((fp = fopen(outfile, "w")) == NULL) {
+	    perror("rec2rep: could not open output file");
+	    exit(1);
+	}
+    }
+    else
+	fp = stdout;
+    reclog_convert(events, n, fp);
+    if (fp != stdout)
+	fclose(fp);
+    free(events);
+    exit(0);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: rec2rep [-h] [-o <file>] <log>\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-h          Print this message.\n");
+    fprintf(stderr, "\t-o <file>   Write the trace to <file> instead of stdout.\n");
+}
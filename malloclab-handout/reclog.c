@@ -0,0 +1,315 @@
+/*
+ * reclog.c - Read the binary logs written by mmrecord.so and convert
+ *     them to tracefiles
+ *
+ * Events are put in the order of their sequence numbers, and every
+ * pointer is mapped to a dense block id while it is live: an alloc
+ * gets the next id, a realloc keeps the id of the block it was given,
+ * and a free retires the pointer so that the address can come back
+ * later as a new id. A realloc is logged twice, as a REC_RELEASE of
+ * the old pointer before the call and a REC_REALLOC after: the
+ * release retires the old pointer at once, since another thread may
+ * get the address before the realloc returns, and the realloc binds
+ * the new pointer to the id the same thread's release put aside.
+ *
+ * Calls the trace format can't express are dropped (frees of blocks
+ * allocated before recording started, failed allocations), and a
+ * zero-byte request is recorded as one byte, since the driver treats
+ * a NULL return from mm_malloc as an error.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "reclog.h"
+
+/* A live block: the pointer the program holds and its block id */
+typedef struct {
+    uint64_t ptr;       /* 0 if the slot is empty */
+    int id;
+} slot_t;
+
+/* One request of the trace being built */
+typedef struct {
+    char type;          /* 'a', 'r' or 'f' */
+    int id;
+    int size;
+} recop_t;
+
+/* The state of a conversion */
+typedef struct {
+    slot_t *map;        /* open addressing hash of the live pointers */
+    size_t mapsize;     /* a power of two */
+    size_t nlive;       /* number of live pointers */
+    recop_t *ops;       /* the trace... */
+    long nops;          /* ... its length... */
+    long maxops;        /* ... and capacity */
+    int *sizes;         /* current size of each id */
+    int nids, maxids;
+    int *pending;       /* per thread: id its REC_RELEASE put aside, */
+    uint32_t maxtids;   /*   -2 if it was unknown, -1 if none */
+    long live, peak;    /* live payload bytes and their peak */
+} conv_t;
+
+static void rec_error(char *msg)
+{
+    fprintf(stderr, "reclog: %s\n", msg);
+    exit(1);
+}
+
+/*
+ * reclog_read - Read the events of a log into a new array, return
+ *     their number or -1 if path isn't a log this version can read
+ */
+long reclog_read(char *path, rec_event_t **events)
+{
+    FILE *fp;
+    rec_header_t h;
+    long bytes, n;
+
+    if ((fp = fopen(path, "rb")) == NULL)
+	return -1;
+    if (fread(&h, sizeof(h), 1, fp) != 1 ||
+	memcmp(h.magic, RECLOG_MAGIC, sizeof(h.magic)) != 0 ||
+	h.version < RECLOG_MIN_VERSION || h.version > RECLOG_VERSION ||
+	h.event_size != sizeof(rec_event_t)) {
+	fclose(fp);
+	return -1;
+    }
+    fseek(fp, 0, SEEK_END);
+    bytes = ftell(fp) - sizeof(h);
+    fseek(fp, sizeof(h), SEEK_SET);
+
+    n = bytes / sizeof(rec_event_t);
+    if ((*events = malloc((n ? n : 1) * sizeof(rec_event_t))) == NULL)
+	rec_error("out of memory reading the log");
+    n = fread(*events, sizeof(rec_event_t), n, fp);
+    fclose(fp);
+    return n;
+}
+
+/*
+ * Hash map of live pointers, with linear probing and backward shift
+ * deletion so that no tombstones are needed
+ */
+static size_t slot_of(conv_t *c, uint64_t ptr)
+{
+    return (size_t)(((ptr >> 4) * 0x9E3779B97F4A7C15ULL) >> 20) & (c->mapsize - 1);
+}
+
+static slot_t *map_find(conv_t *c, uint64_t ptr)
+{
+    size_t i;
+
+    if (c->mapsize == 0)
+	return NULL;
+    for (i = slot_of(c, ptr); c->map[i].ptr; i = (i + 1) & (c->mapsize - 1))
+	if (c->map[i].ptr == ptr)
+	    return &c->map[i];
+    return NULL;
+}
+
+static void map_put(conv_t *c, uint64_t ptr, int id)
+{
+    slot_t *old = c->map;
+    size_t i, oldsize = c->mapsize;
+
+    if (2 * (c->nlive + 1) > c->mapsize) {
+	c->mapsize = oldsize ? 2 * oldsize : 1024;
+	if ((c->map = calloc(c->mapsize, sizeof(slot_t))) == NULL)
+	    rec_error("out of memory converting the log");
+	c->nlive = 0;
+	for (i = 0; i < oldsize; i++)
+	    if (old[i].ptr)
+		map_put(c, old[i].ptr, old[i].id);
+	free(old);
+    }
+    for (i = slot_of(c, ptr); c->map[i].ptr; i = (i + 1) & (c->mapsize - 1))
+	;
+    c->map[i].ptr = ptr;
+    c->map[i].id = id;
+    c->nlive++;
+}
+
+static void map_del(conv_t *c, slot_t *s)
+{
+    size_t i = s - c->map, j = i, k;
+
+    for (;;) {
+	j = (j + 1) & (c->mapsize - 1);
+	if (!c->map[j].ptr)
+	    break;
+	/* Move j back into the hole at i unless its home lies in (i, j] */
+	k = slot_of(c, c->map[j].ptr);
+	if ((i <= j) ? (i < k && k <= j) : (i < k || k <= j))
+	    continue;
+	c->map[i] = c->map[j];
+	i = j;
+    }
+    c->map[i].ptr = 0;
+    c->nlive--;
+}
+
+/* emit - Append a request to the trace and track the live bytes */
+static void emit(conv_t *c, char type, int id, long size)
+{
+    if (c->nops == c->maxops) {
+	c->maxops = c->maxops ? 2 * c->maxops : 4096;
+	if ((c->ops = realloc(c->ops, c->maxops * sizeof(recop_t))) == NULL)
+	    rec_error("out of memory converting the log");
+    }
+    if (id == c->maxids) {
+	c->maxids = c->maxids ? 2 * c->maxids : 4096;
+	if ((c->sizes = realloc(c->sizes, c->maxids * sizeof(int))) == NULL)
+	    rec_error("out of memory converting the log");
+    }
+    if (type == 'a')
+	c->sizes[id] = 0;
+    if (type == 'f')
+	size = 0;
+    c->live += size - c->sizes[id];
+    c->sizes[id] = size;
+    if (c->live > c->peak)
+	c->peak = c->live;
+
+    c->ops[c->nops].type = type;
+    c->ops[c->nops].id = id;
+    c->ops[c->nops++].size = size;
+}
+
+/* alloc - A new block ptr. An address still mapped was freed unseen. */
+static void alloc(conv_t *c, uint64_t ptr, long size)
+{
+    slot_t *s;
+
+    if ((s = map_find(c, ptr)) != NULL) {
+	emit(c, 'f', s->id, 0);
+	map_del(c, s);
+    }
+    map_put(c, ptr, c->nids);
+    emit(c, 'a', c->nids++, size);
+}
+
+/* set_pending - Put aside the id released by thread tid */
+static void set_pending(conv_t *c, uint32_t tid, int id)
+{
+    uint32_t i, old = c->maxtids;
+
+    if (tid >= c->maxtids) {
+	c->maxtids = (tid < 32) ? 64 : 2 * tid;
+	if ((c->pending = realloc(c->pending, c->maxtids * sizeof(int))) == NULL)
+	    rec_error("out of memory converting the log");
+	for (i = old; i < c->maxtids; i++)
+	    c->pending[i] = -1;
+    }
+    c->pending[tid] = id;
+}
+
+/* take_pending - Take the id released by thread tid, -1 if none */
+static int take_pending(conv_t *c, uint32_t tid)
+{
+    int id;
+
+    if (tid >= c->maxtids)
+	return -1;
+    id = c->pending[tid];
+    c->pending[tid] = -1;
+    return id;
+}
+
+static int cmp_seq(const void *a, const void *b)
+{
+    uint64_t x = ((rec_event_t *)a)->seq, y = ((rec_event_t *)b)->seq;
+    return (x > y) - (x < y);
+}
+
+/*
+ * reclog_convert - Write n events to fp as a tracefile. The events
+ *     are sorted by sequence number in place.
+ */
+void reclog_convert(rec_event_t *events, long n, FILE *fp)
+{
+    conv_t c;
+    rec_event_t *e;
+    slot_t *s;
+    long i, size;
+    int id;
+
+    memset(&c, 0, sizeof(c));
+    qsort(events, n, sizeof(rec_event_t), cmp_seq);
+
+    for (i = 0; i < n; i++) {
+	e = &events[i];
+	size = (e->size == 0) ? 1 : (e->size > INT_MAX) ? -1 : (long)e->size;
+	switch (e->type) {
+	case REC_ALLOC:
+	    if (e->ptr && size > 0)
+		alloc(&c, e->ptr, size);
+	    break;
+
+	case REC_FREE:
+	    if (e->ptr && (s = map_find(&c, e->ptr)) != NULL) {
+		emit(&c, 'f', s->id, 0);
+		map_del(&c, s);
+	    }
+	    break;
+
+	case REC_RELEASE:
+	    id = -2;
+	    if (e->ptr && (s = map_find(&c, e->ptr)) != NULL) {
+		id = s->id;
+		map_del(&c, s);
+	    }
+	    set_pending(&c, e->tid, id);
+	    break;
+
+	case REC_REALLOC:
+	    if ((id = take_pending(&c, e->tid)) == -1) {
+		/* No release logged first (a version 1 log) */
+		id = -2;
+		if (e->old && (s = map_find(&c, e->old)) != NULL) {
+		    id = s->id;
+		    map_del(&c, s);
+		}
+	    }
+	    if (e->ptr == 0) {
+		/* realloc(old, 0) frees old; otherwise it failed and old
+		   is still live */
+		if (id >= 0 && e->size == 0)
+		    emit(&c, 'f', id, 0);
+		else if (id >= 0)
+		    map_put(&c, e->old, id);
+		break;
+	    }
+	    if (id < 0 || size < 0) {
+		if (id >= 0)
+		    emit(&c, 'f', id, 0);
+		if (size > 0)
+		    alloc(&c, e->ptr, size);
+		break;
+	    }
+	    if ((s = map_find(&c, e->ptr)) != NULL) {
+		emit(&c, 'f', s->id, 0);
+		map_del(&c, s);
+	    }
+	    map_put(&c, e->ptr, id);
+	    emit(&c, 'r', id, size);
+	    break;
+	}
+    }
+
+    /* The four header lines read_trace expects */
+    fprintf(fp, "%ld\n%d\n%ld\n%d\n", c.peak, c.nids, c.nops, 1);
+    for (i = 0; i < c.nops; i++) {
+	if (c.ops[i].type == 'f')
+	    fprintf(fp, "f %d\n", c.ops[i].id);
+	else
+	    fprintf(fp, "%c %d %d\n", c.ops[i].type, c.ops[i].id, c.ops[i].size);
+    }
+
+    free(c.map);
+    free(c.ops);
+    free(c.sizes);
+    free(c.pending);
+}
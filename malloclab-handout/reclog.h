@@ -0,0 +1,44 @@
+/*
+ * reclog.h - Binary log of the allocator calls of a real program, as
+ *     captured by mmrecord.so, and its conversion to a tracefile
+ */
+#ifndef __RECLOG_H_
+#define __RECLOG_H_
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define RECLOG_MAGIC "MMRECLOG"
+#define RECLOG_VERSION 2        /* version 1 logs have no REC_RELEASE */
+#define RECLOG_MIN_VERSION 1    /* oldest version reclog_read accepts */
+
+/* Event types */
+#define REC_ALLOC   0   /* malloc, calloc, memalign...: ptr of size bytes */
+#define REC_FREE    1   /* free(ptr) */
+#define REC_REALLOC 2   /* realloc(old, size) returned ptr */
+#define REC_RELEASE 3   /* realloc is about to be given ptr, logged first */
+
+/* The log starts with this header... */
+typedef struct {
+    char magic[8];      /* RECLOG_MAGIC, not NUL terminated */
+    uint32_t version;   /* RECLOG_VERSION */
+    uint32_t event_size;/* sizeof(rec_event_t) */
+} rec_header_t;
+
+/* ... followed by events, in per-thread batches ordered by seq */
+typedef struct {
+    uint64_t seq;       /* global order of the call */
+    uint64_t ptr;       /* block returned, or freed */
+    uint64_t old;       /* realloc: block passed in */
+    uint64_t size;      /* requested bytes */
+    uint32_t type;      /* REC_ALLOC, REC_FREE, REC_REALLOC or REC_RELEASE */
+    uint32_t tid;       /* recording thread, in order of first call */
+} rec_event_t;
+
+/* Read the events of a log into a new array, return their number or -1 */
+long reclog_read(char *path, rec_event_t **events);
+
+/* Write n events (reordered in place) to fp as a tracefile */
+void reclog_convert(rec_event_t *events, long n, FILE *fp);
+
+#endif /* __RECLOG_H_ */
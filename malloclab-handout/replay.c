@@ -0,0 +1,203 @@
+/*
+ * replay.c - Compare native and interpreted replay of traces
+ *
+ * Times every trace compiled in by trace2c twice: once through an
+ * interpreter that does exactly what eval_mm_speed() in mdriver.c does
+ * (decode each request, switch on its type, look the block up, check
+ * the result), and once through the generated straight-line code,
+ * which only calls the allocator. The difference is the part of the
+ * driver's throughput figure that is really the driver.
+ *
+ * Both versions reset the heap and call mm_init() inside the timed
+ * region, as mdriver does, so the numbers are directly comparable
+ * with mdriver's Kops.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include "replay.h"
+#include "memlib.h"
+#include "fsecs.h"
+#include "clock.h"
+#include "config.h"
+
+/*******************
+ * Global variables
+ *******************/
+int verbose = 0;        /* global flag for verbose output */
+
+/* The params of a timed replay */
+typedef struct {
+    const replay_t *trace;
+    char **blocks;      /* block pointers of the interpreter */
+} replay_params_t;
+
+/*********************
+ * Function prototypes
+ *********************/
+static void run_interp(void *ptr);
+static void run_native(void *ptr);
+static void usage(void);
+static void app_error(char *msg);
+static void unix_error(char *msg);
+
+/**************
+ * Main routine
+ **************/
+int main(int argc, char **argv)
+{
+    int c, i, cpu = -1;
+    fsecs_timer_t timer = DEFAULT_TIMER;
+    replay_params_t params;
+    double interp, native, total_interp = 0, total_native = 0;
+    long total_ops = 0;
+    const replay_t *t;
+
+    while ((c = getopt(argc, argv, "T:C:hv")) != EOF) {
+        switch (c) {
+	case 'T': /* Timing method */
+	    if ((timer = fsecs_parse_timer(optarg)) < 0) {
+		usage();
+		exit(1);
+	    }
+	    break;
+	case 'C': /* Pin to one CPU */
+	    cpu = atoi(optarg);
+	    break;
+	case 'v': /* Print timer calibration details */
+	    verbose = 1;
+	    break;
+        case 'h': /* Print this message */
+	    usage();
+            exit(0);
+        default:
+	    usage();
+            exit(1);
+        }
+    }
+
+    if (cpu >= 0 && pin_cpu(cpu) < 0)
+	unix_error("ERROR: could not pin to the requested CPU");
+    init_fsecs(timer);
+    mem_init();
+
+    printf("Native vs interpreted replay (timer %s):\n", fsecs_timer_name());
+    printf("%5s%10s%13s%13s%8s  %s\n",
+	   "trace", "ops", "interp Kops", "native Kops", "driver", "name");
+    for (i = 0; i < replay_ntraces; i++) {
+	t = &replay_traces[i];
+	params.trace = t;
+	if ((params.blocks = calloc(t->num_ids + 1, sizeof(char *))) == NULL)
+	    unix_error("malloc failed in main");
+
+	interp = fsecs(run_interp, &params);
+	native = fsecs(run_native, &params);
+	free(params.blocks);
+
+	printf("%2d%13d%13.0f%13.0f%7.1f%%  %s\n", i, t->num_ops,
+	       (t->num_ops/1e3)/interp, (t->num_ops/1e3)/native,
+	       100.0 * (interp - native) / interp, t->name);
+	total_ops += t->num_ops;
+	total_interp += interp;
+	total_native += native;
+    }
+    if (replay_ntraces > 1)
+	printf("%5s%10ld%13.0f%13.0f%7.1f%%\n", "Total", total_ops,
+	       (total_ops/1e3)/total_interp, (total_ops/1e3)/total_native,
+	       100.0 * (total_interp - total_native) / total_interp);
+
+    mem_deinit();
+    exit(0);
+}
+
+/*
+ * run_interp - Replay a trace by interpreting its requests, the same
+ *     way eval_mm_speed() does
+ */
+static void run_interp(void *ptr)
+{
+    replay_params_t *params = ptr;
+    const replay_t *trace = params->trace;
+    char **blocks = params->blocks;
+    int i, index, size;
+    char *p;
+
+    mem_reset_brk();
+    if (mm_init() < 0)
+	app_error("mm_init failed in run_interp");
+
+    for (i = 0; i < trace->num_ops; i++)
+        switch (trace->ops[i].type) {
+
+        case ALLOC: /* mm_malloc */
+            index = trace->ops[i].index;
+            size = trace->ops[i].size;
+            if ((p = mm_malloc(size)) == NULL)
+		app_error("mm_malloc error in run_interp");
+            blocks[index] = p;
+            break;
+
+	case REALLOC: /* mm_realloc */
+	    index = trace->ops[i].index;
+            size = trace->ops[i].size;
+            if ((p = mm_realloc(blocks[index], size)) == NULL)
+		app_error("mm_realloc error in run_interp");
+            blocks[index] = p;
+            break;
+
+        case FREE: /* mm_free */
+            index = trace->ops[i].index;
+            mm_free(blocks[index]);
+            break;
+
+	default:
+	    app_error("Nonexistent request type in run_interp");
+        }
+}
+
+/*
+ * run_native - Replay a trace through its generated code
+ */
+static void run_native(void *ptr)
+{
+    replay_params_t *params = ptr;
+
+    mem_reset_brk();
+    if (mm_init() < 0)
+	app_error("mm_init failed in run_native");
+    params->trace->run();
+}
+
+/*
+ * app_error - Report an arbitrary application error
+ */
+static void app_error(char *msg)
+{
+    printf("%s\n", msg);
+    exit(1);
+}
+
+/*
+ * unix_error - Report a Unix-style error
+ */
+static void unix_error(char *msg)
+{
+    printf("%s: %s\n", msg, strerror(errno));
+    exit(1);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: replay [-hv] [-T <timer>] [-C <cpu>]\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-C <cpu>    Pin the benchmark to CPU <cpu>.\n");
+    fprintf(stderr, "\t-h          Print this message.\n");
+    fprintf(stderr, "\t-T <timer>  Timing method: fcyc, itimer or gettod.\n");
+    fprintf(stderr, "\t-v          Print timer calibration details.\n");
+}
@@ -0,0 +1,23 @@
+/*
+ * replay.h - Traces compiled to native replay functions by trace2c
+ */
+#ifndef __REPLAY_H_
+#define __REPLAY_H_
+
+#include "trace.h"
+#include "mm.h"
+
+/* One compiled trace */
+typedef struct {
+    char *name;              /* tracefile it was generated from */
+    void (*run)(void);       /* the trace as straight-line mm_ calls */
+    const traceop_t *ops;    /* the same trace as data, for interpreting */
+    int num_ops;             /* number of requests */
+    int num_ids;             /* number of alloc/realloc ids */
+} replay_t;
+
+/* Defined in the file generated by trace2c */
+extern const replay_t replay_traces[];
+extern const int replay_ntraces;
+
+#endif /* __REPLAY_H_ */
@@ -0,0 +1,274 @@
+/*
+ * results.c - Machine-readable JSON and CSV forms of the driver results
+ *
+ * Every field of stats_t is written for every trace, together with the
+ * environment the numbers were measured in, so that runs on different
+ * machines or builds can be told apart and compared later. The JSON
+ * file has one trace object per line to keep it easy to grep and diff.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "results.h"
+
+/* BUILD_CFLAGS is passed in by the Makefile */
+#ifndef BUILD_CFLAGS
+#define BUILD_CFLAGS "unknown"
+#endif
+
+#if defined(__clang__)
+#define COMPILER "clang " __clang_version__
+#elif defined(__GNUC__)
+#define COMPILER "gcc " __VERSION__
+#else
+#define COMPILER "unknown"
+#endif
+
+/* 
+ * cpu_model - Copy the CPU model name from /proc/cpuinfo, if there is one
+ */
+static void cpu_model(char *buf, int size)
+{
+    FILE *fp;
+    char line[ENVLINE];
+    char *p;
+
+    strncpy(buf, "unknown", size);
+    if ((fp = fopen("/proc/cpuinfo", "r")) == NULL)
+	return;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+	if (strncmp(line, "model name", 10) || (p = strchr(line, ':')) == NULL)
+	    continue;
+	for (p++; *p == ' ' || *p == '\t'; p++)
+	    ;
+	p[strcspn(p, "\n")] = '\0';
+	strncpy(buf, p, size - 1);
+	buf[size - 1] = '\0';
+	break;
+    }
+    fclose(fp);
+}
+
+/*
+ * results_env - Describe the current machine, build, and timing setup
+ */
+void results_env(env_t *env, char *timer, int warmup, int reps)
+{
+    time_t now = time(NULL);
+
+    memset(env, 0, sizeof(env_t));
+    cpu_model(env->cpu, ENVLINE);
+    strncpy(env->compiler, COMPILER, ENVLINE - 1);
+    strncpy(env->cflags, BUILD_CFLAGS, ENVLINE - 1);
+    strncpy(env->timer, timer, ENVLINE - 1);
+    strftime(env->date, ENVLINE, "%Y-%m-%dT%H:%M:%S", localtime(&now));
+    env->warmup = warmup;
+    env->reps = reps;
+}
+
+/* 
+ * perf_per_op - Event i of s per trace op, or 0 if it wasn't counted
+ */
+static double perf_per_op(stats_t *s, int i)
+{
+    return (s->perf.valid[i] && s->ops > 0) ? s->perf.count[i] / s->ops : 0.0;
+}
+
+/* 
+ * put_string - Write s as a quoted string; JSON and CSV escape quotes
+ *     differently, so the caller passes its quote escape sequence.
+ */
+static void put_string(FILE *fp, char *s, char *quote_escape)
+{
+    fputc('"', fp);
+    for (; *s; s++) {
+	if (*s == '"')
+	    fputs(quote_escape, fp);
+	else if (*s == '\\' && quote_escape[0] == '\\')
+	    fputs("\\\\", fp);
+	else
+	    fputc(*s, fp);
+    }
+    fputc('"', fp);
+}
+
+/*
+ * kops_string - The throughput of a trace, or none if it isn't valid
+ *     or ran too fast for the timer to measure (secs is 0)
+ */
+static char *kops_string(stats_t *s, char *none)
+{
+    static char buf[32];
+
+    if (!s->valid || s->secs <= 0)
+	return none;
+    sprintf(buf, "%.3f", s->ops / 1e3 / s->secs);
+    return buf;
+}
+
+/*
+ * results_write_json - Write the environment and the stats of n traces
+ *     as a JSON object
+ */
+void results_write_json(FILE *fp, env_t *env, int n, char **names,
+			stats_t *stats)
+{
+    int i, j;
+    stats_t *s;
+
+    fprintf(fp, "{\n  \"env\": {\"cpu\": ");
+    put_string(fp, env->cpu, "\\\"");
+    fprintf(fp, ", \"compiler\": ");
+    put_string(fp, env->compiler, "\\\"");
+    fprintf(fp, ", \"cflags\": ");
+    put_string(fp, env->cflags, "\\\"");
+    fprintf(fp, ", \"timer\": ");
+    put_string(fp, env->timer, "\\\"");
+    fprintf(fp, ", \"date\": ");
+    put_string(fp, env->date, "\\\"");
+    fprintf(fp, ", \"warmup\": %d, \"reps\": %d},\n", env->warmup, env->reps);
+
+    fprintf(fp, "  \"traces\": [\n");
+    for (i = 0; i < n; i++) {
+	s = &stats[i];
+	fprintf(fp, "    {\"trace\": ");
+	put_string(fp, names[i], "\\\"");
+	fprintf(fp, ", \"valid\": %d, \"ops\": %.0f, \"util\": %.6f, "
+		"\"secs\": %.9g, \"kops\": %s, \"n\": %d, \"outliers\": %d, "
+		"\"median\": %.9g, \"mean\": %.9g, \"stddev\": %.9g, "
+		"\"ci_lo\": %.9g, \"ci_hi\": %.9g, \"samples\": %d, "
+		"\"avg_util\": %.6f, \"avg_frag\": %.6f",
+		s->valid, s->ops, s->util, s->secs,
+		kops_string(s, "null"),
+		s->bench.n, s->bench.outliers, s->bench.median,
+		s->bench.mean, s->bench.stddev, s->bench.ci_lo, s->bench.ci_hi,
+		s->samples, s->avg_util, s->avg_frag);
+	for (j = 0; j < PERF_NCOUNTERS; j++)
+	    fprintf(fp, ", \"%s_per_op\": %.4f",
+		    perfctr_name(j), perf_per_op(s, j));
+	fprintf(fp, "}%s\n", (i < n - 1) ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+}
+
+/*
+ * results_write_csv - Write the stats of n traces as CSV, one row per
+ *     trace, with the environment repeated on every row
+ */
+void results_write_csv(FILE *fp, env_t *env, int n, char **names,
+		       stats_t *stats)
+{
+    int i, j;
+    stats_t *s;
+
+    fprintf(fp, "trace,valid,ops,util,secs,kops,n,outliers,median,mean,"
+	    "stddev,ci_lo,ci_hi,samples,avg_util,avg_frag,");
+    for (j = 0; j < PERF_NCOUNTERS; j++)
+	fprintf(fp, "%s_per_op,", perfctr_name(j));
+    fprintf(fp, "cpu,compiler,cflags,timer,date,warmup,reps\n");
+    for (i = 0; i < n; i++) {
+	s = &stats[i];
+	put_string(fp, names[i], "\"\"");
+	fprintf(fp, ",%d,%.0f,%.6f,%.9g,%s,%d,%d,%.9g,%.9g,%.9g,%.9g,%.9g,"
+		"%d,%.6f,%.6f,",
+		s->valid, s->ops, s->util, s->secs,
+		kops_string(s, ""),
+		s->bench.n, s->bench.outliers, s->bench.median,
+		s->bench.mean, s->bench.stddev, s->bench.ci_lo, s->bench.ci_hi,
+		s->samples, s->avg_util, s->avg_frag);
+	for (j = 0; j < PERF_NCOUNTERS; j++)
+	    fprintf(fp, "%.4f,", perf_per_op(s, j));
+	put_string(fp, env->cpu, "\"\"");
+	fputc(',', fp);
+	put_string(fp, env->compiler, "\"\"");
+	fputc(',', fp);
+	put_string(fp, env->cflags, "\"\"");
+	fputc(',', fp);
+	put_string(fp, env->timer, "\"\"");
+	fputc(',', fp);
+	put_string(fp, env->date, "\"\"");
+	fprintf(fp, ",%d,%d\n", env->warmup, env->reps);
+    }
+}
+
+/* 
+ * json_number - Return the value of the number field key in one line of
+ *     a file written by results_write_json, or 0 if it isn't there
+ */
+static double json_number(char *line, char *key)
+{
+    char pattern[ENVLINE];
+    char *p;
+
+    sprintf(pattern, "\"%s\": ", key);
+    if ((p = strstr(line, pattern)) == NULL)
+	return 0.0;
+    return strtod(p + strlen(pattern), NULL);
+}
+
+/*
+ * results_read_json - Read back the per-trace stats of a file written by
+ *     results_write_json. This is not a general JSON parser: it relies
+ *     on each trace object being on a line of its own.
+ */
+int results_read_json(char *path, char ***names, stats_t **stats)
+{
+    FILE *fp;
+    char line[4*ENVLINE];
+    char *p, *q;
+    int n = 0, max = 16;
+    stats_t *s;
+
+    if ((fp = fopen(path, "r")) == NULL)
+	return -1;
+    if ((*names = malloc(max * sizeof(char *))) == NULL ||
+	(*stats = calloc(max, sizeof(stats_t))) == NULL) {
+	fclose(fp);
+	return -1;
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+	if ((p = strstr(line, "{\"trace\": \"")) == NULL)
+	    continue;
+	if (n == max) {
+	    max *= 2;
+	    if ((*names = realloc(*names, max * sizeof(char *))) == NULL ||
+		(*stats = realloc(*stats, max * sizeof(stats_t))) == NULL) {
+		fclose(fp);
+		return -1;
+	    }
+	}
+
+	/* The trace name, unescaping \" and \\ */
+	p += strlen("{\"trace\": \"");
+	(*names)[n] = q = strdup(p);
+	for (; *p && *p != '"'; p++) {
+	    if (*p == '\\' && p[1])
+		p++;
+	    *q++ = *p;
+	}
+	*q = '\0';
+
+	s = &(*stats)[n];
+	memset(s, 0, sizeof(stats_t));
+	s->valid = (int)json_number(line, "valid");
+	s->ops = json_number(line, "ops");
+	s->util = json_number(line, "util");
+	s->secs = json_number(line, "secs");
+	s->bench.n = (int)json_number(line, "n");
+	s->bench.outliers = (int)json_number(line, "outliers");
+	s->bench.median = json_number(line, "median");
+	s->bench.mean = json_number(line, "mean");
+	s->bench.stddev = json_number(line, "stddev");
+	s->bench.ci_lo = json_number(line, "ci_lo");
+	s->bench.ci_hi = json_number(line, "ci_hi");
+	s->samples = (int)json_number(line, "samples");
+	s->avg_util = json_number(line, "avg_util");
+	s->avg_frag = json_number(line, "avg_frag");
+	n++;
+    }
+    fclose(fp);
+    return n;
+}
@@ -0,0 +1,68 @@
+/*
+ * results.h - Per-trace results of the driver and their machine-readable
+ *     JSON and CSV forms
+ */
+#ifndef __RESULTS_H_
+#define __RESULTS_H_
+
+#include <stdio.h>
+#include "bench.h"
+#include "perfctr.h"
+
+#define ENVLINE 256 /* max size of an environment string */
+
+/* Summarizes the important stats for some malloc function on some trace */
+typedef struct {
+    /* defined for both libc malloc and student malloc package (mm.c) */
+    double ops;      /* number of ops (malloc/free/realloc) in the trace */
+    int valid;       /* was the trace processed correctly by the allocator? */
+    double secs;     /* number of secs needed to run the trace */
+
+    /* defined only for the student malloc package */
+    double util;     /* space utilization for this trace (always 0 for libc) */
+
+    /* defined only in benchmark mode (-B), where secs is bench.median */
+    bench_t bench;   /* distribution of the timed runs */
+
+    /* defined only if the heap was sampled (-S) */
+    int samples;     /* number of heap samples taken */
+    double avg_util; /* live bytes over heap size, averaged over samples */
+    double avg_frag; /* 1 - largest free block / free bytes, averaged */
+
+    /* defined only if the locality pass was run (-L) */
+    double loc_secs; /* secs needed to replay and touch the trace */
+    perfctr_t loc_perf; /* event counts of one locality pass */
+
+    /* defined only if hardware counters were collected (-P) */
+    perfctr_t perf;  /* event counts of one run of the trace */
+
+    /* Note: secs and util are only defined if valid is true */
+} stats_t; 
+
+/* Describes where and how a set of results was measured */
+typedef struct {
+    char cpu[ENVLINE];      /* CPU model name */
+    char compiler[ENVLINE]; /* compiler and version the driver was built with */
+    char cflags[ENVLINE];   /* compiler flags the driver was built with */
+    char timer[ENVLINE];    /* timing method (see fsecs.h) */
+    char date[ENVLINE];     /* when the run started, ISO 8601 */
+    int warmup;             /* untimed runs per trace in benchmark mode */
+    int reps;               /* timed runs per trace in benchmark mode */
+} env_t;
+
+/* Describe the current machine, build, and timing setup */
+void results_env(env_t *env, char *timer, int warmup, int reps);
+
+/* Write the stats of n traces, with their names and the environment */
+void results_write_json(FILE *fp, env_t *env, int n, char **names,
+			stats_t *stats);
+void results_write_csv(FILE *fp, env_t *env, int n, char **names,
+		       stats_t *stats);
+
+/* 
+ * Read back a file written by results_write_json. Returns the number of
+ * traces, with their names and stats in malloc'd arrays, or -1.
+ */
+int results_read_json(char *path, char ***names, stats_t **stats);
+
+#endif /* __RESULTS_H_ */
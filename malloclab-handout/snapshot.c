@@ -0,0 +1,104 @@
+/*
+ * snapshot.c - Heap snapshots (see snapshot.h)
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "snapshot.h"
+
+void snap_init(snap_t *s, char *engine, int trace, int op, size_t heapsize,
+	       size_t live)
+{
+    memset(s, 0, sizeof(snap_t));
+    memcpy(s->h.magic, SNAP_MAGIC, sizeof(s->h.magic));
+    s->h.version = SNAP_VERSION;
+    s->h.trace = trace;
+    s->h.op = op;
+    s->h.heapsize = heapsize;
+    s->h.live = live;
+    strncpy(s->h.engine, engine, SNAP_NAMELEN - 1);
+}
+
+int snap_add(snap_t *s, size_t offset, size_t size, int alloc)
+{
+    snap_block_t *b;
+
+    if (s->h.nblocks == s->maxblocks) {
+	s->maxblocks = s->maxblocks ? 2 * s->maxblocks : 1024;
+	b = realloc(s->blocks, s->maxblocks * sizeof(snap_block_t));
+	if (b == NULL)
+	    return -1;
+	s->blocks = b;
+    }
+    b = &s->blocks[s->h.nblocks++];
+    b->offset = offset;
+    b->size = size | (alloc ? 1 : 0);
+    return 0;
+}
+
+void snap_free(snap_t *s)
+{
+    free(s->blocks);
+    s->blocks = NULL;
+    s->maxblocks = s->h.nblocks = 0;
+}
+
+int snap_write(snap_t *s, char *path)
+{
+    FILE *fp;
+    int ok;
+
+    if ((fp = fopen(path, "wb")) == NULL)
+	return -1;
+    ok = fwrite(&s->h, sizeof(s->h), 1, fp) == 1 &&
+	fwrite(s->blocks, sizeof(snap_block_t), s->h.nblocks, fp) == s->h.nblocks;
+    return (fclose(fp) == 0 && ok) ? 0 : -1;
+}
+
+int snap_read(snap_t *s, char *path)
+{
+    FILE *fp;
+
+    memset(s, 0, sizeof(snap_t));
+    if ((fp = fopen(path, "rb")) == NULL)
+	return -1;
+    if (fread(&s->h, sizeof(s->h), 1, fp) != 1 ||
+	memcmp(s->h.magic, SNAP_MAGIC, sizeof(s->h.magic)) != 0 ||
+	s->h.version != SNAP_VERSION) {
+	fclose(fp);
+	return -1;
+    }
+    s->h.engine[SNAP_NAMELEN - 1] = '\0';
+    s->maxblocks = s->h.nblocks;
+    if ((s->blocks = malloc((s->maxblocks ? s->maxblocks : 1) *
+			    sizeof(snap_block_t))) == NULL ||
+	fread(s->blocks, sizeof(snap_block_t), s->h.nblocks, fp) != s->h.nblocks) {
+	fclose(fp);
+	snap_free(s);
+	return -1;
+    }
+    fclose(fp);
+    return 0;
+}
+
+/*
+ * snap_write_json - One object with the header fields and the blocks as
+ *     [offset, size, allocated] triples
+ */
+void snap_write_json(snap_t *s, FILE *fp)
+{
+    uint32_t i;
+    snap_block_t *b;
+
+    fprintf(fp, "{\n  \"engine\": \"%s\",\n  \"trace\": %d,\n  \"op\": %d,\n",
+	    s->h.engine, s->h.trace, s->h.op);
+    fprintf(fp, "  \"heapsize\": %llu,\n  \"live\": %llu,\n  \"blocks\": [",
+	    (unsigned long long)s->h.heapsize, (unsigned long long)s->h.live);
+    for (i = 0; i < s->h.nblocks; i++) {
+	b = &s->blocks[i];
+	fprintf(fp, "%s\n    [%u, %u, %u]", i ? "," : "", b->offset,
+		SNAP_SIZE(b), SNAP_ALLOC(b));
+    }
+    fprintf(fp, "\n  ]\n}\n");
+}
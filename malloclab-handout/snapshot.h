@@ -0,0 +1,65 @@
+/*
+ * snapshot.h - Heap snapshots: the offset, size and allocation state of
+ *     every block of a heap at one point of a trace, as written by
+ *     mdriver -Z and read by heapmap
+ */
+#ifndef __SNAPSHOT_H_
+#define __SNAPSHOT_H_
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SNAP_MAGIC "MMSNAPSH"
+#define SNAP_VERSION 1
+#define SNAP_NAMELEN 32
+
+/* A snapshot file starts with this header... */
+typedef struct {
+    char magic[8];            /* SNAP_MAGIC, not NUL terminated */
+    uint32_t version;         /* SNAP_VERSION */
+    uint32_t nblocks;         /* number of blocks that follow */
+    int32_t trace;            /* trace number in the driver */
+    int32_t op;               /* requests done when it was taken */
+    uint64_t heapsize;        /* size of the heap */
+    uint64_t live;            /* live payload bytes of the trace */
+    char engine[SNAP_NAMELEN];/* allocator name, NUL terminated */
+} snap_header_t;
+
+/* ... followed by the blocks in address order. Block sizes are
+   multiples of 8, so the low bit holds the allocated bit, as in the
+   block headers of mm.c. */
+typedef struct {
+    uint32_t offset;          /* of the payload from the start of the heap */
+    uint32_t size;            /* block size | allocated */
+} snap_block_t;
+
+#define SNAP_SIZE(b)  ((b)->size & ~(uint32_t)1)
+#define SNAP_ALLOC(b) ((b)->size & 1)
+
+/* A snapshot in memory */
+typedef struct {
+    snap_header_t h;
+    snap_block_t *blocks;
+    uint32_t maxblocks;       /* capacity of blocks */
+} snap_t;
+
+/* Start an empty snapshot */
+void snap_init(snap_t *s, char *engine, int trace, int op, size_t heapsize,
+	       size_t live);
+
+/* Append a block, in address order, -1 if out of memory */
+int snap_add(snap_t *s, size_t offset, size_t size, int alloc);
+
+void snap_free(snap_t *s);
+
+/* Write s to path, 0 on success or -1 */
+int snap_write(snap_t *s, char *path);
+
+/* Read a snapshot from path into s, 0 on success or -1 */
+int snap_read(snap_t *s, char *path);
+
+/* Write s as JSON */
+void snap_write_json(snap_t *s, FILE *fp);
+
+#endif /* __SNAPSHOT_H_ */
@@ -0,0 +1,282 @@
+/*
+ * stlbench.cpp - Compare the allocators of mm.hpp in standard containers
+ *
+ * Runs three workloads of -n elements each:
+ *
+ *   vector         -n vectors of 1 to 32 ints each, grown by push_back
+ *                  inside a vector of vectors, then destroyed
+ *   map            -n random keys inserted in a std::map, looked up, and
+ *                  erased in another order
+ *   unordered_map  the same with a std::unordered_map
+ *
+ * with five allocators: std::allocator (the global operator new, here
+ * the C library's malloc), mm::Allocator, and polymorphic allocators on
+ * mm::resource(), on an mm::HeapResource and on an mm::ArenaResource.
+ * Every run starts from an empty heap, as in mdriver, and the heap of
+ * the HeapResource is created and destroyed within it. Prints the time
+ * per element of each.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+#include "mm.hpp"
+
+extern "C" {
+#include "memlib.h"
+#include "fsecs.h"
+#include "clock.h"
+#include "config.h"
+}
+
+#define STL_REGION (256 << 20)  /* bytes of the heap and arena resources */
+
+/*******************
+ * Global variables
+ *******************/
+int verbose = 0;                /* global flag for verbose output */
+
+static int nelems = 1000;       /* elements of each workload (-n) */
+static int *keys;               /* random keys, and the order of the erases */
+static int *order;
+static mm::ArenaResource *arena;
+
+/*********************
+ * Function prototypes
+ *********************/
+static void shuffle(int *a, int n);
+static void usage(void);
+static void app_error(const char *msg);
+
+/*
+ * The workloads, for any allocator A of int
+ */
+template <class A>
+static void run_vector(const A &alloc)
+{
+    using inner_t = std::vector<int, A>;
+    using outer_alloc_t = typename std::allocator_traits<A>::template rebind_alloc<inner_t>;
+    std::vector<inner_t, outer_alloc_t> v(alloc);
+    int i, j;
+
+    for (i = 0; i < nelems; i++) {
+	v.emplace_back();
+	for (j = 0; j <= i % 32; j++)
+	    v.back().push_back(j);
+    }
+}
+
+template <class A>
+static void run_map(const A &alloc)
+{
+    using pair_alloc_t = typename std::allocator_traits<A>::template rebind_alloc<
+	std::pair<const int, int> >;
+    std::map<int, int, std::less<int>, pair_alloc_t> m(alloc);
+    long sum = 0;
+    int i;
+
+    for (i = 0; i < nelems; i++)
+	m.emplace(keys[i], i);
+    for (i = 0; i < nelems; i++)
+	sum += m.find(keys[i])->second;
+    for (i = 0; i < nelems; i++)
+	m.erase(keys[order[i]]);
+    if (sum < 0 || !m.empty())
+	app_error("map workload failed");
+}
+
+template <class A>
+static void run_unordered_map(const A &alloc)
+{
+    using pair_alloc_t = typename std::allocator_traits<A>::template rebind_alloc<
+	std::pair<const int, int> >;
+    std::unordered_map<int, int, std::hash<int>, std::equal_to<int>, pair_alloc_t> m(alloc);
+    long sum = 0;
+    int i;
+
+    for (i = 0; i < nelems; i++)
+	m.emplace(keys[i], i);
+    for (i = 0; i < nelems; i++)
+	sum += m.find(keys[i])->second;
+    for (i = 0; i < nelems; i++)
+	m.erase(keys[order[i]]);
+    if (sum < 0 || !m.empty())
+	app_error("unordered_map workload failed");
+}
+
+/*
+ * The allocators, for a workload W
+ */
+template <void (*W)(const std::allocator<int> &)>
+static void with_std(void *)
+{
+    W(std::allocator<int>());
+}
+
+template <void (*W)(const mm::Allocator<int> &)>
+static void with_mm(void *)
+{
+    mem_reset_brk();
+    if (mm_init() < 0)
+	app_error("mm_init failed in with_mm");
+    W(mm::Allocator<int>());
+}
+
+template <void (*W)(const std::pmr::polymorphic_allocator<int> &)>
+static void with_resource(void *)
+{
+    mem_reset_brk();
+    if (mm_init() < 0)
+	app_error("mm_init failed in with_resource");
+    W(std::pmr::polymorphic_allocator<int>(mm::resource()));
+}
+
+template <void (*W)(const std::pmr::polymorphic_allocator<int> &)>
+static void with_heap(void *)
+{
+    mm::HeapResource heap(STL_REGION);
+
+    W(std::pmr::polymorphic_allocator<int>(&heap));
+}
+
+template <void (*W)(const std::pmr::polymorphic_allocator<int> &)>
+static void with_arena(void *)
+{
+    arena->release();
+    W(std::pmr::polymorphic_allocator<int>(arena));
+}
+
+/* One workload with every allocator */
+struct workload {
+    const char *name;
+    fsecs_test_funct funcs[5];
+};
+
+typedef std::pmr::polymorphic_allocator<int> pmr_t;
+
+#define WORKLOAD(w) { #w, { with_std<w<std::allocator<int> > >, \
+	    with_mm<w<mm::Allocator<int> > >, with_resource<w<pmr_t> >, \
+	    with_heap<w<pmr_t> >, with_arena<w<pmr_t> > } }
+
+static const workload workloads[] = {
+    WORKLOAD(run_vector), WORKLOAD(run_map), WORKLOAD(run_unordered_map)
+};
+
+/**************
+ * Main routine
+ **************/
+int main(int argc, char **argv)
+{
+    int c, i, j, t, cpu = -1;
+    fsecs_timer_t timer = DEFAULT_TIMER;
+
+    while ((c = getopt(argc, argv, "n:T:C:hv")) != EOF) {
+        switch (c) {
+	case 'n': /* Elements of each workload */
+	    nelems = atoi(optarg);
+	    break;
+	case 'T': /* Timing method */
+	    if ((t = fsecs_parse_timer(optarg)) < 0) {
+		usage();
+		exit(1);
+	    }
+	    timer = (fsecs_timer_t)t;
+	    break;
+	case 'C': /* Pin to one CPU */
+	    cpu = atoi(optarg);
+	    break;
+	case 'v': /* Print timer calibration details */
+	    verbose = 1;
+	    break;
+        case 'h': /* Print this message */
+	    usage();
+            exit(0);
+        default:
+	    usage();
+            exit(1);
+        }
+    }
+    if (nelems <= 0) {
+	usage();
+	exit(1);
+    }
+
+    if (cpu >= 0 && pin_cpu(cpu) < 0)
+	app_error("ERROR: could not pin to the requested CPU");
+    init_fsecs(timer);
+    mem_init();
+    arena = new mm::ArenaResource(STL_REGION);
+
+    /* Keys and the order of the erases, both shuffled */
+    if ((keys = (int *)malloc(nelems * sizeof(int))) == NULL ||
+	(order = (int *)malloc(nelems * sizeof(int))) == NULL)
+	app_error("malloc failed in main");
+    for (i = 0; i < nelems; i++)
+	keys[i] = order[i] = i;
+    shuffle(keys, nelems);
+    shuffle(order, nelems);
+
+    printf("Containers by allocator, ns per element of %d (timer %s):\n",
+	   nelems, fsecs_timer_name());
+    printf("%-14s%10s%10s%10s%10s%10s\n", "workload", "std", "mm", "pmr mm",
+	   "pmr heap", "pmr arena");
+    for (i = 0; i < (int)(sizeof(workloads) / sizeof(workloads[0])); i++) {
+	printf("%-14s", workloads[i].name + strlen("run_"));
+	for (j = 0; j < 5; j++)
+	    printf("%10.1f", fsecs(workloads[i].funcs[j], NULL) / nelems * 1e9);
+	printf("\n");
+    }
+
+    delete arena;
+    free(keys);
+    free(order);
+    mem_deinit();
+    exit(0);
+}
+
+/*
+ * shuffle - Fisher-Yates shuffle of a[0..n-1] with a fixed seed
+ */
+static void shuffle(int *a, int n)
+{
+    static unsigned long long rng = 0x9E3779B97F4A7C15ULL;
+    int i, j, t;
+
+    for (i = n - 1; i > 0; i--) {
+	rng ^= rng << 13;
+	rng ^= rng >> 7;
+	rng ^= rng << 17;
+	j = (int)(rng % (i + 1));
+	t = a[i];
+	a[i] = a[j];
+	a[j] = t;
+    }
+}
+
+/*
+ * app_error - Report an arbitrary application error
+ */
+static void app_error(const char *msg)
+{
+    printf("%s\n", msg);
+    exit(1);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: stlbench [-hv] [-n <elems>] [-T <timer>] [-C <cpu>]\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-C <cpu>    Pin the benchmark to CPU <cpu>.\n");
+    fprintf(stderr, "\t-h          Print this message.\n");
+    fprintf(stderr, "\t-n <elems>  Elements of each workload (default 1000).\n");
+    fprintf(stderr, "\t-T <timer>  Timing method: fcyc, itimer or gettod.\n");
+    fprintf(stderr, "\t-v          Print timer calibration details.\n");
+}
@@ -0,0 +1,36 @@
+/*
+ * trace.h - Tracefile reader shared by the driver and the trace tools
+ */
+#ifndef __TRACE_H_
+#define __TRACE_H_
+
+#include <stddef.h>
+
+#define HDRLINES       4 /* number of header lines in a trace file */
+#define LINENUM(i) (i+5) /* cnvt trace request nums to linenums (origin 1) */
+
+/* Characterizes a single trace operation (allocator request) */
+typedef struct {
+    enum {ALLOC, FREE, REALLOC} type; /* type of request */
+    int index;                        /* index for free() to use later */
+    int size;                         /* byte size of alloc/realloc request */
+} traceop_t;
+
+/* Holds the information for one trace file*/
+typedef struct {
+    int sugg_heapsize;   /* suggested heap size (unused) */
+    int num_ids;         /* number of alloc/realloc ids */
+    int num_ops;         /* number of distinct requests */
+    int weight;          /* weight for this trace (unused) */
+    traceop_t *ops;      /* array of requests */
+    char **blocks;       /* array of ptrs returned by malloc/realloc... */
+    size_t *block_sizes; /* ... and a corresponding array of payload sizes */
+} trace_t;
+
+/* Read the trace file tracedir/filename into memory */
+trace_t *read_trace(char *tracedir, char *filename);
+
+/* Free a trace returned by read_trace */
+void free_trace(trace_t *trace);
+
+#endif /* __TRACE_H_ */
@@ -0,0 +1,179 @@
+/*
+ * trace2c.c - Compile tracefiles to native replay code
+ *
+ * For each tracefile, emits a C function that performs the trace's
+ * requests as straight-line calls to mm_malloc, mm_realloc and mm_free,
+ * with every block kept in its own element of a static array. The
+ * compiled code has no request decoding, no switch and no error checks,
+ * so when replay.c times it, nearly all of the time is the allocator's.
+ * The trace is also emitted as a table of requests, so that replay.c
+ * can time the driver's interpreter on exactly the same input.
+ *
+ * Long traces are split into functions of at most -c requests each to
+ * keep the compiler's time and memory in check. The output is meant to
+ * be compiled with replay.c, see the "replay" target in the Makefile.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include "trace.h"
+
+/*******************
+ * Global variables
+ *******************/
+int verbose = 0;                /* used by read_trace() */
+
+static int chunk_ops = 1000;    /* requests per generated function (-c) */
+
+/*********************
+ * Function prototypes
+ *********************/
+static void emit_trace(FILE *fp, int n, trace_t *trace);
+static void usage(void);
+static void unix_error(char *msg);
+
+/**************
+ * Main routine
+ **************/
+int main(int argc, char **argv)
+{
+    int c, i;
+    char *outfile = NULL;
+    char *tracedir = "";
+    trace_t *trace;
+    FILE *fp;
+
+    while ((c = getopt(argc, argv, "c:o:t:hv")) != EOF) {
+        switch (c) {
+	case 'c': /* Requests per generated function */
+	    chunk_ops = atoi(optarg);
+	    break;
+	case 'o': /* Output file (default stdout) */
+	    outfile = optarg;
+	    break;
+	case 't': /* Directory the tracefiles are in */
+	    tracedir = optarg;
+	    break;
+	case 'v': /* Print the name of each trace as it is read */
+	    verbose = 2;
+	    break;
+        case 'h': /* Print this message */
+	    usage();
+            exit(0);
+        default:
+	    usage();
+            exit(1);
+        }
+    }
+    if (optind == argc || chunk_ops <= 0) {
+	usage();
+	exit(1);
+    }
+
+    if (outfile) {
+	if ((fp = fopen(outfile, "w")) == NULL)
+	    unix_error("trace2c: could not open output file");
+    }
+    else
+	fp = stdout;
+
+    fprintf(fp, "/*\n * Generated by trace2c from");
+    for (i = optind; i < argc; i++)
+	fprintf(fp, " %s", argv[i]);
+    fprintf(fp, ".\n * Do not edit.\n */\n#include \"replay.h\"\n");
+
+    for (i = optind; i < argc; i++) {
+	trace = read_trace(tracedir, argv[i]);
+	emit_trace(fp, i - optind, trace);
+	free_trace(trace);
+    }
+
+    fprintf(fp, "\nconst replay_t replay_traces[] = {\n");
+    for (i = optind; i < argc; i++)
+	fprintf(fp, "    {\"%s\", t%d_run, t%d_ops, sizeof(t%d_ops) / sizeof(traceop_t), "
+		"sizeof(t%d_blocks) / sizeof(void *)},\n",
+		argv[i], i - optind, i - optind, i - optind, i - optind);
+    fprintf(fp, "};\nconst int replay_ntraces = %d;\n", argc - optind);
+
+    if (fp != stdout)
+	fclose(fp);
+    exit(0);
+}
+
+/*
+ * emit_trace - Write the replay functions and the request table of
+ *     trace number n
+ */
+static void emit_trace(FILE *fp, int n, trace_t *trace)
+{
+    static char *types[] = {"ALLOC", "FREE", "REALLOC"};
+    traceop_t *op;
+    int i, chunk, nchunks;
+
+    nchunks = (trace->num_ops + chunk_ops - 1) / chunk_ops;
+    fprintf(fp, "\n/* Trace %d: %d requests, %d ids */\n",
+	    n, trace->num_ops, trace->num_ids);
+    fprintf(fp, "static void *t%d_blocks[%d];\n", n,
+	    trace->num_ids > 0 ? trace->num_ids : 1);
+
+    for (chunk = 0; chunk < nchunks; chunk++) {
+	fprintf(fp, "\nstatic void t%d_%d(void)\n{\n", n, chunk);
+	for (i = chunk * chunk_ops;
+	     i < trace->num_ops && i < (chunk + 1) * chunk_ops; i++) {
+	    op = &trace->ops[i];
+	    switch (op->type) {
+	    case ALLOC:
+		fprintf(fp, "    t%d_blocks[%d] = mm_malloc(%d);\n",
+			n, op->index, op->size);
+		break;
+	    case REALLOC:
+		fprintf(fp, "    t%d_blocks[%d] = mm_realloc(t%d_blocks[%d], %d);\n",
+			n, op->index, n, op->index, op->size);
+		break;
+	    case FREE:
+		fprintf(fp, "    mm_free(t%d_blocks[%d]);\n", n, op->index);
+		break;
+	    }
+	}
+	fprintf(fp, "}\n");
+    }
+
+    fprintf(fp, "\nstatic void t%d_run(void)\n{\n", n);
+    for (chunk = 0; chunk < nchunks; chunk++)
+	fprintf(fp, "    t%d_%d();\n", n, chunk);
+    fprintf(fp, "}\n");
+
+    fprintf(fp, "\nstatic const traceop_t t%d_ops[] = {\n", n);
+    for (i = 0; i < trace->num_ops; i++) {
+	op = &trace->ops[i];
+	fprintf(fp, "    {%s, %d, %d},\n", types[op->type], op->index,
+		op->type == FREE ? 0 : op->size);
+    }
+    fprintf(fp, "};\n");
+}
+
+/*
+ * unix_error - Report a Unix-style error
+ */
+static void unix_error(char *msg)
+{
+    fprintf(stderr, "%s: %s\n", msg, strerror(errno));
+    exit(1);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: trace2c [-hv] [-c <n>] [-o <file>] [-t <dir>] <file>...\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-c <n>      Requests per generated function (default 1000).\n");
+    fprintf(stderr, "\t-h          Print this message.\n");
+    fprintf(stderr, "\t-o <file>   Write the C code to <file> instead of stdout.\n");
+    fprintf(stderr, "\t-t <dir>    Directory the tracefiles are in.\n");
+    fprintf(stderr, "\t-v          Print the name of each tracefile as it is read.\n");
+}
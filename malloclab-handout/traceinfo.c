@@ -0,0 +1,691 @@
+/*
+ * traceinfo.c - Workload characterization for malloc tracefiles
+ *
+ * Reads one or more tracefiles with read_trace() and reports, for each:
+ *
+ *   - the request size histogram (power of two buckets)
+ *   - the distribution of object lifetimes, in ops
+ *   - the live-set curve (live blocks and bytes over time)
+ *   - realloc chain lengths and growth factors
+ *   - the free order: how often the freed block is the youngest live
+ *     block (LIFO), the oldest (FIFO), or neither
+ *   - the most common request sizes
+ *
+ * and suggests a table of size classes for segregated lists or slabs.
+ * The classes minimize the internal fragmentation of the trace's own
+ * requests: every request rounded up to ALIGNMENT is charged the
+ * distance to the next class boundary, and a dynamic program picks the
+ * boundaries with the least total waste.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+#include "trace.h"
+#include "config.h"
+
+/**********************
+ * Constants and macros
+ **********************/
+
+#define NBUCKETS     32      /* power of two buckets in the histograms */
+#define MAXCHAIN      8      /* chain lengths >= this share one row */
+#define NTOP         10      /* number of most common sizes to list */
+#define NGROWTH       6      /* growth factor buckets */
+#define BARWIDTH     40      /* width of the histogram bars */
+
+#define ALIGN(size) (((size) + (ALIGNMENT-1)) & ~(ALIGNMENT-1))
+
+/*******************
+ * Global variables
+ *******************/
+int verbose = 0;                /* used by read_trace() */
+
+static int num_classes = 16;    /* size classes to suggest (-k) */
+static int max_class = 4096;    /* largest size given a class (-m) */
+static int curve_rows = 20;     /* rows of the live-set curve (-r) */
+
+/* A request size and how often it occurs */
+typedef struct {
+    int size;
+    long count;
+} sizecount_t;
+
+/* A block in allocation order, for classifying the free order */
+typedef struct {
+    int id;
+    int seq;                    /* allocation number of this instance */
+} order_t;
+
+/*********************
+ * Function prototypes
+ *********************/
+static void analyze(char *name, trace_t *trace);
+static void size_histogram(trace_t *trace);
+static void lifetimes(trace_t *trace);
+static void live_curve(trace_t *trace);
+static void realloc_chains(trace_t *trace);
+static void free_order(trace_t *trace);
+static void top_sizes(trace_t *trace);
+static void size_classes(trace_t *trace);
+static void usage(void);
+static void unix_error(char *msg);
+
+/**************
+ * Main routine
+ **************/
+int main(int argc, char **argv)
+{
+    int c, i;
+    char *tracedir = "";
+    trace_t *trace;
+
+    while ((c = getopt(argc, argv, "k:m:r:t:hv")) != EOF) {
+        switch (c) {
+	case 'k': /* Number of size classes to suggest */
+	    num_classes = atoi(optarg);
+	    break;
+	case 'm': /* Largest size that gets a class */
+	    max_class = atoi(optarg);
+	    break;
+	case 'r': /* Rows in the live-set curve */
+	    curve_rows = atoi(optarg);
+	    break;
+	case 't': /* Directory the tracefiles are in */
+	    tracedir = optarg;
+	    break;
+	case 'v': /* Print the name of each trace as it is read */
+	    verbose = 2;
+	    break;
+        case 'h': /* Print this message */
+	    usage();
+            exit(0);
+        default:
+	    usage();
+            exit(1);
+        }
+    }
+
+    if (optind == argc || num_classes <= 0 || max_class < ALIGNMENT ||
+	curve_rows <= 0) {
+	usage();
+	exit(1);
+    }
+
+    for (i = optind; i < argc; i++) {
+	trace = read_trace(tracedir, argv[i]);
+	analyze(argv[i], trace);
+	free_trace(trace);
+    }
+    exit(0);
+}
+
+/*
+ * analyze - Print every report for one trace
+ */
+static void analyze(char *name, trace_t *trace)
+{
+    int i;
+    long nalloc = 0, nrealloc = 0, nfree = 0;
+
+    for (i = 0; i < trace->num_ops; i++) {
+	switch (trace->ops[i].type) {
+	case ALLOC:   nalloc++;   break;
+	case REALLOC: nrealloc++; break;
+	case FREE:    nfree++;    break;
+	}
+    }
+
+    printf("==== %s: %d ops, %d ids (%ld allocs, %ld reallocs, %ld frees)\n\n",
+	   name, trace->num_ops, trace->num_ids, nalloc, nrealloc, nfree);
+    size_histogram(trace);
+    lifetimes(trace);
+    live_curve(trace);
+    realloc_chains(trace);
+    free_order(trace);
+    top_sizes(trace);
+    size_classes(trace);
+}
+
+
+/*************************************
+ * Some miscellaneous helper routines
+ ************************************/
+
+/* log2_bucket - bucket i holds the values in [2^i, 2^(i+1)), 0 goes in 0 */
+static int log2_bucket(long v)
+{
+    int i = 0;
+
+    while (v > 1 && i < NBUCKETS - 1) {
+	v >>= 1;
+	i++;
+    }
+    return i;
+}
+
+/* bar - print a bar of BARWIDTH * n / max characters */
+static void bar(double n, double max)
+{
+    int i, w = (max > 0) ? (int)(BARWIDTH * n / max + 0.5) : 0;
+
+    for (i = 0; i < w; i++)
+	putchar('#');
+}
+
+/* print_log2_hist - print the nonempty rows of a power of two histogram */
+static void print_log2_hist(char *label, long *hist)
+{
+    int i, lo = NBUCKETS, hi = -1;
+    long total = 0, max = 0, cum = 0;
+
+    for (i = 0; i < NBUCKETS; i++) {
+	if (hist[i] == 0)
+	    continue;
+	lo = (i < lo) ? i : lo;
+	hi = i;
+	total += hist[i];
+	max = (hist[i] > max) ? hist[i] : max;
+    }
+    printf("%23s%10s%8s%8s\n", label, "count", "pct", "cum");
+    for (i = lo; i <= hi; i++) {
+	cum += hist[i];
+	printf("%10ld .. %10ld%10ld%7.1f%%%7.1f%%  ",
+	       i ? 1L << i : 0L, (1L << (i+1)) - 1, hist[i],
+	       100.0 * hist[i] / total, 100.0 * cum / total);
+	bar(hist[i], max);
+	printf("\n");
+    }
+    printf("\n");
+}
+
+/* cmp_long - qsort comparison for longs */
+static int cmp_long(const void *a, const void *b)
+{
+    long x = *(long *)a, y = *(long *)b;
+    return (x > y) - (x < y);
+}
+
+/* cmp_count - qsort comparison, most frequent size first */
+static int cmp_count(const void *a, const void *b)
+{
+    const sizecount_t *x = a, *y = b;
+
+    if (x->count != y->count)
+	return (x->count < y->count) - (x->count > y->count);
+    return x->size - y->size;
+}
+
+/* count_sizes - the distinct alloc and realloc sizes of the trace, with
+ *     their counts, sorted by size. Returns the number of sizes. */
+static int count_sizes(trace_t *trace, sizecount_t **out)
+{
+    long *sizes;
+    sizecount_t *sc;
+    int i, n = 0, m = 0;
+
+    if ((sizes = malloc(trace->num_ops * sizeof(long))) == NULL ||
+	(sc = malloc(trace->num_ops * sizeof(sizecount_t))) == NULL)
+	unix_error("malloc failed in count_sizes");
+    for (i = 0; i < trace->num_ops; i++)
+	if (trace->ops[i].type != FREE)
+	    sizes[n++] = trace->ops[i].size;
+    qsort(sizes, n, sizeof(long), cmp_long);
+    for (i = 0; i < n; i++) {
+	if (m > 0 && sc[m-1].size == sizes[i])
+	    sc[m-1].count++;
+	else {
+	    sc[m].size = sizes[i];
+	    sc[m++].count = 1;
+	}
+    }
+    free(sizes);
+    *out = sc;
+    return m;
+}
+
+
+/***************************************************
+ * The reports. Each one prints a titled table and a
+ * blank line.
+ ***************************************************/
+
+/*
+ * size_histogram - Request sizes of allocs and reallocs
+ */
+static void size_histogram(trace_t *trace)
+{
+    long hist[NBUCKETS] = {0};
+    int i;
+
+    for (i = 0; i < trace->num_ops; i++)
+	if (trace->ops[i].type != FREE)
+	    hist[log2_bucket(trace->ops[i].size)]++;
+    printf("Request sizes (bytes):\n");
+    print_log2_hist("size", hist);
+}
+
+/*
+ * lifetimes - Ops between the alloc and the free of each block. Blocks
+ *     that are never freed are counted separately.
+ */
+static void lifetimes(trace_t *trace)
+{
+    long hist[NBUCKETS] = {0};
+    long *born, *life;
+    int i, id, n = 0, leaked = 0;
+
+    if ((born = malloc(trace->num_ids * sizeof(long))) == NULL ||
+	(life = malloc(trace->num_ops * sizeof(long))) == NULL)
+	unix_error("malloc failed in lifetimes");
+    for (i = 0; i < trace->num_ids; i++)
+	born[i] = -1;
+
+    for (i = 0; i < trace->num_ops; i++) {
+	id = trace->ops[i].index;
+	if (trace->ops[i].type == ALLOC)
+	    born[id] = i;
+	else if (trace->ops[i].type == FREE && born[id] >= 0) {
+	    life[n] = i - born[id];
+	    hist[log2_bucket(life[n++])]++;
+	    born[id] = -1;
+	}
+    }
+    for (i = 0; i < trace->num_ids; i++)
+	leaked += (born[i] >= 0);
+
+    printf("Lifetimes (ops), %d freed, %d never freed:\n", n, leaked);
+    if (n > 0) {
+	qsort(life, n, sizeof(long), cmp_long);
+	printf("  p50 %ld  p90 %ld  p99 %ld  max %ld\n",
+	       life[n/2], life[(int)(n*0.9)], life[(int)(n*0.99)], life[n-1]);
+	print_log2_hist("lifetime", hist);
+    }
+    else
+	printf("\n");
+    free(born);
+    free(life);
+}
+
+/*
+ * live_curve - Live blocks and bytes sampled at curve_rows evenly
+ *     spaced points, with a bar scaled to the peak live bytes
+ */
+static void live_curve(trace_t *trace)
+{
+    long live = 0, bytes = 0, peak = 0, peak_live = 0;
+    long *sample_live, *sample_bytes;
+    int i, row, id, peak_op = 0;
+
+    if ((sample_live = calloc(curve_rows, sizeof(long))) == NULL ||
+	(sample_bytes = calloc(curve_rows, sizeof(long))) == NULL)
+	unix_error("malloc failed in live_curve");
+    for (i = 0; i < trace->num_ids; i++)
+	trace->block_sizes[i] = 0;
+
+    for (i = 0, row = 0; i < trace->num_ops; i++) {
+	id = trace->ops[i].index;
+	switch (trace->ops[i].type) {
+	case ALLOC:
+	    live++;
+	    /* fall through */
+	case REALLOC:
+	    bytes += trace->ops[i].size - trace->block_sizes[id];
+	    trace->block_sizes[id] = trace->ops[i].size;
+	    break;
+	case FREE:
+	    live--;
+	    bytes -= trace->block_sizes[id];
+	    trace->block_sizes[id] = 0;
+	    break;
+	}
+	if (bytes > peak) {
+	    peak = bytes;
+	    peak_live = live;
+	    peak_op = i;
+	}
+	while (row < curve_rows &&
+	       (long)(row + 1) * trace->num_ops <= (long)(i + 1) * curve_rows) {
+	    sample_live[row] = live;
+	    sample_bytes[row++] = bytes;
+	}
+    }
+
+    printf("Live set, peak %ld bytes in %ld blocks at op %d:\n",
+	   peak, peak_live, peak_op);
+    printf("%10s%10s%12s\n", "op", "blocks", "bytes");
+    for (row = 0; row < curve_rows; row++) {
+	printf("%10ld%10ld%12ld  ",
+	       (long)(row + 1) * trace->num_ops / curve_rows - 1,
+	       sample_live[row], sample_bytes[row]);
+	bar(sample_bytes[row], peak);
+	printf("\n");
+    }
+    printf("\n");
+    free(sample_live);
+    free(sample_bytes);
+}
+
+/*
+ * realloc_chains - Number of reallocs each block goes through between
+ *     its alloc and free, and the size factor of every realloc
+ */
+static void realloc_chains(trace_t *trace)
+{
+    static double edges[NGROWTH] = {1.0, 1.25, 1.5, 2.0, 4.0, 1e300};
+    static char *labels[NGROWTH] = {"< 1 (shrink)", "1 .. 1.25", "1.25 .. 1.5",
+				    "1.5 .. 2", "2 .. 4", ">= 4"};
+    long chains[MAXCHAIN+1] = {0}, growth[NGROWTH] = {0};
+    long nchains = 0, nfactors = 0;
+    int *len;
+    int i, j, id;
+    double f, sum = 0.0;
+
+    if ((len = calloc(trace->num_ids, sizeof(int))) == NULL)
+	unix_error("malloc failed in realloc_chains");
+    for (i = 0; i < trace->num_ids; i++)
+	trace->block_sizes[i] = 0;
+
+    for (i = 0; i < trace->num_ops; i++) {
+	id = trace->ops[i].index;
+	switch (trace->ops[i].type) {
+	case ALLOC:
+	    trace->block_sizes[id] = trace->ops[i].size;
+	    len[id] = 0;
+	    break;
+	case REALLOC:
+	    len[id]++;
+	    if (trace->block_sizes[id] > 0) {
+		f = (double)trace->ops[i].size / trace->block_sizes[id];
+		for (j = 0; f >= edges[j]; j++)
+		    ;
+		growth[j]++;
+		sum += f;
+		nfactors++;
+	    }
+	    trace->block_sizes[id] = trace->ops[i].size;
+	    break;
+	case FREE:
+	    if (len[id] > 0) {
+		chains[(len[id] < MAXCHAIN) ? len[id] : MAXCHAIN]++;
+		nchains++;
+	    }
+	    len[id] = 0;
+	    break;
+	}
+    }
+    for (i = 0; i < trace->num_ids; i++)
+	if (len[i] > 0) {
+	    chains[(len[i] < MAXCHAIN) ? len[i] : MAXCHAIN]++;
+	    nchains++;
+	}
+    free(len);
+
+    printf("Realloc chains, %ld blocks reallocated:\n", nchains);
+    if (nchains == 0) {
+	printf("\n");
+	return;
+    }
+    printf("%10s%10s%8s\n", "reallocs", "blocks", "pct");
+    for (i = 1; i <= MAXCHAIN; i++)
+	if (chains[i])
+	    printf("%9d%s%10ld%7.1f%%\n", i, (i == MAXCHAIN) ? "+" : " ",
+		   chains[i], 100.0 * chains[i] / nchains);
+    printf("Growth factors, mean %.2f:\n", nfactors ? sum / nfactors : 0.0);
+    printf("%14s%10s%8s\n", "new/old", "count", "pct");
+    for (i = 0; i < NGROWTH; i++)
+	if (growth[i])
+	    printf("%14s%10ld%7.1f%%\n", labels[i], growth[i],
+		   100.0 * growth[i] / nfactors);
+    printf("\n");
+}
+
+/*
+ * free_order - Classify every free by whether it releases the youngest
+ *     live block (LIFO, stack-like), the oldest (FIFO, queue-like), or
+ *     some other one. Blocks are kept in allocation order; the oldest
+ *     and youngest live blocks are found by skipping dead entries from
+ *     either end, which takes amortized constant time per free.
+ */
+static void free_order(trace_t *trace)
+{
+    order_t *order;
+    int *seq, *alive;
+    int i, id, head = 0, top = -1, nseq = 0;
+    long lifo = 0, fifo = 0, both = 0, other = 0, n;
+    int is_lifo, is_fifo;
+    char *verdict;
+
+    if ((order = malloc(trace->num_ops * sizeof(order_t))) == NULL ||
+	(seq = calloc(trace->num_ids, sizeof(int))) == NULL ||
+	(alive = calloc(trace->num_ids, sizeof(int))) == NULL)
+	unix_error("malloc failed in free_order");
+
+#define LIVE(o) (alive[(o).id] && seq[(o).id] == (o).seq)
+
+    for (i = 0; i < trace->num_ops; i++) {
+	id = trace->ops[i].index;
+	if (trace->ops[i].type == ALLOC) {
+	    if (top < head)
+		head = 0, top = -1;
+	    seq[id] = ++nseq;
+	    alive[id] = 1;
+	    order[++top].id = id;
+	    order[top].seq = nseq;
+	}
+	else if (trace->ops[i].type == FREE && alive[id]) {
+	    while (head <= top && !LIVE(order[head]))
+		head++;
+	    while (top >= head && !LIVE(order[top]))
+		top--;
+	    is_lifo = (top >= head && order[top].id == id);
+	    is_fifo = (top >= head && order[head].id == id);
+	    if (is_lifo && is_fifo)
+		both++;
+	    else if (is_lifo)
+		lifo++;
+	    else if (is_fifo)
+		fifo++;
+	    else
+		other++;
+	    alive[id] = 0;
+	}
+    }
+#undef LIVE
+    free(order);
+    free(seq);
+    free(alive);
+
+    /* Frees of the only live block fit either pattern */
+    n = lifo + fifo + both + other;
+    if (n == 0)
+	return;
+    if (lifo + both >= 0.5 * n && lifo >= fifo)
+	verdict = "LIFO";
+    else if (fifo + both >= 0.5 * n)
+	verdict = "FIFO";
+    else
+	verdict = "random";
+    printf("Free order: %s\n", verdict);
+    printf("  youngest live (LIFO) %5.1f%%  oldest live (FIFO) %5.1f%%  "
+	   "only live %5.1f%%  other %5.1f%%\n\n",
+	   100.0 * lifo / n, 100.0 * fifo / n, 100.0 * both / n,
+	   100.0 * other / n);
+}
+
+/*
+ * top_sizes - The NTOP most common request sizes
+ */
+static void top_sizes(trace_t *trace)
+{
+    sizecount_t *sc;
+    long total = 0;
+    int i, m;
+
+    m = count_sizes(trace, &sc);
+    for (i = 0; i < m; i++)
+	total += sc[i].count;
+    qsort(sc, m, sizeof(sizecount_t), cmp_count);
+
+    printf("Most common sizes (%d distinct):\n", m);
+    printf("%10s%10s%8s\n", "size", "count", "pct");
+    for (i = 0; i < m && i < NTOP; i++)
+	printf("%10d%10ld%7.1f%%\n", sc[i].size, sc[i].count,
+	       100.0 * sc[i].count / total);
+    printf("\n");
+    free(sc);
+}
+
+/*
+ * size_classes - Suggest num_classes class sizes for requests up to
+ *     max_class bytes. With the distinct aligned sizes s_1 < ... < s_m
+ *     and their counts c_i, a class boundary must sit at the largest
+ *     size it serves, so cost[k][j] (the least waste for s_1..s_j with
+ *     k classes, the last one ending at s_j) follows from
+ *         cost[k][j] = min over i < j of cost[k-1][i] + waste(i+1, j).
+ *     The waste of a class is computed from prefix sums in O(1), so the
+ *     whole table takes O(k m^2) time with m <= max_class/ALIGNMENT.
+ */
+static void size_classes(trace_t *trace)
+{
+    sizecount_t *sc;
+    int i, j, k, m, nsc, K, *from, *classes;
+    long *sz, *cnt, *pc, *ps, total = 0, large = 0;
+    double *cost, c, waste, pow2_waste = 0.0;
+    long nbytes = 0;
+
+    /* Merge the sizes into aligned ones below max_class */
+    nsc = count_sizes(trace, &sc);
+    if ((sz = malloc((nsc + 1) * sizeof(long))) == NULL ||
+	(cnt = malloc((nsc + 1) * sizeof(long))) == NULL)
+	unix_error("malloc failed in size_classes");
+    for (i = 0, m = 0; i < nsc; i++) {
+	total += sc[i].count;
+	if (sc[i].size > max_class) {
+	    large += sc[i].count;
+	    continue;
+	}
+	if (m > 0 && sz[m] == ALIGN(sc[i].size))
+	    cnt[m] += sc[i].count;
+	else {
+	    sz[++m] = ALIGN(sc[i].size);
+	    cnt[m] = sc[i].count;
+	}
+    }
+    free(sc);
+
+    if (m == 0) {
+	printf("Suggested size classes (up to %d bytes):\n", max_class);
+	printf("  no requests of at most %d bytes\n\n", max_class);
+	free(sz);
+	free(cnt);
+	return;
+    }
+
+    /* A class per distinct size at most, which can be fewer than asked */
+    K = (num_classes < m) ? num_classes : m;
+    printf("Suggested size classes (%d, up to %d bytes", K, max_class);
+    if (K < num_classes)
+	printf("; the trace has only %d distinct sizes", m);
+    printf("):\n");
+
+    /* pc, ps: prefix sums of counts and of count * size */
+    if ((pc = calloc(m + 1, sizeof(long))) == NULL ||
+	(ps = calloc(m + 1, sizeof(long))) == NULL ||
+	(cost = malloc((K + 1) * (m + 1) * sizeof(double))) == NULL ||
+	(from = malloc((K + 1) * (m + 1) * sizeof(int))) == NULL ||
+	(classes = malloc((K + 1) * sizeof(int))) == NULL)
+	unix_error("malloc failed in size_classes");
+    for (j = 1; j <= m; j++) {
+	pc[j] = pc[j-1] + cnt[j];
+	ps[j] = ps[j-1] + cnt[j] * sz[j];
+	nbytes += cnt[j] * sz[j];
+    }
+
+#define COST(k, j) cost[(k) * (m + 1) + (j)]
+#define FROM(k, j) from[(k) * (m + 1) + (j)]
+    for (j = 0; j <= m; j++)
+	COST(0, j) = (j == 0) ? 0.0 : 1e300;
+    for (k = 1; k <= K; k++) {
+	COST(k, 0) = 0.0;
+	for (j = 1; j <= m; j++) {
+	    COST(k, j) = 1e300;
+	    for (i = k - 1; i < j; i++) {
+		c = COST(k-1, i) + (double)(pc[j] - pc[i]) * sz[j] - (ps[j] - ps[i]);
+		if (c < COST(k, j)) {
+		    COST(k, j) = c;
+		    FROM(k, j) = i;
+		}
+	    }
+	}
+    }
+    for (k = K, j = m; k > 0; k--) {
+	classes[k] = j;
+	j = FROM(k, j);
+    }
+    waste = COST(K, m);
+#undef COST
+#undef FROM
+
+    /* Power of two classes, for comparison */
+    for (j = 1; j <= m; j++) {
+	for (c = ALIGNMENT; c < sz[j]; c *= 2)
+	    ;
+	pow2_waste += cnt[j] * (c - sz[j]);
+    }
+
+    printf("%8s%10s%10s%8s%10s\n", "class", "bytes", "requests", "pct",
+	   "waste/req");
+    for (k = 1, i = 0; k <= K; k++) {
+	j = classes[k];
+	printf("%8d%10ld%10ld%7.1f%%%10.1f\n", k - 1, sz[j], pc[j] - pc[i],
+	       100.0 * (pc[j] - pc[i]) / total,
+	       (double)((pc[j] - pc[i]) * sz[j] - (ps[j] - ps[i])) /
+	       (pc[j] - pc[i]));
+	i = j;
+    }
+    if (large)
+	printf("%8s%10s%10ld%7.1f%%\n", "large", "", large,
+	       100.0 * large / total);
+    printf("Internal fragmentation %.1f%% (power of two classes: %.1f%%)\n",
+	   100.0 * waste / (nbytes + waste),
+	   100.0 * pow2_waste / (nbytes + pow2_waste));
+    printf("static const size_t size_classes[%d] = {", K);
+    for (k = 1; k <= K; k++)
+	printf("%s%ld", (k > 1) ? ", " : "", sz[classes[k]]);
+    printf("};\n\n");
+
+    free(sz);
+    free(cnt);
+    free(pc);
+    free(ps);
+    free(cost);
+    free(from);
+    free(classes);
+}
+
+/*
+ * unix_error - Report a Unix-style error
+ */
+static void unix_error(char *msg)
+{
+    fprintf(stderr, "%s: %s\n", msg, strerror(errno));
+    exit(1);
+}
+
+/*
+ * usage - Explain the command line arguments
+ */
+static void usage(void)
+{
+    fprintf(stderr, "Usage: traceinfo [-hv] [-k <n>] [-m <bytes>] [-r <rows>] [-t <dir>] <file>...\n");
+    fprintf(stderr, "Options\n");
+    fprintf(stderr, "\t-h          Print this message.\n");
+    fprintf(stderr, "\t-k <n>      Number of size classes to suggest (default 16).\n");
+    fprintf(stderr, "\t-m <bytes>  Largest request that gets a size class (default 4096).\n");
+    fprintf(stderr, "\t-r <rows>   Rows in the live-set curve (default 20).\n");
+    fprintf(stderr, "\t-t <dir>    Directory the tracefiles are in.\n");
+    fprintf(stderr, "\t-v          Print the name of each tracefile as it is read.\n");
+}